@@ -0,0 +1,118 @@
+#include "Camera.h"
+#include "engine/sdl/SDLAPI.h"
+
+#include <SDL2/SDL.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+const float MOUSE_ORBIT_SPEED = 0.005f;
+const float KEY_ORBIT_SPEED = 1.5f;
+const float ZOOM_SPEED = 2.0f;
+const float MIN_DISTANCE = 0.5f;
+const float MAX_DISTANCE = 20.0f;
+const float MAX_PITCH = glm::radians(89.0f);
+const float MAX_DELTA_TIME = 0.1f;
+
+void Camera::sampleInput(SDLAPI& sdlApi)
+{
+    // The oldest input event not yet reflected in a submitted frame is where input latency starts.
+    // Most were already drained by the main loop, which kept their timestamps; anything older than
+    // the last submit was peeked by that frame's late latch and already counted.
+    uint32_t handledTicks = 0;
+    if (sdlApi.takePendingInput(handledTicks) && (handledTicks >= this->submittedTicks) && !this->hasPendingInput)
+    {
+        this->hasPendingInput = true;
+        this->pendingInputTicks = handledTicks;
+    }
+
+    // Peek, don't consume: events that arrived since then are still queued for the main loop.
+    SDL_PumpEvents();
+    SDL_Event events[16];
+    int eventCount = SDL_PeepEvents(events, 16, SDL_PEEKEVENT, SDL_KEYDOWN, SDL_MOUSEWHEEL);
+    if ((eventCount > 0) && !this->hasPendingInput)
+    {
+        this->hasPendingInput = true;
+        this->pendingInputTicks = events[0].common.timestamp;
+    }
+
+    Clock::time_point now = Clock::now();
+    float deltaTime = 0.0f;
+    if (this->lastSampleTime != Clock::time_point())
+    {
+        // Samples can be far apart while the main loop idles; don't let one jump the camera.
+        deltaTime = std::min(std::chrono::duration<float>(now - this->lastSampleTime).count(), MAX_DELTA_TIME);
+    }
+
+    this->lastSampleTime = now;
+
+    int mouseX = 0;
+    int mouseY = 0;
+    uint32_t buttons = SDL_GetRelativeMouseState(&mouseX, &mouseY);
+    bool dragging = ((buttons & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0);
+    if (dragging)
+    {
+        this->yaw -= mouseX * MOUSE_ORBIT_SPEED;
+        this->pitch += mouseY * MOUSE_ORBIT_SPEED;
+    }
+
+    const Uint8* keys = SDL_GetKeyboardState(nullptr);
+    this->moving = (dragging && ((mouseX != 0) || (mouseY != 0))) ||
+        keys[SDL_SCANCODE_LEFT] || keys[SDL_SCANCODE_RIGHT] || keys[SDL_SCANCODE_UP] || keys[SDL_SCANCODE_DOWN] ||
+        keys[SDL_SCANCODE_W] || keys[SDL_SCANCODE_S];
+
+    this->yaw += (keys[SDL_SCANCODE_LEFT] - keys[SDL_SCANCODE_RIGHT]) * KEY_ORBIT_SPEED * deltaTime;
+    this->pitch += (keys[SDL_SCANCODE_UP] - keys[SDL_SCANCODE_DOWN]) * KEY_ORBIT_SPEED * deltaTime;
+    this->distance += (keys[SDL_SCANCODE_S] - keys[SDL_SCANCODE_W]) * ZOOM_SPEED * deltaTime;
+
+    this->pitch = std::clamp(this->pitch, -MAX_PITCH, MAX_PITCH);
+    this->distance = std::clamp(this->distance, MIN_DISTANCE, MAX_DISTANCE);
+}
+
+glm::mat4 Camera::getViewMatrix() const
+{
+    // Z is up, matching the model's orientation.
+    glm::vec3 offset
+    {
+        std::cos(this->pitch) * std::cos(this->yaw),
+        std::cos(this->pitch) * std::sin(this->yaw),
+        std::sin(this->pitch)
+    };
+
+    return glm::lookAt(this->target + offset * this->distance, this->target, glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+bool Camera::isMoving() const
+{
+    return this->moving;
+}
+
+void Camera::markSubmitted()
+{
+    uint32_t now = SDL_GetTicks();
+    this->submittedTicks = now;
+    if (!this->hasPendingInput)
+    {
+        return;
+    }
+
+    // SDL event timestamps only have millisecond resolution.
+    double latencyMs = static_cast<double>(now - this->pendingInputTicks);
+    this->latencyStats.sampleCount++;
+    this->latencyStats.totalMs += latencyMs;
+    this->latencyStats.maxMs = std::max(this->latencyStats.maxMs, latencyMs);
+
+    this->hasPendingInput = false;
+}
+
+const InputLatencyStats& Camera::getLatencyStats() const
+{
+    return this->latencyStats;
+}
+
+void Camera::resetLatencyStats()
+{
+    this->latencyStats = InputLatencyStats();
+}
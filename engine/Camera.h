@@ -0,0 +1,46 @@
+#pragma once
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+
+class SDLAPI;
+
+struct InputLatencyStats
+{
+	uint32_t sampleCount = 0;
+	double totalMs = 0.0;
+	double maxMs = 0.0;
+};
+
+/*
+* Orbit camera read straight from SDL's input state instead of the event loop, so it can be
+* sampled again right before submit. Dragging with the left button orbits, W/S zoom and the
+* arrow keys orbit at a fixed rate.
+*/
+class Camera
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	float yaw = glm::radians(45.0f);
+	float pitch = glm::radians(35.26f);
+	float distance = 3.4641f;
+	glm::vec3 target{ 0.0f };
+	Clock::time_point lastSampleTime;
+	bool hasPendingInput = false;
+	bool moving = false;
+	uint32_t pendingInputTicks = 0;
+	uint32_t submittedTicks = 0;
+	InputLatencyStats latencyStats;
+
+public:
+	void sampleInput(SDLAPI& sdlApi);
+	glm::mat4 getViewMatrix() const;
+	bool isMoving() const;
+	void markSubmitted();
+	const InputLatencyStats& getLatencyStats() const;
+	void resetLatencyStats();
+};
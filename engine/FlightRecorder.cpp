@@ -0,0 +1,174 @@
+#include "FlightRecorder.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+const uint32_t RECORDED_FRAME_COUNT = 300;
+// Frames recorded after a hitch before the dump, so the trace shows how the engine recovered.
+const uint32_t FRAMES_AFTER_HITCH = 30;
+// Keeps a run of bad frames from filling the disk.
+const uint32_t MAX_DUMPS = 16;
+
+void FlightRecorder::init(double budgetMs)
+{
+    this->budgetMs = budgetMs;
+    this->frames.assign(RECORDED_FRAME_COUNT, FrameRecord());
+}
+
+void FlightRecorder::setEnabled(bool enabled)
+{
+    this->enabled = enabled;
+    this->dumpAtFrame = 0;
+}
+
+bool FlightRecorder::isEnabled() const
+{
+    return this->enabled;
+}
+
+void FlightRecorder::setBudgetMs(double budgetMs)
+{
+    this->budgetMs = budgetMs;
+}
+
+double FlightRecorder::getBudgetMs() const
+{
+    return this->budgetMs;
+}
+
+uint64_t FlightRecorder::getFrameNumber() const
+{
+    // Numbers start at 1 so 0 can mean "no frame".
+    return this->frameCount;
+}
+
+void FlightRecorder::beginFrame()
+{
+    if (!this->enabled)
+    {
+        return;
+    }
+
+    this->frameCount++;
+    FrameRecord& record = this->frames[this->frameCount % this->frames.size()];
+    record = FrameRecord();
+    record.frameNumber = this->frameCount;
+    record.startNs = Profiler::getTimestampNs();
+}
+
+void FlightRecorder::endFrame()
+{
+    if (!this->enabled)
+    {
+        return;
+    }
+
+    FrameRecord& record = this->frames[this->frameCount % this->frames.size()];
+    record.endNs = Profiler::getTimestampNs();
+
+    double frameMs = (record.endNs - record.startNs) / 1000000.0;
+    this->stats.worstFrameMs = std::max(this->stats.worstFrameMs, frameMs);
+    if (frameMs > this->budgetMs)
+    {
+        this->onHitch(record.frameNumber);
+    }
+
+    this->checkPendingWrite();
+    if ((this->dumpAtFrame != 0) && (this->frameCount >= this->dumpAtFrame))
+    {
+        this->dump();
+    }
+}
+
+void FlightRecorder::recordGpuTime(uint64_t frameNumber, double gpuTimeMs)
+{
+    FrameRecord* record = this->findFrame(frameNumber);
+    if (!this->enabled || (record == nullptr) || (record->endNs == 0))
+    {
+        return;
+    }
+
+    // Only the GPU duration is measured, so the zone is placed at the end of the frame's CPU work,
+    // where it was submitted.
+    record->gpuTimeMs = gpuTimeMs;
+    Profiler::recordGpuZone("GpuFrame", record->endNs, record->endNs + static_cast<uint64_t>(gpuTimeMs * 1000000.0));
+
+    if (gpuTimeMs > this->budgetMs)
+    {
+        this->onHitch(frameNumber);
+    }
+}
+
+const FlightRecorderStats& FlightRecorder::getStats() const
+{
+    return this->stats;
+}
+
+FrameRecord* FlightRecorder::findFrame(uint64_t frameNumber)
+{
+    if (this->frames.empty())
+    {
+        return nullptr;
+    }
+
+    FrameRecord& record = this->frames[frameNumber % this->frames.size()];
+    return (record.frameNumber == frameNumber) ? &record : nullptr;
+}
+
+void FlightRecorder::onHitch(uint64_t frameNumber)
+{
+    this->stats.hitchCount++;
+    Profiler::recordEvent("FrameOverBudget");
+
+    // A hitch while a dump is pending is already inside its window.
+    if ((this->dumpAtFrame == 0) && (this->stats.dumpCount < MAX_DUMPS))
+    {
+        this->hitchFrame = frameNumber;
+        this->dumpAtFrame = this->frameCount + FRAMES_AFTER_HITCH;
+    }
+}
+
+void FlightRecorder::dump()
+{
+    this->dumpAtFrame = 0;
+
+    // Hitches tend to come in runs; rather than stall the frame on the previous file, this one is skipped.
+    if (this->pendingWrite.valid())
+    {
+        return;
+    }
+
+    uint64_t firstFrame = (this->frameCount >= this->frames.size()) ? (this->frameCount - this->frames.size() + 1) : 1;
+    const FrameRecord* first = this->findFrame(firstFrame);
+    const FrameRecord* last = this->findFrame(this->frameCount);
+    if ((first == nullptr) || (last == nullptr))
+    {
+        return;
+    }
+
+    // Copying the zones has to happen now, before the rings wrap; formatting and writing them does not.
+    std::vector<ProfileZone> zones;
+    Profiler::collectZones(first->startNs, last->endNs, zones);
+
+    this->pendingWritePath = "hitch_" + std::to_string(this->hitchFrame) + ".json";
+    this->pendingWrite = std::async(std::launch::async, [path = this->pendingWritePath, zones = std::move(zones)]()
+    {
+        return Profiler::writeChromeTrace(path, zones);
+    });
+}
+
+void FlightRecorder::checkPendingWrite()
+{
+    if (!this->pendingWrite.valid() || (this->pendingWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+    {
+        return;
+    }
+
+    if (this->pendingWrite.get())
+    {
+        this->stats.dumpCount++;
+        std::cout << "Trace of the frame over the " << this->budgetMs << " ms budget written to " << this->pendingWritePath << std::endl;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+struct FrameRecord
+{
+	uint64_t frameNumber = 0;
+	uint64_t startNs = 0;
+	uint64_t endNs = 0;
+	// Negative until the frame's timestamp queries have been read back.
+	double gpuTimeMs = -1.0;
+};
+
+struct FlightRecorderStats
+{
+	uint32_t hitchCount = 0;
+	uint32_t dumpCount = 0;
+	double worstFrameMs = 0.0;
+};
+
+/*
+* Remembers the last few hundred frames so a sporadic stall can be looked at after the fact.
+* Zone timings and events come from the profiler's per-thread rings, so the profiler has to stay
+* enabled while the recorder is; it starts disabled and is switched on by the caller. GPU times
+* come from timestamp queries a few frames later. When a frame's CPU or GPU time goes over the
+* budget, the recorder waits for a few more frames, copies the window around the hitch out of the
+* rings and writes it to a Chrome trace file on a separate thread.
+*/
+class FlightRecorder
+{
+private:
+	bool enabled = false;
+	double budgetMs = 0.0;
+	std::vector<FrameRecord> frames;
+	uint64_t frameCount = 0;
+	// Frame whose completion triggers the pending dump, or 0 when none is pending.
+	uint64_t dumpAtFrame = 0;
+	uint64_t hitchFrame = 0;
+	FlightRecorderStats stats;
+	// Trace file being written off the frame thread; invalid when no write is in flight.
+	std::future<bool> pendingWrite;
+	std::string pendingWritePath;
+
+public:
+	void init(double budgetMs);
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	void setBudgetMs(double budgetMs);
+	double getBudgetMs() const;
+	uint64_t getFrameNumber() const;
+	void beginFrame();
+	void endFrame();
+	void recordGpuTime(uint64_t frameNumber, double gpuTimeMs);
+	const FlightRecorderStats& getStats() const;
+
+private:
+	FrameRecord* findFrame(uint64_t frameNumber);
+	void onHitch(uint64_t frameNumber);
+	void dump();
+	void checkPendingWrite();
+};
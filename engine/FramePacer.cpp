@@ -0,0 +1,157 @@
+#include "FramePacer.h"
+#include "Profiler.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+#include <algorithm>
+#include <thread>
+
+// Bounds on how long before the deadline to stop sleeping and start spinning. The starting margin
+// depends on the sleep in use and then tracks the overshoot measured on every sleep.
+const std::chrono::microseconds MIN_SPIN_MARGIN(500);
+const std::chrono::microseconds MAX_SPIN_MARGIN(20000);
+const std::chrono::microseconds HIGH_RESOLUTION_SPIN_MARGIN(1000);
+const std::chrono::microseconds COARSE_SPIN_MARGIN(16000);
+
+void FramePacer::init()
+{
+#if defined(_WIN32)
+    // Needs Windows 10 1803 or later; older versions fail the call and keep the coarse sleep.
+    this->waitableTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+
+    this->spinMargin = (this->waitableTimer != nullptr) ? HIGH_RESOLUTION_SPIN_MARGIN : COARSE_SPIN_MARGIN;
+}
+
+void FramePacer::release()
+{
+#if defined(_WIN32)
+    if (this->waitableTimer != nullptr)
+    {
+        CloseHandle(this->waitableTimer);
+        this->waitableTimer = nullptr;
+    }
+#endif
+}
+
+void FramePacer::setTargetFps(double fps)
+{
+    if (fps <= 0.0)
+    {
+        this->targetFrameTime = Clock::duration(0);
+    }
+    else
+    {
+        this->targetFrameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    }
+
+    this->nextDeadline = Clock::time_point();
+}
+
+double FramePacer::getTargetFps() const
+{
+    if (this->targetFrameTime.count() == 0)
+    {
+        return 0.0;
+    }
+
+    return 1.0 / std::chrono::duration<double>(this->targetFrameTime).count();
+}
+
+void FramePacer::waitForNextFrame()
+{
+    PROFILE_FUNCTION();
+    // Uncapped: nothing to wait for and no deadline to miss.
+    if (this->targetFrameTime.count() == 0)
+    {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (this->nextDeadline == Clock::time_point())
+    {
+        this->nextDeadline = now + this->targetFrameTime;
+        return;
+    }
+
+    if (now < this->nextDeadline)
+    {
+        if ((this->nextDeadline - now) > this->spinMargin)
+        {
+            Clock::time_point wakeTarget = this->nextDeadline - this->spinMargin;
+            this->sleepUntil(wakeTarget);
+
+            // Grow to the latest overshoot at once, and shrink slowly so one quick wake-up doesn't cost the next deadline.
+            Clock::duration overshoot = std::max(Clock::now() - wakeTarget, Clock::duration(0));
+            Clock::duration margin = std::max(overshoot + MIN_SPIN_MARGIN, this->spinMargin - this->spinMargin / 64);
+            this->spinMargin = std::min<Clock::duration>(margin, MAX_SPIN_MARGIN);
+        }
+
+        while (Clock::now() < this->nextDeadline)
+        {
+            std::this_thread::yield();
+        }
+
+        now = Clock::now();
+    }
+    else
+    {
+        this->stats.missedFrames++;
+    }
+
+    double errorMs = std::chrono::duration<double, std::milli>(now - this->nextDeadline).count();
+    this->stats.frameCount++;
+    this->stats.totalErrorMs += errorMs;
+    this->stats.maxErrorMs = std::max(this->stats.maxErrorMs, errorMs);
+
+    // Keep the cadence when slightly late, but don't try to catch up after a long stall.
+    this->nextDeadline += this->targetFrameTime;
+    if (this->nextDeadline < now)
+    {
+        this->nextDeadline = now + this->targetFrameTime;
+    }
+}
+
+void FramePacer::sleepUntil(Clock::time_point deadline)
+{
+#if defined(_WIN32)
+    if (this->waitableTimer != nullptr)
+    {
+        // A negative due time is relative, in 100 ns units.
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count() / 100);
+        if ((dueTime.QuadPart < 0) && SetWaitableTimerEx(this->waitableTimer, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+        {
+            WaitForSingleObject(this->waitableTimer, INFINITE);
+        }
+
+        return;
+    }
+#endif
+
+    std::this_thread::sleep_until(deadline);
+}
+
+void FramePacer::restart()
+{
+    // After an idle period the old deadline is meaningless; start a new cadence from the next frame.
+    this->nextDeadline = Clock::time_point();
+}
+
+const PacingStats& FramePacer::getStats() const
+{
+    return this->stats;
+}
+
+void FramePacer::resetStats()
+{
+    this->stats = PacingStats();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct PacingStats
+{
+	uint32_t frameCount = 0;
+	uint32_t missedFrames = 0;
+	double totalErrorMs = 0.0;
+	double maxErrorMs = 0.0;
+};
+
+/*
+* Paces frames against absolute deadlines, so time spent rendering is subtracted from the wait.
+* Sleeps until shortly before the deadline and spins for the rest. On Windows the sleep uses a
+* high resolution waitable timer, since plain sleeps round up to the ~15.6 ms scheduler tick; the
+* spin margin follows the overshoot the sleeps actually show.
+*/
+class FramePacer
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::duration targetFrameTime{ 0 };
+	Clock::time_point nextDeadline;
+	Clock::duration spinMargin{ 0 };
+	PacingStats stats;
+	// HANDLE of the waitable timer, kept as void* so the header doesn't pull in Windows.h.
+	void* waitableTimer = nullptr;
+
+public:
+	void init();
+	void release();
+	void setTargetFps(double fps);
+	double getTargetFps() const;
+	void waitForNextFrame();
+	void restart();
+	const PacingStats& getStats() const;
+	void resetStats();
+
+private:
+	void sleepUntil(Clock::time_point deadline);
+};
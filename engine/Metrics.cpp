@@ -0,0 +1,163 @@
+#include "Metrics.h"
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+enum MetricKind : uint32_t
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+void MetricCounter::increment(double amount)
+{
+    this->value += amount;
+}
+
+void MetricGauge::set(double value)
+{
+    this->value = value;
+}
+
+void MetricHistogram::observe(double value)
+{
+    // Buckets are cumulative, as Prometheus expects: a value counts in every bucket it fits under.
+    for (size_t i = 0; i < this->bounds.size(); i++)
+    {
+        if (value <= this->bounds[i])
+        {
+            this->bucketCounts[i]++;
+        }
+    }
+
+    this->sum += value;
+    this->count++;
+}
+
+void writeMetricHeader(std::ostringstream& output, std::set<std::string>& writtenNames, const std::string& name, const std::string& help,
+    const char* type)
+{
+    if (writtenNames.insert(name).second)
+    {
+        output << "# HELP " << name << " " << help << "\n";
+        output << "# TYPE " << name << " " << type << "\n";
+    }
+}
+
+void writeMetricSample(std::ostringstream& output, const std::string& name, const std::string& labels, double value)
+{
+    output << name;
+    if (!labels.empty())
+    {
+        output << "{" << labels << "}";
+    }
+
+    output << " " << value << "\n";
+}
+
+MetricCounter* MetricsRegistry::addCounter(const std::string& name, const std::string& help, const std::string& labels)
+{
+    this->order.push_back({ METRIC_COUNTER, static_cast<uint32_t>(this->counters.size()) });
+    this->counters.push_back(MetricCounter{ name, help, labels });
+    return &this->counters.back();
+}
+
+MetricGauge* MetricsRegistry::addGauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+    this->order.push_back({ METRIC_GAUGE, static_cast<uint32_t>(this->gauges.size()) });
+    this->gauges.push_back(MetricGauge{ name, help, labels });
+    return &this->gauges.back();
+}
+
+MetricHistogram* MetricsRegistry::addHistogram(const std::string& name, const std::string& help, const std::vector<double>& bounds)
+{
+    this->order.push_back({ METRIC_HISTOGRAM, static_cast<uint32_t>(this->histograms.size()) });
+
+    MetricHistogram histogram;
+    histogram.name = name;
+    histogram.help = help;
+    histogram.bounds = bounds;
+    histogram.bucketCounts.assign(bounds.size(), 0);
+    this->histograms.push_back(histogram);
+    return &this->histograms.back();
+}
+
+void MetricsRegistry::setOutput(const std::string& path, std::chrono::milliseconds interval)
+{
+    this->outputPath = path;
+    this->writeInterval = interval;
+}
+
+bool MetricsRegistry::isWriteDue() const
+{
+    return !this->outputPath.empty() && ((std::chrono::steady_clock::now() - this->lastWrite) >= this->writeInterval);
+}
+
+std::string MetricsRegistry::format() const
+{
+    std::ostringstream output;
+    output.precision(17);
+    std::set<std::string> writtenNames;
+
+    for (const std::pair<uint32_t, uint32_t>& entry : this->order)
+    {
+        if (entry.first == METRIC_COUNTER)
+        {
+            const MetricCounter& counter = this->counters[entry.second];
+            writeMetricHeader(output, writtenNames, counter.name, counter.help, "counter");
+            writeMetricSample(output, counter.name, counter.labels, counter.value);
+        }
+        else if (entry.first == METRIC_GAUGE)
+        {
+            const MetricGauge& gauge = this->gauges[entry.second];
+            writeMetricHeader(output, writtenNames, gauge.name, gauge.help, "gauge");
+            writeMetricSample(output, gauge.name, gauge.labels, gauge.value);
+        }
+        else
+        {
+            const MetricHistogram& histogram = this->histograms[entry.second];
+            writeMetricHeader(output, writtenNames, histogram.name, histogram.help, "histogram");
+            for (size_t i = 0; i < histogram.bounds.size(); i++)
+            {
+                std::ostringstream bound;
+                bound << histogram.bounds[i];
+                writeMetricSample(output, histogram.name + "_bucket", "le=\"" + bound.str() + "\"", static_cast<double>(histogram.bucketCounts[i]));
+            }
+
+            writeMetricSample(output, histogram.name + "_bucket", "le=\"+Inf\"", static_cast<double>(histogram.count));
+            writeMetricSample(output, histogram.name + "_sum", "", histogram.sum);
+            writeMetricSample(output, histogram.name + "_count", "", static_cast<double>(histogram.count));
+        }
+    }
+
+    return output.str();
+}
+
+bool MetricsRegistry::write()
+{
+    this->lastWrite = std::chrono::steady_clock::now();
+
+    // Written next to the target and renamed over it, so a scraper never reads a partial file.
+    std::string temporaryPath = this->outputPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        file << this->format();
+        if (!file.good())
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, this->outputPath, error);
+
+    return !error;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct MetricCounter
+{
+	std::string name;
+	std::string help;
+	std::string labels;
+	double value = 0.0;
+
+	void increment(double amount = 1.0);
+};
+
+struct MetricGauge
+{
+	std::string name;
+	std::string help;
+	std::string labels;
+	double value = 0.0;
+
+	void set(double value);
+};
+
+struct MetricHistogram
+{
+	std::string name;
+	std::string help;
+	// Upper bounds of the buckets, ascending; the +Inf bucket is implied.
+	std::vector<double> bounds;
+	std::vector<uint64_t> bucketCounts;
+	double sum = 0.0;
+	uint64_t count = 0;
+
+	void observe(double value);
+};
+
+/*
+* Counters, gauges and histograms the running engine exposes for monitoring. The registry is
+* written periodically to a file in the Prometheus text exposition format, replacing the previous
+* file atomically, so node_exporter's textfile collector or any script can scrape it.
+*
+* Metrics are owned by the registry and stay at the same address, so callers keep the pointers the
+* add functions return. Everything runs on the main thread; nothing is locked. Metrics sharing a
+* name but differing in labels must be added one after the other so their samples are grouped.
+*/
+class MetricsRegistry
+{
+private:
+	std::deque<MetricCounter> counters;
+	std::deque<MetricGauge> gauges;
+	std::deque<MetricHistogram> histograms;
+	// Order the metrics were added in, as (kind, index) pairs, which is also the output order.
+	std::vector<std::pair<uint32_t, uint32_t>> order;
+	std::string outputPath;
+	std::chrono::steady_clock::duration writeInterval{ 0 };
+	std::chrono::steady_clock::time_point lastWrite;
+
+public:
+	MetricCounter* addCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+	MetricGauge* addGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	MetricHistogram* addHistogram(const std::string& name, const std::string& help, const std::vector<double>& bounds);
+	void setOutput(const std::string& path, std::chrono::milliseconds interval);
+	bool isWriteDue() const;
+	std::string format() const;
+	bool write();
+};
@@ -1,31 +1,248 @@
 #include "Platform.h"
+#include "Profiler.h"
 
+#include "SDL2/SDL_keycode.h"
 #include "SDL2/SDL_video.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+const double DEFAULT_TARGET_FPS = 60.0;
+
+// Upper bound on a blocking wait while idle, so periodic work like writing metrics still runs.
+const int IDLE_WAIT_TIMEOUT_MS = 250;
+
+const std::string PROFILE_TRACE_PATH = "profile.json";
+
+// CPU or GPU time a single frame may take before the flight recorder dumps a trace, as a multiple
+// of the paced frame interval, or in milliseconds when frames aren't paced.
+const double HITCH_BUDGET_FRAMES = 3.0;
+const double UNCAPPED_HITCH_BUDGET_MS = 50.0;
+
+// Picked up by node_exporter's textfile collector when written into its directory.
+const std::string METRICS_PATH = "metrics.prom";
+const std::chrono::milliseconds METRICS_WRITE_INTERVAL{ 1000 };
+
 Platform::~Platform()
 {
+    this->setProfiling(false);
     vulkanApi.preRelease();
     sdlApi.release();
     vulkanApi.release();
+    framePacer.release();
 }
 
-void Platform::init()
+void Platform::init(const std::vector<std::string>& args)
 {
+    Profiler::setThreadName("Main");
+
+    // The flight recorder needs the profiler running for every frame, so it is off unless asked for
+    // with --flight-recorder or toggled with Scroll Lock.
+    bool flightRecording = false;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (args[i] == "--flight-recorder")
+        {
+            flightRecording = true;
+        }
+        else if ((args[i] == "--hitch-budget-ms") && (i + 1 < args.size()))
+        {
+            this->hitchBudgetMs = std::max(0.0, std::atof(args[++i].c_str()));
+        }
+    }
+
+    flightRecorder.init(UNCAPPED_HITCH_BUDGET_MS);
+    vulkanApi.setFlightRecorder(&flightRecorder);
+    this->setFlightRecording(flightRecording);
+
+    // Debug builds capture from the start so initialization shows up; release builds only on request.
+#if defined(_DEBUG)
+    this->setProfiling(true);
+#endif
+
     sdlApi.init(SDL_WINDOW_VULKAN);
     vulkanApi.init(sdlApi);
+    framePacer.init();
+    this->setTargetFps(DEFAULT_TARGET_FPS);
+    this->initMetrics();
+}
+
+void Platform::initMetrics()
+{
+    // Buckets around the common refresh intervals, up to the hitch budget and beyond.
+    this->framesMetric = metrics.addCounter("engine_frames_total", "Frames drawn since start.");
+    this->frameTimeMetric = metrics.addHistogram("engine_frame_time_seconds", "Time between consecutive drawn frames.",
+        { 0.004, 0.008, 0.0167, 0.0333, 0.05, 0.1, 0.25 });
+    this->hitchesMetric = metrics.addCounter("engine_hitches_total", "Frames over the flight recorder's budget.");
+    this->hitchTracesMetric = metrics.addCounter("engine_hitch_traces_total", "Hitch traces the flight recorder wrote.");
+    this->worstFrameMetric = metrics.addGauge("engine_worst_frame_seconds", "Longest frame the flight recorder has seen.");
+    this->pacingErrorMetric = metrics.addGauge("engine_pacing_error_seconds", "Average distance of frames from their deadline since the last write.");
+    this->pacingErrorMaxMetric = metrics.addGauge("engine_pacing_error_max_seconds", "Largest distance of a frame from its deadline since the last write.");
+    this->missedFramesMetric = metrics.addCounter("engine_missed_frames_total", "Frames that finished after their pacing deadline.");
+    vulkanApi.setMetrics(&metrics);
+    metrics.setOutput(METRICS_PATH, METRICS_WRITE_INTERVAL);
 }
 
 void Platform::processInput(bool& stillRunning)
 {
+    // Nothing on screen can change without an event, so block on the queue instead of spinning
+    // the render loop.
+    if (this->idle)
+    {
+        sdlApi.waitForEvents(IDLE_WAIT_TIMEOUT_MS);
+    }
+
     sdlApi.processInput(stillRunning);
+
+    if (sdlApi.wasResized())
+    {
+        vulkanApi.onWindowResized();
+    }
+    else if (sdlApi.hasReceivedEvents())
+    {
+        vulkanApi.requestRedraw();
+    }
+
+    for (int key : sdlApi.getKeyPresses())
+    {
+        if (key == SDLK_F4)
+        {
+            this->setTargetFps((framePacer.getTargetFps() > 0.0) ? 0.0 : DEFAULT_TARGET_FPS);
+        }
+        else if (key == SDLK_F9)
+        {
+            bool benchmark = !vulkanApi.isBenchmarkMode();
+            vulkanApi.setBenchmarkMode(benchmark);
+            this->setTargetFps(benchmark ? 0.0 : DEFAULT_TARGET_FPS);
+        }
+        else if (key == SDLK_PAUSE)
+        {
+            this->setProfiling(!this->profiling);
+        }
+        else if (key == SDLK_SCROLLLOCK)
+        {
+            this->setFlightRecording(!flightRecorder.isEnabled());
+        }
+
+        vulkanApi.onKeyPressed(key);
+    }
 }
 
 void Platform::drawFrame()
 {
+    bool wasIdle = this->idle;
+    this->idle = sdlApi.isMinimized() || !vulkanApi.needsRedraw();
+    this->frameDrawn = !this->idle;
+
+    if (!this->frameDrawn)
+    {
+        return;
+    }
+
+    if (wasIdle)
+    {
+        framePacer.restart();
+    }
+
+    flightRecorder.beginFrame();
     vulkanApi.drawFrame();
+    flightRecorder.endFrame();
+
+    // The first frame after idling would count the idle time, so it only restarts the interval.
+    auto currentTime = std::chrono::steady_clock::now();
+    if (!wasIdle && (this->lastFrameTime != std::chrono::steady_clock::time_point()))
+    {
+        this->frameTimeMetric->observe(std::chrono::duration<double>(currentTime - this->lastFrameTime).count());
+    }
+
+    this->lastFrameTime = currentTime;
+    this->framesMetric->increment();
 }
 
 void Platform::processFrameEnd()
 {
-    sdlApi.processFrameEnd();
+    if (this->frameDrawn)
+    {
+        framePacer.waitForNextFrame();
+    }
+
+    this->writeMetrics();
+}
+
+void Platform::writeMetrics()
+{
+    // Checked every loop, including while idle, since the idle wait is bounded.
+    if (!metrics.isWriteDue())
+    {
+        return;
+    }
+
+    const FlightRecorderStats& hitchStats = flightRecorder.getStats();
+    this->hitchesMetric->value = static_cast<double>(hitchStats.hitchCount);
+    this->hitchTracesMetric->value = static_cast<double>(hitchStats.dumpCount);
+    this->worstFrameMetric->set(hitchStats.worstFrameMs / 1000.0);
+
+    // Pacing stats cover the interval since the previous write.
+    const PacingStats& pacingStats = framePacer.getStats();
+    if (pacingStats.frameCount > 0)
+    {
+        this->pacingErrorMetric->set(pacingStats.totalErrorMs / pacingStats.frameCount / 1000.0);
+        this->pacingErrorMaxMetric->set(pacingStats.maxErrorMs / 1000.0);
+        this->missedFramesMetric->increment(pacingStats.missedFrames);
+    }
+
+    framePacer.resetStats();
+    vulkanApi.sampleMetrics();
+    metrics.write();
+}
+
+void Platform::setProfiling(bool enabled)
+{
+    if (enabled == this->profiling)
+    {
+        return;
+    }
+
+    // A capture covers the zones recorded between starting and stopping it.
+    this->profiling = enabled;
+    Profiler::setEnabled(this->profiling || flightRecorder.isEnabled());
+    if (enabled)
+    {
+        this->profilingStartNs = Profiler::getTimestampNs();
+        return;
+    }
+
+    std::vector<ProfileZone> zones;
+    Profiler::collectZones(this->profilingStartNs, Profiler::getTimestampNs(), zones);
+    if (Profiler::writeChromeTrace(PROFILE_TRACE_PATH, zones))
+    {
+        std::cout << "Profile written to " << PROFILE_TRACE_PATH << std::endl;
+    }
+    else
+    {
+        std::cout << "Couldn't write profile to " << PROFILE_TRACE_PATH << std::endl;
+    }
+}
+
+void Platform::setTargetFps(double fps)
+{
+    // A hitch is a frame several intervals long, so the budget follows the pacing target unless it was given.
+    framePacer.setTargetFps(fps);
+    if (this->hitchBudgetMs > 0.0)
+    {
+        flightRecorder.setBudgetMs(this->hitchBudgetMs);
+    }
+    else
+    {
+        flightRecorder.setBudgetMs((fps > 0.0) ? (HITCH_BUDGET_FRAMES * 1000.0 / fps) : UNCAPPED_HITCH_BUDGET_MS);
+    }
+}
+
+void Platform::setFlightRecording(bool enabled)
+{
+    // The flight recorder reads zones from the profiler, so while it runs the profiler stays enabled.
+    flightRecorder.setEnabled(enabled);
+    Profiler::setEnabled(this->profiling || flightRecorder.isEnabled());
 }
@@ -1,17 +1,49 @@
 #pragma once
 
 #include "vulkan/VulkanAPI.h"
+#include "FramePacer.h"
+#include "FlightRecorder.h"
+#include "Metrics.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
 
 class Platform
 {
 private:
 	SDLAPI sdlApi;
 	VulkanAPI vulkanApi;
+	FramePacer framePacer;
+	FlightRecorder flightRecorder;
+	MetricsRegistry metrics;
+	MetricCounter* framesMetric = nullptr;
+	MetricHistogram* frameTimeMetric = nullptr;
+	MetricCounter* hitchesMetric = nullptr;
+	MetricCounter* hitchTracesMetric = nullptr;
+	MetricGauge* worstFrameMetric = nullptr;
+	MetricGauge* pacingErrorMetric = nullptr;
+	MetricGauge* pacingErrorMaxMetric = nullptr;
+	MetricCounter* missedFramesMetric = nullptr;
+	std::chrono::steady_clock::time_point lastFrameTime;
+	bool frameDrawn = false;
+	bool idle = false;
+	bool profiling = false;
+	uint64_t profilingStartNs = 0;
+	// Set with --hitch-budget-ms; 0 derives the flight recorder's budget from the pacing target.
+	double hitchBudgetMs = 0.0;
 
 public:
 	~Platform();
-	void init();
+	void init(const std::vector<std::string>& args);
 	void processInput(bool& stillRunning);
 	void drawFrame();
 	void processFrameEnd();
+
+private:
+	void setProfiling(bool enabled);
+	void setFlightRecording(bool enabled);
+	void setTargetFps(double fps);
+	void initMetrics();
+	void writeMetrics();
 };
@@ -0,0 +1,227 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+// Zones kept per thread; older ones are overwritten. Must be a power of two.
+const uint64_t ZONES_PER_THREAD = 1 << 15;
+
+// A ProfileZone split into atomics, since collectZones may read a slot while its thread overwrites it.
+// Relaxed accesses are enough: the write count orders them, and torn copies are dropped afterwards.
+struct ZoneSlot
+{
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> startNs{ 0 };
+    std::atomic<uint64_t> endNs{ 0 };
+    std::atomic<bool> instant{ false };
+};
+
+struct ThreadBuffer
+{
+    uint32_t threadId = 0;
+    std::string threadName;
+    std::unique_ptr<ZoneSlot[]> zones;
+    // Only the owning thread writes; readers load it with acquire to see complete zones.
+    std::atomic<uint64_t> writeCount{ 0 };
+};
+
+std::atomic<bool> profilerEnabled{ false };
+const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+// Guards the buffer list only, which changes once per thread; zones are written without it.
+std::mutex threadBuffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+thread_local ThreadBuffer* currentThreadBuffer = nullptr;
+ThreadBuffer* gpuThreadBuffer = nullptr;
+
+ThreadBuffer* createThreadBuffer(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(threadBuffersMutex);
+    std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+    buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+    buffer->threadName = name.empty() ? ("Thread " + std::to_string(buffer->threadId)) : name;
+    buffer->zones.reset(new ZoneSlot[ZONES_PER_THREAD]);
+    threadBuffers.push_back(std::move(buffer));
+
+    return threadBuffers.back().get();
+}
+
+ThreadBuffer* getThreadBuffer()
+{
+    if (currentThreadBuffer == nullptr)
+    {
+        currentThreadBuffer = createThreadBuffer("");
+    }
+
+    return currentThreadBuffer;
+}
+
+void appendZone(ThreadBuffer* buffer, const char* name, uint64_t startNs, uint64_t endNs, bool instant)
+{
+    uint64_t index = buffer->writeCount.load(std::memory_order_relaxed);
+
+    ZoneSlot& slot = buffer->zones[index & (ZONES_PER_THREAD - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.instant.store(instant, std::memory_order_relaxed);
+
+    buffer->writeCount.store(index + 1, std::memory_order_release);
+}
+
+void writeJsonString(std::ofstream& file, const std::string& text)
+{
+    file << '"';
+    for (char character : text)
+    {
+        if ((character == '"') || (character == '\\'))
+        {
+            file << '\\';
+        }
+
+        file << character;
+    }
+    file << '"';
+}
+
+bool Profiler::isEnabled()
+{
+    return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::getTimestampNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerEpoch).count());
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer* buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(threadBuffersMutex);
+    buffer->threadName = name;
+}
+
+void Profiler::recordZone(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    appendZone(getThreadBuffer(), name, startNs, endNs, false);
+}
+
+void Profiler::recordEvent(const char* name)
+{
+    uint64_t timestamp = getTimestampNs();
+    appendZone(getThreadBuffer(), name, timestamp, timestamp, true);
+}
+
+void Profiler::recordGpuZone(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    if (gpuThreadBuffer == nullptr)
+    {
+        gpuThreadBuffer = createThreadBuffer("GPU");
+    }
+
+    appendZone(gpuThreadBuffer, name, startNs, endNs, false);
+}
+
+void Profiler::collectZones(uint64_t beginNs, uint64_t endNs, std::vector<ProfileZone>& zones)
+{
+    std::lock_guard<std::mutex> lock(threadBuffersMutex);
+    std::vector<uint64_t> copiedIndices;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : threadBuffers)
+    {
+        size_t bufferStart = zones.size();
+        copiedIndices.clear();
+
+        uint64_t count = buffer->writeCount.load(std::memory_order_acquire);
+        uint64_t first = (count > ZONES_PER_THREAD) ? (count - ZONES_PER_THREAD) : 0;
+        for (uint64_t i = first; i < count; i++)
+        {
+            const ZoneSlot& slot = buffer->zones[i & (ZONES_PER_THREAD - 1)];
+            ProfileZone zone;
+            zone.name = slot.name.load(std::memory_order_relaxed);
+            zone.startNs = slot.startNs.load(std::memory_order_relaxed);
+            zone.endNs = slot.endNs.load(std::memory_order_relaxed);
+            zone.threadId = buffer->threadId;
+            zone.instant = slot.instant.load(std::memory_order_relaxed);
+
+            if ((zone.endNs >= beginNs) && (zone.startNs <= endNs))
+            {
+                zones.push_back(zone);
+                copiedIndices.push_back(i);
+            }
+        }
+
+        // The thread may have kept recording during the copy and wrapped over the oldest slots. Like a
+        // sequence lock, the write count is read again afterwards, and copies of any slot it could have
+        // reached, including the one it may be writing right now, are dropped since they may mix an old
+        // zone with a new one.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t countAfter = buffer->writeCount.load(std::memory_order_relaxed) + 1;
+        uint64_t firstIntact = (countAfter > ZONES_PER_THREAD) ? (countAfter - ZONES_PER_THREAD) : 0;
+        size_t overwritten = static_cast<size_t>(std::lower_bound(copiedIndices.begin(), copiedIndices.end(), firstIntact) - copiedIndices.begin());
+        zones.erase(zones.begin() + bufferStart, zones.begin() + bufferStart + overwritten);
+    }
+}
+
+bool Profiler::writeChromeTrace(const std::string& path, const std::vector<ProfileZone>& zones)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(threadBuffersMutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : threadBuffers)
+        {
+            file << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+            writeJsonString(file, buffer->threadName);
+            file << "}}";
+            first = false;
+        }
+    }
+
+    // Chrome trace timestamps are in microseconds; the fraction keeps nanosecond precision.
+    file.precision(3);
+    file << std::fixed;
+    for (const ProfileZone& zone : zones)
+    {
+        file << (first ? "\n" : ",\n") << "{\"pid\":1,\"tid\":" << zone.threadId << ",\"ts\":" << (zone.startNs / 1000.0);
+        if (zone.instant)
+        {
+            file << ",\"ph\":\"i\",\"s\":\"g\",\"name\":";
+        }
+        else
+        {
+            file << ",\"ph\":\"X\",\"dur\":" << ((zone.endNs - zone.startNs) / 1000.0) << ",\"name\":";
+        }
+
+        writeJsonString(file, (zone.name != nullptr) ? zone.name : "");
+        file << "}";
+        first = false;
+    }
+
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+bool Profiler::exportChromeTrace(const std::string& path)
+{
+    std::vector<ProfileZone> zones;
+    collectZones(0, UINT64_MAX, zones);
+
+    return writeChromeTrace(path, zones);
+}
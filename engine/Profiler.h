@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ProfileZone
+{
+	const char* name = nullptr;
+	uint64_t startNs = 0;
+	uint64_t endNs = 0;
+	uint32_t threadId = 0;
+	// Instant events mark a point in time, such as a swapchain recreation, and have no duration.
+	bool instant = false;
+};
+
+/*
+* CPU zone profiler. Zones are timed by PROFILE_ZONE / PROFILE_FUNCTION scopes and appended to a
+* ring buffer owned by the recording thread, so recording takes no lock and never allocates after
+* the thread's first zone. When the profiler is disabled a scope costs one relaxed atomic load;
+* defining ENGINE_PROFILER_DISABLED compiles the scopes out entirely.
+*
+* Captures are exported as Chrome trace JSON, which chrome://tracing and Perfetto both open.
+* GPU work gets its own track, fed with durations measured by timestamp queries.
+*/
+namespace Profiler
+{
+	bool isEnabled();
+	void setEnabled(bool enabled);
+	uint64_t getTimestampNs();
+	void setThreadName(const std::string& name);
+	void recordZone(const char* name, uint64_t startNs, uint64_t endNs);
+	void recordEvent(const char* name);
+	// Only call from one thread at a time; the GPU track has a single writer like any other.
+	void recordGpuZone(const char* name, uint64_t startNs, uint64_t endNs);
+	// Zones overlapping [beginNs, endNs] from every thread, oldest first per thread. Threads may keep
+	// recording meanwhile; zones they overwrite during the copy are left out.
+	void collectZones(uint64_t beginNs, uint64_t endNs, std::vector<ProfileZone>& zones);
+	bool writeChromeTrace(const std::string& path, const std::vector<ProfileZone>& zones);
+	bool exportChromeTrace(const std::string& path);
+}
+
+class ProfileScope
+{
+private:
+	const char* name;
+	uint64_t startNs = 0;
+	bool active = false;
+
+public:
+	explicit ProfileScope(const char* name) : name(name)
+	{
+		if (Profiler::isEnabled())
+		{
+			this->active = true;
+			this->startNs = Profiler::getTimestampNs();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (this->active)
+		{
+			Profiler::recordZone(this->name, this->startNs, Profiler::getTimestampNs());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if defined(ENGINE_PROFILER_DISABLED)
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_EVENT(name)
+#else
+// The name must outlive the capture, so pass a string literal.
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_EVENT(name) do { if (Profiler::isEnabled()) { Profiler::recordEvent(name); } } while (false)
+#endif
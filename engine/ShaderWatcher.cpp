@@ -0,0 +1,111 @@
+#include "ShaderWatcher.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+const std::chrono::milliseconds SCAN_INTERVAL(500);
+
+void ShaderWatcher::init(const std::string& directory)
+{
+    this->directory = directory;
+
+#if defined(__linux__)
+    this->inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotifyDescriptor >= 0)
+    {
+        if (inotify_add_watch(this->inotifyDescriptor, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            close(this->inotifyDescriptor);
+            this->inotifyDescriptor = -1;
+        }
+    }
+#endif
+
+    if (this->inotifyDescriptor < 0)
+    {
+        this->scanWriteTimes();
+        this->lastScan = std::chrono::steady_clock::now();
+    }
+}
+
+std::vector<std::string> ShaderWatcher::pollChanges()
+{
+    std::vector<std::string> result;
+
+#if defined(__linux__)
+    if (this->inotifyDescriptor >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(this->inotifyDescriptor, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* pointer = buffer; pointer < buffer + length; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(pointer);
+                if (event->len > 0)
+                {
+                    result.push_back((std::filesystem::path(this->directory) / event->name).string());
+                }
+
+                pointer += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        return result;
+    }
+#endif
+
+    auto now = std::chrono::steady_clock::now();
+    if ((now - this->lastScan) >= SCAN_INTERVAL)
+    {
+        this->lastScan = now;
+        result = this->scanWriteTimes();
+    }
+
+    return result;
+}
+
+void ShaderWatcher::release()
+{
+#if defined(__linux__)
+    if (this->inotifyDescriptor >= 0)
+    {
+        close(this->inotifyDescriptor);
+        this->inotifyDescriptor = -1;
+    }
+#endif
+
+    this->writeTimes.clear();
+}
+
+std::vector<std::string> ShaderWatcher::scanWriteTimes()
+{
+    std::vector<std::string> result;
+    std::error_code error;
+
+    for (const auto& entry : std::filesystem::directory_iterator(this->directory, error))
+    {
+        if (!entry.is_regular_file(error))
+        {
+            continue;
+        }
+
+        std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        std::string path = entry.path().string();
+        auto previous = this->writeTimes.find(path);
+
+        if (previous == this->writeTimes.end())
+        {
+            this->writeTimes[path] = writeTime;
+        }
+        else if (previous->second != writeTime)
+        {
+            previous->second = writeTime;
+            result.push_back(path);
+        }
+    }
+
+    return result;
+}
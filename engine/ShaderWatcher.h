@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+* Reports files that changed in a directory. Uses inotify on Linux; elsewhere it compares write
+* times, at most a few times per second so polling every frame stays cheap.
+*/
+class ShaderWatcher
+{
+private:
+	std::string directory;
+	int inotifyDescriptor = -1;
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+	std::chrono::steady_clock::time_point lastScan;
+
+public:
+	void init(const std::string& directory);
+	std::vector<std::string> pollChanges();
+	void release();
+
+private:
+	std::vector<std::string> scanWriteTimes();
+};
@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool()
+{
+    // The calling thread also takes part in parallelFor, so leave one core for it.
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workerCount = hardwareThreads - 1;
+
+    this->workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        this->workers.emplace_back([this, i]()
+        {
+            Profiler::setThreadName("Worker " + std::to_string(i));
+            this->workerLoop();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        this->stopping = true;
+    }
+
+    this->tasksCondition.notify_all();
+    for (std::thread& worker : this->workers)
+    {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getWorkerCount() const
+{
+    return static_cast<uint32_t>(this->workers.size());
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        this->tasks.push(std::move(task));
+    }
+
+    this->tasksCondition.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function)
+{
+    minBatchSize = std::max(minBatchSize, 1u);
+    uint32_t maxBatches = this->getWorkerCount() + 1;
+    uint32_t batchCount = std::min(maxBatches, (count + minBatchSize - 1) / minBatchSize);
+
+    if (batchCount <= 1)
+    {
+        function(0, count);
+        return;
+    }
+
+    uint32_t batchSize = (count + batchCount - 1) / batchCount;
+    this->parallelForBatches(batchCount, [&](uint32_t batchIndex)
+    {
+        uint32_t begin = std::min(batchIndex * batchSize, count);
+        uint32_t end = std::min(begin + batchSize, count);
+        function(begin, end);
+    });
+}
+
+void ThreadPool::parallelForBatches(uint32_t batchCount, const std::function<void(uint32_t batchIndex)>& function)
+{
+    if (batchCount == 0)
+    {
+        return;
+    }
+
+    uint32_t pendingBatches = batchCount - 1;
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+
+    for (uint32_t batch = 1; batch < batchCount; batch++)
+    {
+        this->submit([&, batch]()
+        {
+            function(batch);
+
+            // Notify under the lock so the caller can't return and destroy the condition first.
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--pendingBatches == 0)
+            {
+                doneCondition.notify_one();
+            }
+        });
+    }
+
+    // The calling thread always takes the first batch.
+    function(0);
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&]() { return pendingBatches == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->tasksMutex);
+            this->tasksCondition.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+            if (this->stopping && this->tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex tasksMutex;
+	std::condition_variable tasksCondition;
+	bool stopping = false;
+
+public:
+	ThreadPool();
+	~ThreadPool();
+
+	uint32_t getWorkerCount() const;
+	void submit(std::function<void()> task);
+	void parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+	void parallelForBatches(uint32_t batchCount, const std::function<void(uint32_t batchIndex)>& function);
+
+private:
+	void workerLoop();
+};
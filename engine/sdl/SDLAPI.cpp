@@ -24,15 +24,56 @@ void SDLAPI::init(int windowFlags)
 
 void SDLAPI::processInput(bool& stillRunning)
 {
+    this->keyPresses.clear();
+    this->resized = false;
+    this->receivedEvents = false;
+
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
 
+        this->receivedEvents = true;
+
+        // Input latency starts when the event arrived, not when the main loop got to it.
+        bool isInput = (event.type >= SDL_KEYDOWN) && (event.type <= SDL_MOUSEWHEEL);
+        if (isInput && !this->hasPendingInput)
+        {
+            this->hasPendingInput = true;
+            this->pendingInputTicks = event.common.timestamp;
+        }
+
         switch (event.type) {
 
         case SDL_QUIT:
             stillRunning = false;
             break;
 
+        case SDL_KEYDOWN:
+            if (event.key.repeat == 0)
+            {
+                this->keyPresses.push_back(event.key.keysym.sym);
+            }
+            break;
+
+        case SDL_WINDOWEVENT:
+            switch (event.window.event)
+            {
+            case SDL_WINDOWEVENT_MINIMIZED:
+            case SDL_WINDOWEVENT_HIDDEN:
+                this->minimized = true;
+                break;
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+            case SDL_WINDOWEVENT_SHOWN:
+                this->minimized = false;
+                break;
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+                this->resized = true;
+                break;
+            default:
+                break;
+            }
+            break;
+
         default:
             // Do nothing.
             break;
@@ -40,9 +81,42 @@ void SDLAPI::processInput(bool& stillRunning)
     }
 }
 
-void SDLAPI::processFrameEnd()
+const std::vector<int>& SDLAPI::getKeyPresses() const
+{
+    return this->keyPresses;
+}
+
+bool SDLAPI::isMinimized() const
+{
+    return this->minimized;
+}
+
+bool SDLAPI::wasResized() const
+{
+    return this->resized;
+}
+
+bool SDLAPI::hasReceivedEvents() const
+{
+    return this->receivedEvents;
+}
+
+bool SDLAPI::takePendingInput(uint32_t& ticks)
+{
+    if (!this->hasPendingInput)
+    {
+        return false;
+    }
+
+    ticks = this->pendingInputTicks;
+    this->hasPendingInput = false;
+    return true;
+}
+
+void SDLAPI::waitForEvents(int timeoutMs)
 {
-    SDL_Delay(17);
+    // A null event leaves whatever arrives in the queue for processInput.
+    SDL_WaitEventTimeout(nullptr, timeoutMs);
 }
 
 void SDLAPI::release()
@@ -1,18 +1,34 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 class SDLAPI
 {
 private:
 	struct SDL_Window* window;
 	bool initialized = false;
+	std::vector<int> keyPresses;
+	bool minimized = false;
+	bool resized = false;
+	bool receivedEvents = false;
+	// SDL timestamp of the oldest input event handled since the camera last took it.
+	bool hasPendingInput = false;
+	uint32_t pendingInputTicks = 0;
 
 private:
 	void init(int windowFlags);
 	void processInput(bool& stillRunning);
-	void processFrameEnd();
+	const std::vector<int>& getKeyPresses() const;
+	bool isMinimized() const;
+	bool wasResized() const;
+	bool hasReceivedEvents() const;
+	bool takePendingInput(uint32_t& ticks);
+	void waitForEvents(int timeoutMs);
 
 	void release();
 
 friend class Platform;
 friend class VulkanAPI;
+friend class Camera;
 };
@@ -0,0 +1,128 @@
+#include "BindlessDescriptors.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <stdexcept>
+
+vk::DescriptorPool bindlessPool;
+vk::DescriptorSet bindlessSet;
+
+void BindlessDescriptors::init(vk::Device* logicalDevice, const vk::DescriptorSetLayout& layout, const std::vector<ReflectedBinding>& bindings,
+    uint32_t textureCapacity, uint32_t bufferCapacity)
+{
+    this->logicalDevice = logicalDevice;
+    this->textureCapacity = textureCapacity;
+    this->bufferCapacity = bufferCapacity;
+
+    bool hasTextures = false;
+    bool hasBuffers = false;
+    for (const ReflectedBinding& binding : bindings)
+    {
+        if (binding.descriptorType == static_cast<uint32_t>(vk::DescriptorType::eCombinedImageSampler))
+        {
+            this->textureBinding = binding.binding;
+            hasTextures = true;
+        }
+        else if (binding.descriptorType == static_cast<uint32_t>(vk::DescriptorType::eStorageBuffer))
+        {
+            this->bufferBinding = binding.binding;
+            hasBuffers = true;
+        }
+    }
+
+    if (!hasTextures || !hasBuffers)
+    {
+        throw std::runtime_error("Bindless shader doesn't declare the texture and buffer arrays!");
+    }
+
+    std::array<vk::DescriptorPoolSize, 2> poolSizes =
+    {
+        vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, this->textureCapacity },
+        vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, this->bufferCapacity }
+    };
+
+    vk::DescriptorPoolCreateInfo poolInfo = vk::DescriptorPoolCreateInfo()
+        .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+        .setMaxSets(1)
+        .setPoolSizes(poolSizes);
+
+    bindlessPool = this->logicalDevice->createDescriptorPool(poolInfo);
+
+    // The variable count applies to the set's last binding, whichever array that is.
+    uint32_t variableCount = (this->textureBinding > this->bufferBinding) ? this->textureCapacity : this->bufferCapacity;
+    vk::DescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo = vk::DescriptorSetVariableDescriptorCountAllocateInfo()
+        .setDescriptorCounts(variableCount);
+
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setPNext(&variableCountInfo)
+        .setDescriptorPool(bindlessPool)
+        .setSetLayouts(layout);
+
+    bindlessSet = this->logicalDevice->allocateDescriptorSets(allocInfo)[0];
+}
+
+bool BindlessDescriptors::isEnabled() const
+{
+    return this->logicalDevice != nullptr;
+}
+
+uint32_t BindlessDescriptors::addTexture(const vk::ImageView& imageView, const vk::Sampler& sampler)
+{
+    if (this->textureCount >= this->textureCapacity)
+    {
+        throw std::runtime_error("Out of bindless texture slots!");
+    }
+
+    vk::DescriptorImageInfo imageInfo(sampler, imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet write = vk::WriteDescriptorSet()
+        .setDstSet(bindlessSet)
+        .setDstBinding(this->textureBinding)
+        .setDstArrayElement(this->textureCount)
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+        .setImageInfo(imageInfo);
+
+    this->logicalDevice->updateDescriptorSets(write, nullptr);
+
+    return this->textureCount++;
+}
+
+uint32_t BindlessDescriptors::addBuffer(const vk::Buffer& buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+    if (this->bufferCount >= this->bufferCapacity)
+    {
+        throw std::runtime_error("Out of bindless buffer slots!");
+    }
+
+    vk::DescriptorBufferInfo bufferInfo(buffer, offset, range);
+    vk::WriteDescriptorSet write = vk::WriteDescriptorSet()
+        .setDstSet(bindlessSet)
+        .setDstBinding(this->bufferBinding)
+        .setDstArrayElement(this->bufferCount)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setBufferInfo(bufferInfo);
+
+    this->logicalDevice->updateDescriptorSets(write, nullptr);
+
+    return this->bufferCount++;
+}
+
+const vk::DescriptorSet& BindlessDescriptors::getDescriptorSet() const
+{
+    return bindlessSet;
+}
+
+void BindlessDescriptors::release()
+{
+    if (this->logicalDevice == nullptr)
+    {
+        return;
+    }
+
+    // Destroying the pool frees the set.
+    this->logicalDevice->destroyDescriptorPool(bindlessPool);
+    bindlessSet = nullptr;
+    this->textureCount = 0;
+    this->bufferCount = 0;
+    this->logicalDevice = nullptr;
+}
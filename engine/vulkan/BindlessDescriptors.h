@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+#include "ShaderReflection.h"
+
+#include <vector>
+
+const uint32_t BINDLESS_SET = 1;
+
+// Indices a draw hands to the bindless fragment shader through push constants.
+struct BindlessDrawConstants
+{
+	uint32_t materialBuffer = 0;
+	uint32_t materialIndex = 0;
+};
+
+/*
+* One descriptor set holding every texture and storage buffer in the scene as runtime-sized
+* arrays, indexed from shaders. Resources are written once when registered, with update-after-bind,
+* so the set is bound once per frame no matter how many textures there are and never reallocated.
+* Slots are only ever appended, so in-flight frames never see a descriptor they use change.
+*/
+class BindlessDescriptors
+{
+private:
+	vk::Device* logicalDevice = nullptr;
+	uint32_t textureBinding = 0;
+	uint32_t bufferBinding = 0;
+	uint32_t textureCapacity = 0;
+	uint32_t bufferCapacity = 0;
+	uint32_t textureCount = 0;
+	uint32_t bufferCount = 0;
+
+private:
+	void init(vk::Device* logicalDevice, const vk::DescriptorSetLayout& layout, const std::vector<ReflectedBinding>& bindings,
+		uint32_t textureCapacity, uint32_t bufferCapacity);
+	bool isEnabled() const;
+	uint32_t addTexture(const vk::ImageView& imageView, const vk::Sampler& sampler);
+	uint32_t addBuffer(const vk::Buffer& buffer, vk::DeviceSize offset, vk::DeviceSize range);
+	const vk::DescriptorSet& getDescriptorSet() const;
+	void release();
+
+friend class VulkanAPI;
+friend class CommandBuffers;
+};
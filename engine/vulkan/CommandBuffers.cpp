@@ -1,6 +1,11 @@
 #include "CommandBuffers.h"
 #include "Devices.h"
 #include "Swapchain.h"
+#include "RenderPass.h"
+#include "SyncObjects.h"
+#include "DescriptorSets.h"
+#include "engine/ThreadPool.h"
+#include "engine/Profiler.h"
 
 #include <vulkan/vulkan.hpp>
 
@@ -10,7 +15,11 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "dependencies/tiny_obj_loader.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <deque>
 #include <unordered_map>
 
 struct UniformBufferObject
@@ -18,6 +27,9 @@ struct UniformBufferObject
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
+    // Only read by shader variants with ShaderFeature::PrecomputedMvp. Derived from view, so
+    // latchView rewrites it together with view.
+    glm::mat4 modelViewProj;
 };
 
 vk::Buffer vertexBuffer;
@@ -34,33 +46,62 @@ vk::DeviceMemory textureImageMemory;
 vk::ImageView textureImageView;
 vk::Sampler textureSampler;
 
-vk::Image depthImage;
-vk::DeviceMemory depthImageMemory;
-vk::ImageView depthImageView;
+// Per-material texture indices read by the bindless fragment shader.
+vk::Buffer materialBuffer;
+vk::DeviceMemory materialBufferMemory;
+
+// One transient pool per frame in flight, reset wholesale once that frame's fence has signaled.
+// Primaries allocated from it are kept across resets and handed out bump-style each frame.
+std::vector<vk::CommandPool> frameCommandPools;
+std::vector<std::deque<vk::CommandBuffer>> frameCommandBuffers;
 
 const char* MODEL_PATH = "../../media/viking_room.obj";
 const char* TEXTURE_PATH = "../../media/viking_room.png";
 
-void CommandBuffers::init(const vk::SurfaceKHR& surface, Devices& devices, Swapchain& swapchain, int maxFramesInFlight)
+// Below this many draws per thread, recording inline is cheaper than fanning out to secondary buffers.
+const uint32_t MIN_DRAWS_PER_BATCH = 512;
+
+const char* CULLING_PASS = "GpuCulling";
+const char* MAIN_PASS = "Main";
+
+void CommandBuffers::init(const vk::SurfaceKHR& surface, Devices& devices, Swapchain& swapchain, SyncObjects* syncObjects,
+    int maxFramesInFlight, ThreadPool* threadPool)
 {
+    this->syncObjects = syncObjects;
+    this->threadPool = threadPool;
     QueueFamilyIndices queueFamilyIndices = devices.findQueueFamilies(surface);
 
     vk::Device* logicalDevice = devices.getDevice();
+    this->logicalDevice = logicalDevice;
+    this->queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
     this->createCommandPool(logicalDevice, queueFamilyIndices.graphicsFamily.value());
-    this->createDepthResources(devices, swapchain);
+    this->secondaryBuffers.init(logicalDevice, queueFamilyIndices.graphicsFamily.value(), maxFramesInFlight, threadPool->getWorkerCount() + 1);
     this->createTextureImage(devices);
     this->createTextureImageView(devices);
     this->createTextureSampler(devices);
     this->loadModel();
+    this->computeModelBounds();
+    this->frustumCulling.resize(1);
     this->createVertexBuffer(devices);
     this->createIndexBuffer(devices);
     this->createUniformBuffers(devices, maxFramesInFlight);
+
+    this->gpuCulling.init(devices, *this, maxFramesInFlight, 1);
+    if (this->gpuCulling.isEnabled())
+    {
+        this->gpuCulling.setInstance(0, model.bounds, static_cast<uint32_t>(model.indices.size()), 0, 0);
+    }
+
+    // Transient lifetimes depend on which passes the frame graph has, so depth waits for GPU culling to settle.
+    this->createDepthResources(devices, swapchain);
+    this->gpuTimer.init(devices, maxFramesInFlight);
 }
 
 void CommandBuffers::createCommandPool(vk::Device* logicalDevice, uint32_t queueFamilyIndex)
 {
+    // Only used for one-shot upload buffers, which are freed right after they complete.
     vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
-        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
         .setQueueFamilyIndex(queueFamilyIndex);
     vk::CommandPool commandPoolValue = logicalDevice->createCommandPool(poolInfo);
     this->commandPool = std::make_shared<vk::CommandPool>(commandPoolValue);
@@ -71,10 +112,40 @@ void CommandBuffers::createDepthResources(Devices& devices, Swapchain& swapchain
     const vk::Extent2D& swapchainExtent = swapchain.getExtent();
     
     vk::Format depthFormat = devices.findDepthFormat();
-    this->createImage(devices, swapchainExtent.width, swapchainExtent.height, depthFormat, vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, depthImage, depthImageMemory);
+    vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eDepth;
+    if (devices.hasStencilComponent(depthFormat))
+    {
+        aspectMask |= vk::ImageAspectFlagBits::eStencil;
+    }
+
+    // Depth is cleared on load and never stored, so it only lives during the main pass.
+    uint32_t mainPass = this->getPassIndex(MAIN_PASS);
+    this->depthTarget = this->transientImages.add("Depth", swapchainExtent.width, swapchainExtent.height, depthFormat,
+        static_cast<uint32_t>(vk::ImageUsageFlagBits::eDepthStencilAttachment), static_cast<VkImageAspectFlags>(aspectMask),
+        mainPass, mainPass);
 
-    depthImageView = devices.createImageView(depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth);
+    this->transientImages.allocate(devices);
+}
+
+uint32_t CommandBuffers::getPassIndex(const std::string& name) const
+{
+    // Transient image lifetimes are positions in the frame graph, which runs culling before the main pass.
+    std::vector<std::string> passes;
+    if (this->gpuCulling.isEnabled())
+    {
+        passes.push_back(CULLING_PASS);
+    }
+    passes.push_back(MAIN_PASS);
+
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        if (passes[i] == name)
+        {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Unknown render graph pass!");
 }
 
 void CommandBuffers::recreateDepthResources(Devices& devices, Swapchain& swapchain)
@@ -85,6 +156,7 @@ void CommandBuffers::recreateDepthResources(Devices& devices, Swapchain& swapcha
 
 void CommandBuffers::createTextureImage(Devices& devices)
 {
+    PROFILE_FUNCTION();
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(TEXTURE_PATH, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     vk::DeviceSize imageSize = texWidth * texHeight * 4;
@@ -94,6 +166,8 @@ void CommandBuffers::createTextureImage(Devices& devices)
         throw std::runtime_error("Failed to load texture image!");
     }
 
+    this->uploadedBytes += imageSize;
+
     vk::Buffer stagingBuffer;
     vk::DeviceMemory stagingBufferMemory;
     this->createBuffer(devices, imageSize, vk::BufferUsageFlagBits::eTransferSrc,
@@ -114,8 +188,7 @@ void CommandBuffers::createTextureImage(Devices& devices)
     this->copyBufferToImage(devices, stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
     this->transitionImageLayout(devices, textureImage, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
 
-    logicalDevice->destroyBuffer(stagingBuffer);
-    logicalDevice->freeMemory(stagingBufferMemory);
+    this->releaseStagingBuffer(logicalDevice, stagingBuffer, stagingBufferMemory);
 }
 
 void CommandBuffers::createImage(Devices& devices, uint32_t widith, uint32_t height, vk::Format format, vk::ImageTiling tiling,
@@ -154,44 +227,18 @@ void CommandBuffers::transitionImageLayout(Devices& devices, vk::Image& image, v
 {
     vk::CommandBuffer commandBuffer = this->beginSingleTimeCommands(devices.getDevice());
 
-    vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier()
-        .setOldLayout(oldLayout)
-        .setNewLayout(newLayout)
-        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
-        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
-        .setImage(image)
-        .setSubresourceRange(vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 });
-
-    vk::PipelineStageFlags sourceStage;
-    vk::PipelineStageFlags destinationStage;
-
-    if ((oldLayout == vk::ImageLayout::eUndefined) && (newLayout == vk::ImageLayout::eTransferDstOptimal))
-    {
-        barrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
-        barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-
-        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eTransfer;
-    }
-    else if ((oldLayout == vk::ImageLayout::eTransferDstOptimal) && (newLayout == vk::ImageLayout::eShaderReadOnlyOptimal))
+    vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eColor;
+    if (newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
     {
-        barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-        barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-
-        sourceStage = vk::PipelineStageFlagBits::eTransfer;
-        destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-    }
-    else
-    {
-        throw std::invalid_argument("Unsupported layout transition!");
+        aspectMask = vk::ImageAspectFlagBits::eDepth;
+        if (devices.hasStencilComponent(format))
+        {
+            aspectMask |= vk::ImageAspectFlagBits::eStencil;
+        }
     }
 
-    commandBuffer.pipelineBarrier
-    (
-        sourceStage, destinationStage,
-        vk::DependencyFlagBits::eByRegion, 0, nullptr,
-        0, nullptr, 1, &barrier
-    );
+    RenderGraph::recordTransition(commandBuffer, image, static_cast<VkImageAspectFlags>(aspectMask),
+        RenderGraph::getLayoutUsage(oldLayout), RenderGraph::getLayoutUsage(newLayout));
 
     this->endSingleTimeCommands(devices, commandBuffer);
 }
@@ -244,6 +291,7 @@ void CommandBuffers::createTextureSampler(Devices& devices)
 
 void CommandBuffers::loadModel()
 {
+    PROFILE_FUNCTION();
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -289,6 +337,34 @@ void CommandBuffers::loadModel()
     }
 }
 
+void CommandBuffers::computeModelBounds()
+{
+    if (model.vertices.empty())
+    {
+        return;
+    }
+
+    glm::vec3 minPosition = model.vertices[0].pos;
+    glm::vec3 maxPosition = model.vertices[0].pos;
+    for (const Vertex& vertex : model.vertices)
+    {
+        minPosition = glm::min(minPosition, vertex.pos);
+        maxPosition = glm::max(maxPosition, vertex.pos);
+    }
+
+    model.bounds.center = (minPosition + maxPosition) * 0.5f;
+    model.bounds.extents = (maxPosition - minPosition) * 0.5f;
+
+    float maxDistance2 = 0.0f;
+    for (const Vertex& vertex : model.vertices)
+    {
+        glm::vec3 offset = vertex.pos - model.bounds.center;
+        maxDistance2 = std::max(maxDistance2, glm::dot(offset, offset));
+    }
+
+    model.bounds.radius = std::sqrt(maxDistance2);
+}
+
 void CommandBuffers::createVertexBuffer(Devices& devices)
 {
     vk::Device* logicalDevice = devices.getDevice();
@@ -308,8 +384,7 @@ void CommandBuffers::createVertexBuffer(Devices& devices)
 
     this->copyBuffer(devices, stagingBuffer, vertexBuffer, bufferSize);
 
-    logicalDevice->destroyBuffer(stagingBuffer);
-    logicalDevice->freeMemory(stagingBufferMemory);
+    this->releaseStagingBuffer(logicalDevice, stagingBuffer, stagingBufferMemory);
 }
 
 void CommandBuffers::createIndexBuffer(Devices& devices)
@@ -330,8 +405,7 @@ void CommandBuffers::createIndexBuffer(Devices& devices)
 
     this->copyBuffer(devices, stagingBuffer, indexBuffer, bufferSize);
 
-    logicalDevice->destroyBuffer(stagingBuffer);
-    logicalDevice->freeMemory(stagingBufferMemory);
+    this->releaseStagingBuffer(logicalDevice, stagingBuffer, stagingBufferMemory);
 }
 
 void CommandBuffers::createUniformBuffers(Devices& devices, int maxFramesInFlight)
@@ -351,25 +425,105 @@ void CommandBuffers::createUniformBuffers(Devices& devices, int maxFramesInFligh
     }
 }
 
+void CommandBuffers::registerBindlessResources(Devices& devices, BindlessDescriptors* bindlessDescriptors)
+{
+    this->bindlessDescriptors = bindlessDescriptors;
+
+    // The scene has a single material; more materials only mean more entries here, not more descriptor writes.
+    std::array<uint32_t, 1> textureIndices = { bindlessDescriptors->addTexture(textureImageView, textureSampler) };
+    vk::DeviceSize bufferSize = sizeof(textureIndices);
+
+    this->createBuffer(devices, bufferSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible |
+        vk::MemoryPropertyFlagBits::eHostCoherent, materialBuffer, materialBufferMemory);
+
+    vk::Device* logicalDevice = devices.getDevice();
+    void* data = logicalDevice->mapMemory(materialBufferMemory, 0, bufferSize);
+    memcpy(data, textureIndices.data(), static_cast<size_t>(bufferSize));
+    logicalDevice->unmapMemory(materialBufferMemory);
+
+    this->drawConstants.materialBuffer = bindlessDescriptors->addBuffer(materialBuffer, 0, bufferSize);
+    this->drawConstants.materialIndex = 0;
+}
+
 void CommandBuffers::createCommandBuffers(vk::Device* logicalDevice, int maxFramesInFlight)
 {
+    vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(this->queueFamilyIndex);
 
-    vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
-        .setCommandPool(*commandPool.get())
-        .setLevel(vk::CommandBufferLevel::ePrimary)
-        .setCommandBufferCount(static_cast<uint32_t>(maxFramesInFlight));
+    frameCommandPools.resize(maxFramesInFlight);
+    frameCommandBuffers.resize(maxFramesInFlight);
+    this->usedFrameCommandBuffers.assign(maxFramesInFlight, 0);
 
-    commandBuffers.reserve(maxFramesInFlight);
-    std::vector<vk::CommandBuffer> commandBufferValues = logicalDevice->allocateCommandBuffers(allocInfo);
-    for (vk::CommandBuffer& item : commandBufferValues)
+    for (size_t i = 0; i < maxFramesInFlight; i++)
     {
-        this->commandBuffers.push_back(std::make_shared<vk::CommandBuffer>(item));
+        frameCommandPools[i] = logicalDevice->createCommandPool(poolInfo);
+
+        vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
+            .setCommandPool(frameCommandPools[i])
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandBufferCount(1);
+
+        std::vector<vk::CommandBuffer> commandBufferValues = logicalDevice->allocateCommandBuffers(allocInfo);
+        if (commandBufferValues.empty())
+        {
+            throw std::runtime_error("Couldn't allocate command buffer!");
+        }
+
+        frameCommandBuffers[i].assign(commandBufferValues.begin(), commandBufferValues.end());
     }
+}
+
+void CommandBuffers::resizeFrames(Devices& devices, int maxFramesInFlight)
+{
+    // Must only be called while the device is idle.
+    vk::Device* logicalDevice = devices.getDevice();
+    bool gpuCullingEnabled = this->gpuCulling.isEnabled();
+
+    this->gpuCulling.release(logicalDevice);
+    this->gpuTimer.release(logicalDevice);
+    this->secondaryBuffers.release();
+    this->releaseFrameCommandPools(logicalDevice);
+    this->releaseUniformBuffers(logicalDevice, uniformBuffers.size());
+
+    this->createUniformBuffers(devices, maxFramesInFlight);
+    this->createCommandBuffers(logicalDevice, maxFramesInFlight);
+    this->secondaryBuffers.init(logicalDevice, this->queueFamilyIndex, maxFramesInFlight, this->threadPool->getWorkerCount() + 1);
+    this->gpuTimer.init(devices, maxFramesInFlight);
 
-    if (commandBuffers.empty())
+    if (gpuCullingEnabled)
     {
-        throw std::runtime_error("Couldn't allocate command buffer!");
+        this->gpuCulling.init(devices, *this, maxFramesInFlight, 1);
+        this->gpuCulling.setInstance(0, model.bounds, static_cast<uint32_t>(model.indices.size()), 0, 0);
     }
+
+    this->currentFrame = 0;
+}
+
+void CommandBuffers::beginFrame()
+{
+    // Must only be called once the current frame's fence has signaled.
+    this->logicalDevice->resetCommandPool(frameCommandPools[this->currentFrame]);
+    this->secondaryBuffers.resetFrame(this->currentFrame);
+    this->usedFrameCommandBuffers[this->currentFrame] = 0;
+}
+
+const vk::CommandBuffer& CommandBuffers::allocateFrameCommandBuffer()
+{
+    std::deque<vk::CommandBuffer>& available = frameCommandBuffers[this->currentFrame];
+    uint32_t& used = this->usedFrameCommandBuffers[this->currentFrame];
+
+    if (used == available.size())
+    {
+        vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
+            .setCommandPool(frameCommandPools[this->currentFrame])
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandBufferCount(1);
+
+        available.push_back(this->logicalDevice->allocateCommandBuffers(allocInfo).front());
+    }
+
+    return available[used++];
 }
 
 uint32_t CommandBuffers::getCurrentFrameIndex()
@@ -379,16 +533,17 @@ uint32_t CommandBuffers::getCurrentFrameIndex()
 
 vk::ImageView& CommandBuffers::getDepthImageView()
 {
-    return depthImageView;
+    return this->transientImages.getImageView(this->depthTarget);
 }
 
 const vk::CommandBuffer* CommandBuffers::getCurrentCommandBuffer()
 {
-    return this->commandBuffers[this->currentFrame].get();
+    return this->currentCommandBuffer;
 }
 
 void CommandBuffers::copyBuffer(Devices& devices, vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize& size)
 {
+    this->uploadedBytes += size;
     vk::CommandBuffer commandBuffer = this->beginSingleTimeCommands(devices.getDevice());
 
     vk::BufferCopy copyRegion = vk::BufferCopy()
@@ -420,24 +575,159 @@ void CommandBuffers::createBuffer(Devices& devices, vk::DeviceSize size, vk::Buf
     logicalDevice->bindBufferMemory(buffer, bufferMemory, 0);
 }
 
-void CommandBuffers::recordCommandBuffer(const vk::Extent2D& swapchainExtent, vk::RenderPassBeginInfo& renderPassInfo,
-    const vk::Pipeline& graphicsPipeline, const vk::PipelineLayout& pipelineLayout, const vk::DescriptorSet* descriptorSets)
+void CommandBuffers::recordCommandBuffer(const vk::Extent2D& swapchainExtent, RenderPass& renderPass, Swapchain& swapchain, uint32_t imageIndex,
+    GraphicsPipelines& graphicsPipelines, uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout, const DescriptorSets& descriptorSets)
 {
-    vk::CommandBuffer* commandBuffer = this->commandBuffers[currentFrame].get();
-    commandBuffer->reset();
+    PROFILE_FUNCTION();
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    const vk::CommandBuffer* commandBuffer = &this->allocateFrameCommandBuffer();
+    this->currentCommandBuffer = commandBuffer;
 
-    vk::CommandBufferBeginInfo beginInfo;
+    vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 
     commandBuffer->begin(beginInfo);
+    this->gpuTimer.writeBegin(*commandBuffer, this->currentFrame, this->frameNumber);
+
+    this->buildDrawList();
+
+    // Both attachments are cleared on load, so their previous contents never need to be preserved.
+    this->renderGraph.reset();
+    RenderGraphResource colorTarget = this->renderGraph.importImage("SwapchainImage", swapchain.getImage(imageIndex),
+        static_cast<uint32_t>(vk::ImageAspectFlagBits::eColor),
+        ResourceUsage::ColorAttachmentWrite, true, ResourceUsage::Present);
+    RenderGraphResource depthTarget = this->renderGraph.importImage("Depth", this->transientImages.getImage(this->depthTarget),
+        this->transientImages.getAspectMask(this->depthTarget),
+        ResourceUsage::DepthAttachmentWrite, true, ResourceUsage::None);
+
+    std::vector<RenderGraphAccess> mainAccesses =
+    {
+        { colorTarget, ResourceUsage::ColorAttachmentWrite },
+        { depthTarget, ResourceUsage::DepthAttachmentWrite }
+    };
+
+    if (this->gpuCulling.isEnabled())
+    {
+        std::vector<RenderGraphAccess> cullingAccesses;
+        RenderGraphResource drawCommands = this->renderGraph.importBuffer("DrawCommands",
+            this->gpuCulling.getDrawCommandBuffer(this->currentFrame), ResourceUsage::None);
+        cullingAccesses.push_back({ drawCommands, ResourceUsage::ComputeShaderWrite });
+        mainAccesses.push_back({ drawCommands, ResourceUsage::IndirectRead });
+
+        if (this->gpuCulling.compact)
+        {
+            RenderGraphResource drawCount = this->renderGraph.importBuffer("DrawCount",
+                this->gpuCulling.getDrawCountBuffer(this->currentFrame), ResourceUsage::None);
+            cullingAccesses.push_back({ drawCount, ResourceUsage::ComputeShaderWrite });
+            mainAccesses.push_back({ drawCount, ResourceUsage::IndirectRead });
+        }
+
+        this->renderGraph.addPass(CULLING_PASS, cullingAccesses, [this](const vk::CommandBuffer& passCommandBuffer)
+        {
+            this->gpuCulling.recordCulling(passCommandBuffer, this->currentFrame, this->viewProjection);
+        });
+    }
 
-    std::array<vk::ClearValue, 2> clearValues;
-    clearValues[0].color = vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 1.0f };
-    clearValues[1].depthStencil = vk::ClearDepthStencilValue{ 1.0f, 0 };
+    this->renderGraph.addPass(MAIN_PASS, mainAccesses, [&](const vk::CommandBuffer& passCommandBuffer)
+    {
+        this->recordMainPass(passCommandBuffer, swapchainExtent, renderPass, swapchain, imageIndex, graphicsPipelines, pipelineIndex,
+            pipelineLayout, descriptorSets);
+    });
+
+    this->renderGraph.compile();
+    this->renderGraph.execute(*commandBuffer);
+
+    this->gpuTimer.writeEnd(*commandBuffer, this->currentFrame);
+    commandBuffer->end();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    this->recordingStats.recordTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void CommandBuffers::recordMainPass(const vk::CommandBuffer& commandBuffer, const vk::Extent2D& swapchainExtent, RenderPass& renderPass, Swapchain& swapchain,
+    uint32_t imageIndex, GraphicsPipelines& graphicsPipelines, uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout,
+    const DescriptorSets& descriptorSets)
+{
+    const vk::ImageView& depthImageView = this->transientImages.getImageView(this->depthTarget);
+    uint32_t drawCount = static_cast<uint32_t>(this->drawList.size());
+    uint32_t batchCount = std::min(this->secondaryBuffers.getSlotCount(), drawCount / MIN_DRAWS_PER_BATCH);
+
+    if (batchCount > 1)
+    {
+        renderPass.begin(commandBuffer, swapchain, imageIndex, depthImageView, swapchainExtent, true);
+
+        vk::CommandBufferInheritanceInfo inheritanceInfo;
+        vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo;
+        renderPass.fillInheritanceInfo(swapchain, imageIndex, inheritanceInfo, inheritanceRenderingInfo);
+
+        uint32_t batchSize = (drawCount + batchCount - 1) / batchCount;
+        this->threadPool->parallelForBatches(batchCount, [&](uint32_t batchIndex)
+        {
+            uint32_t begin = std::min(batchIndex * batchSize, drawCount);
+            uint32_t end = std::min(begin + batchSize, drawCount);
+
+            const vk::CommandBuffer& secondary = this->secondaryBuffers.begin(this->currentFrame, batchIndex, inheritanceInfo);
+            this->recordDraws(secondary, swapchainExtent, graphicsPipelines, pipelineIndex, pipelineLayout, descriptorSets, begin, end);
+            secondary.end();
+        });
+
+        commandBuffer.executeCommands(batchCount, this->secondaryBuffers.getCommandBuffers(this->currentFrame));
+    }
+    else
+    {
+        batchCount = 1;
+        renderPass.begin(commandBuffer, swapchain, imageIndex, depthImageView, swapchainExtent, false);
+        this->recordDraws(commandBuffer, swapchainExtent, graphicsPipelines, pipelineIndex, pipelineLayout, descriptorSets, 0, drawCount);
+
+        if (this->gpuCulling.isEnabled())
+        {
+            this->gpuCulling.recordDraws(commandBuffer, this->currentFrame);
+        }
+    }
+
+    renderPass.end(commandBuffer);
+
+    this->recordingStats.drawCount = drawCount;
+    this->recordingStats.batchCount = batchCount;
+    this->recordingStats.triangleCount = 0;
+    for (const DrawItem& draw : this->drawList)
+    {
+        this->recordingStats.triangleCount += draw.indexCount / 3;
+    }
 
-    renderPassInfo.setClearValues(clearValues);
+    // With GPU culling the draw list is empty; what was drawn is only known from the culling shader's counters.
+    if (this->gpuCulling.isEnabled())
+    {
+        this->recordingStats.drawCount = this->gpuCulling.visibleDrawCount;
+        this->recordingStats.triangleCount = this->gpuCulling.visibleTriangleCount;
+    }
+}
 
-    commandBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-    commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+void CommandBuffers::buildDrawList()
+{
+    this->drawList.clear();
+
+    // With GPU culling the draw list lives in the indirect buffer instead.
+    if (this->gpuCulling.isEnabled())
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < this->frustumCulling.objectCount; i++)
+    {
+        if (this->frustumCulling.isVisible(i))
+        {
+            this->drawList.push_back(DrawItem{ static_cast<uint32_t>(model.indices.size()), 0, 0, i });
+        }
+    }
+}
+
+void CommandBuffers::recordDraws(const vk::CommandBuffer& commandBuffer, const vk::Extent2D& swapchainExtent, GraphicsPipelines& graphicsPipelines,
+    uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout, const DescriptorSets& descriptorSets, uint32_t begin, uint32_t end)
+{
+    PROFILE_FUNCTION();
+    // Secondary command buffers inherit no state from the primary, so each batch binds everything.
+    graphicsPipelines.bind(commandBuffer, pipelineIndex, this->rasterState);
 
     vk::Viewport viewport = vk::Viewport()
         .setX(0.0f).setY(0.0f)
@@ -446,36 +736,86 @@ void CommandBuffers::recordCommandBuffer(const vk::Extent2D& swapchainExtent, vk
         .setMinDepth(0.0f)
         .setMaxDepth(1.0f);
 
-    commandBuffer->setViewport(0, 1, &viewport);
+    commandBuffer.setViewport(0, 1, &viewport);
 
     vk::Rect2D scissor{ {0, 0}, swapchainExtent };
-    commandBuffer->setScissor(0, 1, &scissor);
+    commandBuffer.setScissor(0, 1, &scissor);
 
     vk::Buffer vertexBuffers[] = { vertexBuffer };
     vk::DeviceSize offsets[] = { 0 };
-    commandBuffer->bindVertexBuffers(0, vertexBuffers, offsets);
-    commandBuffer->bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint32);
+    commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
+    commandBuffer.bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint32);
 
-    commandBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1, descriptorSets, 0, nullptr);
-    commandBuffer->drawIndexed(static_cast<uint32_t>(model.indices.size()), 1, 0, 0, 0);
-    commandBuffer->endRenderPass();
-    commandBuffer->end();
+    descriptorSets.bind(commandBuffer, pipelineLayout, this->currentFrame);
+
+    if ((this->bindlessDescriptors != nullptr) && this->bindlessDescriptors->isEnabled())
+    {
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, BINDLESS_SET, 1,
+            &this->bindlessDescriptors->getDescriptorSet(), 0, nullptr);
+        commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(BindlessDrawConstants), &this->drawConstants);
+    }
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const DrawItem& draw = this->drawList[i];
+        commandBuffer.drawIndexed(draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, draw.instanceIndex);
+    }
 }
 
-void CommandBuffers::updateUniformBuffer(const vk::Extent2D& swapchainExtent)
+void CommandBuffers::updateUniformBuffer(const vk::Extent2D& swapchainExtent, const glm::mat4& view)
 {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-
+    // Animation time only advances while unpaused, so pausing freezes the model in place.
     auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    if (!this->animationPaused && (this->lastAnimationUpdate != std::chrono::high_resolution_clock::time_point()))
+    {
+        this->animationTime += std::chrono::duration<float, std::chrono::seconds::period>(currentTime - this->lastAnimationUpdate).count();
+    }
+
+    this->lastAnimationUpdate = currentTime;
 
     UniformBufferObject ubo;
-    ubo.model = glm::rotate(glm::mat4(1.0f), 0.25f * time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    ubo.model = glm::rotate(glm::mat4(1.0f), 0.25f * this->animationTime * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    ubo.view = view;
     ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f);
     ubo.proj[1][1] *= -1.0f;
 
+    this->viewProjection = ubo.proj * ubo.view;
+    this->projection = ubo.proj;
+    this->modelTransform = ubo.model;
+    ubo.modelViewProj = this->viewProjection * ubo.model;
+
     memcpy(uniformBuffersMapped[this->currentFrame], &ubo, sizeof(ubo));
+
+    if (this->gpuCulling.isEnabled())
+    {
+        this->gpuCulling.setInstanceTransform(this->currentFrame, 0, ubo.model);
+    }
+    else
+    {
+        this->frustumCulling.setObjectBounds(0, model.bounds, ubo.model);
+        this->frustumCulling.cull(this->viewProjection, this->threadPool);
+    }
+}
+
+void CommandBuffers::setAnimationPaused(bool paused)
+{
+    this->animationPaused = paused;
+}
+
+bool CommandBuffers::isAnimating() const
+{
+    return !this->animationPaused;
+}
+
+void CommandBuffers::latchView(const glm::mat4& view)
+{
+    // The buffer is host coherent and the frame hasn't been submitted yet, so overwriting the view
+    // after recording is safe. Culling keeps using the view it was given in updateUniformBuffer.
+    // Both view and the precomputed matrix are written, so either shader variant sees the late view.
+    glm::mat4 modelViewProj = this->projection * view * this->modelTransform;
+    char* mapped = static_cast<char*>(uniformBuffersMapped[this->currentFrame]);
+    memcpy(mapped + offsetof(UniformBufferObject, view), &view, sizeof(view));
+    memcpy(mapped + offsetof(UniformBufferObject, modelViewProj), &modelViewProj, sizeof(modelViewProj));
 }
 
 vk::CommandBuffer CommandBuffers::beginSingleTimeCommands(vk::Device* logicalDevice)
@@ -496,18 +836,59 @@ vk::CommandBuffer CommandBuffers::beginSingleTimeCommands(vk::Device* logicalDev
 
 void CommandBuffers::endSingleTimeCommands(Devices& devices, vk::CommandBuffer& commandBuffer)
 {
+    PROFILE_FUNCTION();
+    PROFILE_EVENT("Upload");
     commandBuffer.end();
 
     vk::SubmitInfo submitInfo = vk::SubmitInfo()
         .setCommandBufferCount(1)
         .setCommandBuffers(commandBuffer);
-    std::vector<vk::SubmitInfo> submitInfos = { submitInfo };
 
     const vk::Queue* graphicsQueue = devices.getGraphicsQueue();
-    graphicsQueue->submit(submitInfos);
-    graphicsQueue->waitIdle();
+    vk::Device* logicalDevice = devices.getDevice();
+
+    if (!this->syncObjects->isTimelineEnabled())
+    {
+        std::vector<vk::SubmitInfo> submitInfos = { submitInfo };
+        graphicsQueue->submit(submitInfos);
+        graphicsQueue->waitIdle();
+
+        logicalDevice->freeCommandBuffers(*this->commandPool, 1, &commandBuffer);
+        return;
+    }
+
+    // Uploads don't block: later uploads are ordered by the queue and the first frame
+    // waits on the last upload value, so the CPU only has to free things once they retire.
+    uint64_t signalValue = this->syncObjects->signalUpload();
+    vk::TimelineSemaphoreSubmitInfo timelineInfo = vk::TimelineSemaphoreSubmitInfo()
+        .setSignalSemaphoreValues(signalValue);
+
+    submitInfo
+        .setSignalSemaphores(this->syncObjects->getTimelineSemaphore())
+        .setPNext(&timelineInfo);
 
-    devices.getDevice()->freeCommandBuffers(*this->commandPool, 1, &commandBuffer);
+    if (graphicsQueue->submit(1, &submitInfo, nullptr) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to submit upload command buffer!");
+    }
+
+    vk::CommandPool pool = *this->commandPool;
+    this->syncObjects->deferDestruction([logicalDevice, pool, commandBuffer]()
+    {
+        logicalDevice->freeCommandBuffers(pool, 1, &commandBuffer);
+    });
+}
+
+void CommandBuffers::releaseStagingBuffer(vk::Device* logicalDevice, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory)
+{
+    vk::Buffer stagingBuffer = buffer;
+    vk::DeviceMemory stagingBufferMemory = bufferMemory;
+
+    this->syncObjects->deferDestruction([logicalDevice, stagingBuffer, stagingBufferMemory]()
+    {
+        logicalDevice->destroyBuffer(stagingBuffer);
+        logicalDevice->freeMemory(stagingBufferMemory);
+    });
 }
 
 void CommandBuffers::increaseFrame(int maxFramesInFlight)
@@ -515,6 +896,16 @@ void CommandBuffers::increaseFrame(int maxFramesInFlight)
     this->currentFrame = (this->currentFrame + 1) % maxFramesInFlight;
 }
 
+const CullingStats& CommandBuffers::getCullingStats() const
+{
+    return this->frustumCulling.getStats();
+}
+
+const RecordingStats& CommandBuffers::getRecordingStats() const
+{
+    return this->recordingStats;
+}
+
 void CommandBuffers::createDescriptorsBufferInfo(size_t index, vk::DescriptorBufferInfo& bufferInfo, vk::DescriptorImageInfo& imageInfo)
 {
     bufferInfo = vk::DescriptorBufferInfo(uniformBuffers[index], 0, sizeof(UniformBufferObject));
@@ -544,20 +935,40 @@ void CommandBuffers::release(vk::Device* logicalDevice)
     logicalDevice->destroyImage(textureImage);
     logicalDevice->freeMemory(textureImageMemory);
 
+    if (materialBuffer)
+    {
+        logicalDevice->destroyBuffer(materialBuffer);
+        logicalDevice->freeMemory(materialBufferMemory);
+        materialBuffer = nullptr;
+    }
+
     logicalDevice->destroyBuffer(indexBuffer);
     logicalDevice->freeMemory(indexBufferMemory);
     logicalDevice->destroyBuffer(vertexBuffer);
     logicalDevice->freeMemory(vertexBufferMemory);
 
+    this->gpuCulling.release(logicalDevice);
+    this->gpuTimer.release(logicalDevice);
+    this->secondaryBuffers.release();
+    this->releaseFrameCommandPools(logicalDevice);
     this->releaseDepthImages(logicalDevice);
 
     logicalDevice->destroyCommandPool(*this->commandPool.get());
 
 }
 
+void CommandBuffers::releaseFrameCommandPools(vk::Device* logicalDevice)
+{
+    for (vk::CommandPool& pool : frameCommandPools)
+    {
+        logicalDevice->destroyCommandPool(pool);
+    }
+
+    frameCommandPools.clear();
+    frameCommandBuffers.clear();
+}
+
 void CommandBuffers::releaseDepthImages(vk::Device* logicalDevice)
 {
-    logicalDevice->destroyImageView(depthImageView);
-    logicalDevice->destroyImage(depthImage);
-    logicalDevice->freeMemory(depthImageMemory);
+    this->transientImages.release(logicalDevice);
 }
@@ -1,26 +1,86 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <memory>
+#include <string>
 #include "Vertex.h"
 #include "vk_forward_declarations.h"
 #include "Model.h"
+#include "FrustumCulling.h"
+#include "GpuCulling.h"
+#include "SecondaryCommandBuffers.h"
+#include "RenderGraph.h"
+#include "TransientImages.h"
+#include "GraphicsPipelines.h"
+#include "BindlessDescriptors.h"
+#include "GpuTimer.h"
 
 class Devices;
 class Swapchain;
+class RenderPass;
+class SyncObjects;
+class DescriptorSets;
+class ThreadPool;
+
+struct DrawItem
+{
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t instanceIndex;
+};
+
+struct RecordingStats
+{
+	uint32_t drawCount = 0;
+	uint32_t batchCount = 0;
+	uint64_t triangleCount = 0;
+	double recordTimeMs = 0.0;
+};
 
 class CommandBuffers
 {
 private:
 	std::shared_ptr<vk::CommandPool> commandPool;
-	std::vector<std::shared_ptr<vk::CommandBuffer>> commandBuffers;
+	vk::Device* logicalDevice = nullptr;
+	uint32_t queueFamilyIndex = 0;
+	std::vector<uint32_t> usedFrameCommandBuffers;
+	const vk::CommandBuffer* currentCommandBuffer = nullptr;
+	SecondaryCommandBuffers secondaryBuffers;
 	uint32_t currentFrame = 0;
 	Model model;
+	FrustumCulling frustumCulling;
+	GpuCulling gpuCulling;
+	GpuTimer gpuTimer;
+	// Number the flight recorder gave the frame being recorded, so its GPU time can be matched up later.
+	uint64_t frameNumber = 0;
+	glm::mat4 viewProjection{ 1.0f };
+	// Kept from updateUniformBuffer so latchView can rebuild the combined matrix for a new view.
+	glm::mat4 projection{ 1.0f };
+	glm::mat4 modelTransform{ 1.0f };
+	std::vector<DrawItem> drawList;
+	RecordingStats recordingStats;
+	// Bytes copied from staging buffers to device local memory since startup.
+	uint64_t uploadedBytes = 0;
+	ThreadPool* threadPool = nullptr;
+	SyncObjects* syncObjects = nullptr;
+	RenderGraph renderGraph;
+	TransientImages transientImages;
+	uint32_t depthTarget = 0;
+	RasterState rasterState;
+	BindlessDescriptors* bindlessDescriptors = nullptr;
+	BindlessDrawConstants drawConstants;
+	float animationTime = 0.0f;
+	bool animationPaused = false;
+	std::chrono::high_resolution_clock::time_point lastAnimationUpdate;
 
 private:
-	void init(const vk::SurfaceKHR& surface, Devices& devices, Swapchain& swapchain, int maxFramesInFlight);
+	void init(const vk::SurfaceKHR& surface, Devices& devices, Swapchain& swapchain, SyncObjects* syncObjects,
+		int maxFramesInFlight, ThreadPool* threadPool);
 	void createCommandPool(vk::Device* logicalDevice, uint32_t queueFamilyIndex);
 	void createDepthResources(Devices& devices, Swapchain& swapchain);
+	uint32_t getPassIndex(const std::string& name) const;
 	void recreateDepthResources(Devices& devices, Swapchain& swapchain);
 	void createTextureImage(Devices& devices);
 	void createImage(Devices& devices, uint32_t widith, uint32_t height, vk::Format format, vk::ImageTiling tiling,
@@ -31,26 +91,45 @@ private:
 	void createTextureImageView(Devices& devices);
 	void createTextureSampler(Devices& devices);
 	void loadModel();
+	void computeModelBounds();
 	void createVertexBuffer(Devices& devices);
 	void createIndexBuffer(Devices& devices);
 	void createUniformBuffers(Devices& devices, int maxFramesInFlight);
+	void registerBindlessResources(Devices& devices, BindlessDescriptors* bindlessDescriptors);
 	void createCommandBuffers(vk::Device* logicalDevice, int maxFramesInFlight);
+	void resizeFrames(Devices& devices, int maxFramesInFlight);
+	void beginFrame();
+	const vk::CommandBuffer& allocateFrameCommandBuffer();
 	uint32_t getCurrentFrameIndex();
 	vk::ImageView& getDepthImageView();
 	const vk::CommandBuffer* getCurrentCommandBuffer();
 	void copyBuffer(Devices& devices, vk::Buffer& srcBuffer, vk::Buffer& dstBuffer, vk::DeviceSize& size);
 	void createBuffer(Devices& devices, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
 		vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
-	void recordCommandBuffer(const vk::Extent2D& swapchainExtent, vk::RenderPassBeginInfo& renderPassInfo,
-		const vk::Pipeline& graphicsPipeline, const vk::PipelineLayout& pipelineLayout, const vk::DescriptorSet* descriptorSets);
-	void updateUniformBuffer(const vk::Extent2D& swapchainExtent);
+	void recordCommandBuffer(const vk::Extent2D& swapchainExtent, RenderPass& renderPass, Swapchain& swapchain, uint32_t imageIndex,
+		GraphicsPipelines& graphicsPipelines, uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout, const DescriptorSets& descriptorSets);
+	void recordMainPass(const vk::CommandBuffer& commandBuffer, const vk::Extent2D& swapchainExtent, RenderPass& renderPass, Swapchain& swapchain,
+		uint32_t imageIndex, GraphicsPipelines& graphicsPipelines, uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout,
+		const DescriptorSets& descriptorSets);
+	void buildDrawList();
+	void recordDraws(const vk::CommandBuffer& commandBuffer, const vk::Extent2D& swapchainExtent, GraphicsPipelines& graphicsPipelines,
+		uint32_t pipelineIndex, const vk::PipelineLayout& pipelineLayout, const DescriptorSets& descriptorSets, uint32_t begin, uint32_t end);
+	void updateUniformBuffer(const vk::Extent2D& swapchainExtent, const glm::mat4& view);
+	void latchView(const glm::mat4& view);
+	void setAnimationPaused(bool paused);
+	bool isAnimating() const;
 	vk::CommandBuffer beginSingleTimeCommands(vk::Device* logicalDevice);
 	void endSingleTimeCommands(Devices& devices, vk::CommandBuffer& commandBuffer);
+	void releaseStagingBuffer(vk::Device* logicalDevice, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
 	void increaseFrame(int maxFramesInFlight);
+	const CullingStats& getCullingStats() const;
+	const RecordingStats& getRecordingStats() const;
 	void createDescriptorsBufferInfo(size_t index, vk::DescriptorBufferInfo& bufferInfo, vk::DescriptorImageInfo& imageInfo);
 	void releaseUniformBuffers(vk::Device* logicalDevice, size_t maxFramesInFlight);
 	void release(vk::Device* logicalDevice);
+	void releaseFrameCommandPools(vk::Device* logicalDevice);
 	void releaseDepthImages(vk::Device* logicalDevice);
 
 friend class VulkanAPI;
+friend class GpuCulling;
 };
@@ -0,0 +1,293 @@
+#include "DescriptorAllocator.h"
+#include "LayoutCache.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+const uint32_t INITIAL_SETS_PER_POOL = 16;
+const uint32_t MAX_SETS_PER_POOL = 4096;
+
+// Sets are allocated from the current pool; full pools stay alive for the sets already in them.
+vk::DescriptorPool currentPool;
+std::vector<vk::DescriptorPool> fullPools;
+std::unordered_map<DescriptorSetKey, vk::DescriptorSet, DescriptorSetKeyHash> cachedSets;
+
+const size_t DESCRIPTOR_FNV_OFFSET_BASIS = static_cast<size_t>(14695981039346656037ull);
+const size_t DESCRIPTOR_FNV_PRIME = static_cast<size_t>(1099511628211ull);
+
+template <typename T>
+uint64_t toHandleKey(const T& handle)
+{
+    uint64_t result = 0;
+    memcpy(&result, &handle, std::min(sizeof(result), sizeof(handle)));
+    return result;
+}
+
+template <typename T>
+T fromHandleKey(uint64_t key)
+{
+    T result;
+    memcpy(&result, &key, std::min(sizeof(key), sizeof(result)));
+    return result;
+}
+
+void hashDescriptorValue(size_t& hash, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= DESCRIPTOR_FNV_PRIME;
+    }
+}
+
+bool DescriptorWrite::operator==(const DescriptorWrite& other) const
+{
+    return (this->binding == other.binding) && (this->descriptorType == other.descriptorType) && (this->buffer == other.buffer) &&
+        (this->offset == other.offset) && (this->range == other.range) && (this->imageView == other.imageView) &&
+        (this->sampler == other.sampler) && (this->imageLayout == other.imageLayout);
+}
+
+DescriptorWrite DescriptorWrite::fromBuffer(uint32_t binding, uint32_t descriptorType, const vk::DescriptorBufferInfo& bufferInfo)
+{
+    DescriptorWrite result;
+    result.binding = binding;
+    result.descriptorType = descriptorType;
+    result.buffer = toHandleKey(bufferInfo.buffer);
+    result.offset = bufferInfo.offset;
+    result.range = bufferInfo.range;
+
+    return result;
+}
+
+DescriptorWrite DescriptorWrite::fromImage(uint32_t binding, uint32_t descriptorType, const vk::DescriptorImageInfo& imageInfo)
+{
+    DescriptorWrite result;
+    result.binding = binding;
+    result.descriptorType = descriptorType;
+    result.imageView = toHandleKey(imageInfo.imageView);
+    result.sampler = toHandleKey(imageInfo.sampler);
+    result.imageLayout = static_cast<uint32_t>(imageInfo.imageLayout);
+
+    return result;
+}
+
+bool DescriptorSetKey::operator==(const DescriptorSetKey& other) const
+{
+    return (this->layout == other.layout) && (this->writes == other.writes);
+}
+
+size_t DescriptorSetKey::hash() const
+{
+    size_t result = DESCRIPTOR_FNV_OFFSET_BASIS;
+    hashDescriptorValue(result, this->layout);
+    for (const DescriptorWrite& write : this->writes)
+    {
+        hashDescriptorValue(result, (static_cast<uint64_t>(write.binding) << 32) | write.descriptorType);
+        hashDescriptorValue(result, write.buffer);
+        hashDescriptorValue(result, write.offset);
+        hashDescriptorValue(result, write.range);
+        hashDescriptorValue(result, write.imageView);
+        hashDescriptorValue(result, write.sampler);
+        hashDescriptorValue(result, write.imageLayout);
+    }
+
+    return result;
+}
+
+void DescriptorAllocator::init(vk::Device* logicalDevice, const std::vector<PoolSizeRatio>& ratios)
+{
+    this->logicalDevice = logicalDevice;
+    this->ratios = ratios;
+    this->setsPerPool = INITIAL_SETS_PER_POOL;
+}
+
+vk::DescriptorPool DescriptorAllocator::createPool()
+{
+    std::vector<vk::DescriptorPoolSize> poolSizes;
+    for (const PoolSizeRatio& ratio : this->ratios)
+    {
+        uint32_t count = std::max(1u, static_cast<uint32_t>(std::ceil(ratio.ratio * this->setsPerPool)));
+        poolSizes.push_back(vk::DescriptorPoolSize{ static_cast<vk::DescriptorType>(ratio.descriptorType), count });
+    }
+
+    vk::DescriptorPoolCreateInfo poolInfo = vk::DescriptorPoolCreateInfo()
+        .setMaxSets(this->setsPerPool)
+        .setPoolSizes(poolSizes);
+
+    vk::DescriptorPool pool = this->logicalDevice->createDescriptorPool(poolInfo);
+    this->stats.poolCount++;
+
+    // Each new pool is larger, so a scene that keeps adding materials needs few pools.
+    this->setsPerPool = std::min(this->setsPerPool * 2, MAX_SETS_PER_POOL);
+
+    return pool;
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(const vk::DescriptorSetLayout& layout)
+{
+    if (!currentPool)
+    {
+        currentPool = this->createPool();
+    }
+
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(currentPool)
+        .setSetLayouts(layout);
+
+    vk::DescriptorSet result;
+    vk::Result allocResult = this->logicalDevice->allocateDescriptorSets(&allocInfo, &result);
+
+    if ((allocResult == vk::Result::eErrorOutOfPoolMemory) || (allocResult == vk::Result::eErrorFragmentedPool))
+    {
+        fullPools.push_back(currentPool);
+        currentPool = this->createPool();
+
+        this->stats.growCount++;
+        allocInfo.setDescriptorPool(currentPool);
+        allocResult = this->logicalDevice->allocateDescriptorSets(&allocInfo, &result);
+    }
+
+    if (allocResult != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to allocate descriptor set!");
+    }
+
+    return result;
+}
+
+const vk::DescriptorSet& DescriptorAllocator::getCachedSet(const vk::DescriptorSetLayout& layout, const std::vector<DescriptorWrite>& writes,
+    const vk::DescriptorUpdateTemplate* updateTemplate)
+{
+    DescriptorSetKey key;
+    key.layout = toHandleKey(layout);
+    key.writes = writes;
+
+    auto cached = cachedSets.find(key);
+    if (cached != cachedSets.end())
+    {
+        this->stats.cacheHits++;
+        return cached->second;
+    }
+
+    this->stats.cacheMisses++;
+    vk::DescriptorSet descriptorSet = this->allocate(layout);
+
+    if (updateTemplate != nullptr)
+    {
+        std::vector<uint8_t> templateData;
+        packTemplateData(writes, templateData);
+        this->logicalDevice->updateDescriptorSetWithTemplate(descriptorSet, *updateTemplate, templateData.data());
+        this->stats.templateUpdates++;
+
+        return cachedSets.emplace(key, descriptorSet).first->second;
+    }
+
+    // Reserved up front so the write structs can point into them.
+    std::vector<vk::DescriptorBufferInfo> bufferInfos;
+    std::vector<vk::DescriptorImageInfo> imageInfos;
+    std::vector<vk::WriteDescriptorSet> descriptorWrites;
+    bufferInfos.reserve(writes.size());
+    imageInfos.reserve(writes.size());
+
+    for (const DescriptorWrite& write : writes)
+    {
+        vk::WriteDescriptorSet descriptorWrite = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSet)
+            .setDstBinding(write.binding)
+            .setDstArrayElement(0)
+            .setDescriptorType(static_cast<vk::DescriptorType>(write.descriptorType))
+            .setDescriptorCount(1);
+
+        if (write.buffer != 0)
+        {
+            bufferInfos.push_back(vk::DescriptorBufferInfo(fromHandleKey<vk::Buffer>(write.buffer), write.offset, write.range));
+            descriptorWrite.setPBufferInfo(&bufferInfos.back());
+        }
+        else
+        {
+            imageInfos.push_back(vk::DescriptorImageInfo(fromHandleKey<vk::Sampler>(write.sampler), fromHandleKey<vk::ImageView>(write.imageView),
+                static_cast<vk::ImageLayout>(write.imageLayout)));
+            descriptorWrite.setPImageInfo(&imageInfos.back());
+        }
+
+        descriptorWrites.push_back(descriptorWrite);
+    }
+
+    this->logicalDevice->updateDescriptorSets(descriptorWrites, nullptr);
+
+    return cachedSets.emplace(key, descriptorSet).first->second;
+}
+
+void DescriptorAllocator::invalidateBuffer(const vk::Buffer& buffer)
+{
+    // The sets stay allocated until their pool is destroyed; the pools can't free single sets.
+    uint64_t handle = toHandleKey(buffer);
+    for (auto cached = cachedSets.begin(); cached != cachedSets.end();)
+    {
+        const std::vector<DescriptorWrite>& writes = cached->first.writes;
+        bool usesBuffer = std::any_of(writes.begin(), writes.end(), [handle](const DescriptorWrite& write)
+        {
+            return (write.buffer == handle);
+        });
+
+        cached = usesBuffer ? cachedSets.erase(cached) : std::next(cached);
+    }
+}
+
+void DescriptorAllocator::packTemplateData(const std::vector<DescriptorWrite>& writes, std::vector<uint8_t>& data)
+{
+    // The writes must already be in the order of the template's entries, one slot each.
+    data.assign(writes.size() * DESCRIPTOR_TEMPLATE_STRIDE, 0);
+    for (size_t i = 0; i < writes.size(); i++)
+    {
+        const DescriptorWrite& write = writes[i];
+        uint8_t* slot = data.data() + (i * DESCRIPTOR_TEMPLATE_STRIDE);
+        if (write.buffer != 0)
+        {
+            vk::DescriptorBufferInfo bufferInfo(fromHandleKey<vk::Buffer>(write.buffer), write.offset, write.range);
+            memcpy(slot, &bufferInfo, sizeof(bufferInfo));
+        }
+        else
+        {
+            vk::DescriptorImageInfo imageInfo(fromHandleKey<vk::Sampler>(write.sampler), fromHandleKey<vk::ImageView>(write.imageView),
+                static_cast<vk::ImageLayout>(write.imageLayout));
+            memcpy(slot, &imageInfo, sizeof(imageInfo));
+        }
+    }
+}
+
+const DescriptorAllocatorStats& DescriptorAllocator::getStats() const
+{
+    return this->stats;
+}
+
+void DescriptorAllocator::release()
+{
+    if (this->logicalDevice == nullptr)
+    {
+        return;
+    }
+
+    for (const vk::DescriptorPool& pool : fullPools)
+    {
+        this->logicalDevice->destroyDescriptorPool(pool);
+    }
+
+    if (currentPool)
+    {
+        this->logicalDevice->destroyDescriptorPool(currentPool);
+    }
+
+    // Destroyed handles can be reused by the driver, so cached sets must not outlive their pools.
+    currentPool = nullptr;
+    fullPools.clear();
+    cachedSets.clear();
+    this->stats.poolCount = 0;
+    this->logicalDevice = nullptr;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+#include <vector>
+
+// Descriptors of one type a pool holds per set it is sized for.
+struct PoolSizeRatio
+{
+	uint32_t descriptorType = 0;
+	float ratio = 1.0f;
+};
+
+// One descriptor of a set's contents; handles are stored by value so the write can key the set cache.
+struct DescriptorWrite
+{
+	uint32_t binding = 0;
+	uint32_t descriptorType = 0;
+	uint64_t buffer = 0;
+	uint64_t offset = 0;
+	uint64_t range = 0;
+	uint64_t imageView = 0;
+	uint64_t sampler = 0;
+	uint32_t imageLayout = 0;
+
+	bool operator==(const DescriptorWrite& other) const;
+
+	static DescriptorWrite fromBuffer(uint32_t binding, uint32_t descriptorType, const vk::DescriptorBufferInfo& bufferInfo);
+	static DescriptorWrite fromImage(uint32_t binding, uint32_t descriptorType, const vk::DescriptorImageInfo& imageInfo);
+};
+
+struct DescriptorSetKey
+{
+	uint64_t layout = 0;
+	std::vector<DescriptorWrite> writes;
+
+	bool operator==(const DescriptorSetKey& other) const;
+	size_t hash() const;
+};
+
+struct DescriptorSetKeyHash
+{
+	size_t operator()(const DescriptorSetKey& key) const
+	{
+		return key.hash();
+	}
+};
+
+struct DescriptorAllocatorStats
+{
+	uint32_t poolCount = 0;
+	uint32_t growCount = 0;
+	uint32_t cacheHits = 0;
+	uint32_t cacheMisses = 0;
+	uint32_t templateUpdates = 0;
+};
+
+/*
+* Allocates descriptor sets from a chain of pools instead of one pool sized up front. When a pool
+* runs out, a larger one is added and the allocation retried, so new materials never fail.
+*
+* Sets are cached by layout and contents: asking again for a set with the same bindings returns
+* the existing one without updateDescriptorSets. The key holds raw handles, which the driver may
+* hand out again once destroyed, so a buffer has to be invalidated before it is destroyed while
+* the allocator lives, or its stale sets could be returned.
+*
+* New sets are written through the layout's update template when there is one, which takes the
+* writes packed in template order instead of a WriteDescriptorSet per binding.
+*/
+class DescriptorAllocator
+{
+private:
+	vk::Device* logicalDevice = nullptr;
+	std::vector<PoolSizeRatio> ratios;
+	uint32_t setsPerPool = 0;
+	DescriptorAllocatorStats stats;
+
+private:
+	void init(vk::Device* logicalDevice, const std::vector<PoolSizeRatio>& ratios);
+	vk::DescriptorPool createPool();
+	vk::DescriptorSet allocate(const vk::DescriptorSetLayout& layout);
+	const vk::DescriptorSet& getCachedSet(const vk::DescriptorSetLayout& layout, const std::vector<DescriptorWrite>& writes,
+		const vk::DescriptorUpdateTemplate* updateTemplate);
+	void invalidateBuffer(const vk::Buffer& buffer);
+	static void packTemplateData(const std::vector<DescriptorWrite>& writes, std::vector<uint8_t>& data);
+	const DescriptorAllocatorStats& getStats() const;
+	void release();
+
+friend class DescriptorSets;
+friend class VulkanAPI;
+};
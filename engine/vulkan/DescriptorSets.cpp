@@ -2,44 +2,104 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <stdexcept>
+
 std::vector<vk::DescriptorSet> vkDescriptorSets;
 vk::DescriptorSetLayout descriptorSetLayout;
-vk::DescriptorPool descriptorPool;
+// Loaded from the device, since the loader doesn't export extension commands.
+PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate = nullptr;
 
-void DescriptorSets::initLayout(vk::Device* logicalDevice)
+void DescriptorSets::initLayout(vk::Device* logicalDevice, const vk::DescriptorSetLayout& layout, const std::vector<ReflectedBinding>& bindings,
+    const vk::DescriptorUpdateTemplate* updateTemplate, bool pushDescriptors)
 {
-    vk::DescriptorSetLayoutBinding uboLayoutBinding{ 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex };
-    vk::DescriptorSetLayoutBinding samplerLayoutBinding{ 1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment };
-    
-    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-    
-    vk::DescriptorSetLayoutCreateInfo LayoutInfo{ {}, bindings };
-
-    descriptorSetLayout = logicalDevice->createDescriptorSetLayout(LayoutInfo);
+    // The layout and template themselves belong to the LayoutCache.
+    descriptorSetLayout = layout;
+    this->bindings = bindings;
+    this->updateTemplate = updateTemplate;
+    this->pushDescriptors = false;
+
+    if (pushDescriptors && (updateTemplate != nullptr))
+    {
+        cmdPushDescriptorSetWithTemplate = (PFN_vkCmdPushDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(
+            static_cast<VkDevice>(*logicalDevice), "vkCmdPushDescriptorSetWithTemplateKHR");
+        this->pushDescriptors = (cmdPushDescriptorSetWithTemplate != nullptr);
+    }
+
+    if (pushDescriptors && !this->pushDescriptors)
+    {
+        throw std::runtime_error("Failed to load vkCmdPushDescriptorSetWithTemplateKHR!");
+    }
 }
 
 void DescriptorSets::initPool(vk::Device* logicalDevice, uint32_t maxFramesInFlight)
 {
-    std::array<vk::DescriptorPoolSize, 2> poolSizes =
-    { 
-        vk::DescriptorPoolSize{ vk::DescriptorType::eUniformBuffer, maxFramesInFlight },
-        vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, maxFramesInFlight}
-    };
-
-    vk::DescriptorPoolCreateInfo poolInfo{ {} , maxFramesInFlight, poolSizes};
-    descriptorPool = logicalDevice->createDescriptorPool(poolInfo);
+    std::vector<PoolSizeRatio> ratios;
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        ratios.push_back(PoolSizeRatio{ binding.descriptorType, static_cast<float>(binding.count) });
+    }
+
+    // Pools are only created on the first allocation, so a pushed set 0 costs nothing here.
+    this->allocator.init(logicalDevice, ratios);
+    this->resizeFrames(maxFramesInFlight);
+}
+
+void DescriptorSets::resizeFrames(uint32_t maxFramesInFlight)
+{
+    // The cache outlives a change in frame count; only the per-frame bindings follow it.
+    vkDescriptorSets.resize(maxFramesInFlight);
+    this->pushData.resize(maxFramesInFlight);
 }
 
-void DescriptorSets::initDescriptorSet(vk::Device* logicalDevice, uint32_t maxFramesInFlight)
+std::vector<DescriptorWrite> DescriptorSets::sortWrites(const std::vector<DescriptorWrite>& writes) const
 {
-    std::vector<vk::DescriptorSetLayout> layouts(maxFramesInFlight, descriptorSetLayout);
-    
-    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
-        .setDescriptorPool(descriptorPool)
-        .setDescriptorSetCount(maxFramesInFlight)
-        .setSetLayouts(layouts);
-
-    vkDescriptorSets = logicalDevice->allocateDescriptorSets(allocInfo);
+    // Update templates read the writes in reflected binding order.
+    std::vector<DescriptorWrite> result;
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        bool found = false;
+        for (const DescriptorWrite& write : writes)
+        {
+            if (write.binding == binding.binding)
+            {
+                result.push_back(write);
+                found = true;
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            throw std::runtime_error("Descriptor set is missing a write for one of its bindings!");
+        }
+    }
+
+    return result;
+}
+
+void DescriptorSets::createDescriptorSet(uint32_t frame, const std::vector<DescriptorWrite>& writes)
+{
+    std::vector<DescriptorWrite> sortedWrites = this->sortWrites(writes);
+    if (this->pushDescriptors)
+    {
+        DescriptorAllocator::packTemplateData(sortedWrites, this->pushData[frame]);
+        return;
+    }
+
+    // Frames that bind the same resources share a set.
+    vkDescriptorSets[frame] = this->allocator.getCachedSet(descriptorSetLayout, sortedWrites, this->updateTemplate);
+}
+
+void DescriptorSets::bind(const vk::CommandBuffer& commandBuffer, const vk::PipelineLayout& pipelineLayout, uint32_t frame) const
+{
+    if (this->pushDescriptors)
+    {
+        cmdPushDescriptorSetWithTemplate(static_cast<VkCommandBuffer>(commandBuffer), static_cast<VkDescriptorUpdateTemplate>(*this->updateTemplate),
+            static_cast<VkPipelineLayout>(pipelineLayout), 0, this->pushData[frame].data());
+        return;
+    }
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1, &vkDescriptorSets[frame], 0, nullptr);
 }
 
 vk::DescriptorSet& DescriptorSets::getDescriptorSet(uint32_t index)
@@ -47,19 +107,33 @@ vk::DescriptorSet& DescriptorSets::getDescriptorSet(uint32_t index)
     return vkDescriptorSets[index];
 }
 
-vk::PipelineLayoutCreateInfo DescriptorSets::createPipelineLayoutInfo()
+bool DescriptorSets::isPushEnabled() const
 {
-    vk::PipelineLayoutCreateInfo result = vk::PipelineLayoutCreateInfo()
-        .setSetLayoutCount(1)
-        .setPSetLayouts(&descriptorSetLayout)
-        .setPushConstantRangeCount(0)
-        .setPPushConstantRanges(nullptr);
+    return this->pushDescriptors;
+}
 
-    return result;
+void DescriptorSets::invalidateBuffer(const vk::Buffer& buffer)
+{
+    this->allocator.invalidateBuffer(buffer);
+}
+
+const DescriptorAllocatorStats& DescriptorSets::getStats() const
+{
+    return this->allocator.getStats();
+}
+
+void DescriptorSets::releasePool()
+{
+    // Destroying the pools frees every set allocated from them.
+    this->allocator.release();
+    vkDescriptorSets.clear();
+    this->pushData.clear();
 }
 
 void DescriptorSets::release(vk::Device* logicalDevice)
 {
-    logicalDevice->destroyDescriptorPool(descriptorPool);
-    logicalDevice->destroyDescriptorSetLayout(descriptorSetLayout);
+    this->releasePool();
+    descriptorSetLayout = nullptr;
+    this->updateTemplate = nullptr;
+    this->pushDescriptors = false;
 }
@@ -1,19 +1,43 @@
 #pragma once
 
 #include "vk_forward_declarations.h"
+#include "ShaderReflection.h"
+#include "DescriptorAllocator.h"
 
 #include <memory>
 #include <vector>
 
+/*
+* Set 0 for each frame in flight. The set is either allocated and cached, or, with
+* VK_KHR_push_descriptor, pushed straight into the command buffer through an update template
+* each time it is bound, so nothing is allocated for it at all.
+*/
 class DescriptorSets
 {
 private:
-	void initLayout(vk::Device* logicalDevice);
+	// Set 0 as reflected from the shaders; the pool size ratios and the write order come from it.
+	std::vector<ReflectedBinding> bindings;
+	DescriptorAllocator allocator;
+	const vk::DescriptorUpdateTemplate* updateTemplate = nullptr;
+	bool pushDescriptors = false;
+	// Per frame template data for the pushed set.
+	std::vector<std::vector<uint8_t>> pushData;
+
+private:
+	void initLayout(vk::Device* logicalDevice, const vk::DescriptorSetLayout& layout, const std::vector<ReflectedBinding>& bindings,
+		const vk::DescriptorUpdateTemplate* updateTemplate, bool pushDescriptors);
 	void initPool(vk::Device* logicalDevice, uint32_t maxFramesInFlight);
-	void initDescriptorSet(vk::Device* logicalDevice, uint32_t maxFramesInFlight);
+	void resizeFrames(uint32_t maxFramesInFlight);
+	std::vector<DescriptorWrite> sortWrites(const std::vector<DescriptorWrite>& writes) const;
+	void createDescriptorSet(uint32_t frame, const std::vector<DescriptorWrite>& writes);
+	void bind(const vk::CommandBuffer& commandBuffer, const vk::PipelineLayout& pipelineLayout, uint32_t frame) const;
 	vk::DescriptorSet& getDescriptorSet(uint32_t index);
-	vk::PipelineLayoutCreateInfo createPipelineLayoutInfo();
+	bool isPushEnabled() const;
+	void invalidateBuffer(const vk::Buffer& buffer);
+	const DescriptorAllocatorStats& getStats() const;
+	void releasePool();
 	void release(vk::Device* logicalDevice);
 
 friend class VulkanAPI;
+friend class CommandBuffers;
 };
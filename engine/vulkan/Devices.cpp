@@ -3,14 +3,32 @@
 #include "Swapchain.h"
 
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <set>
 
 const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+const std::vector<const char*> pipelineLibraryExtensions = { VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME };
+const std::vector<const char*> pushDescriptorExtensions = { VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME };
+const std::vector<const char*> memoryBudgetExtensions = { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME };
 
-void Devices::init(const vk::Instance& instance, const vk::SurfaceKHR& surface, const ValidationLayers& validationLayers)
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+const uint32_t MAX_BINDLESS_BUFFERS = 256;
+
+bool hasExtensions(const std::vector<vk::ExtensionProperties>& availableExtensions, const std::vector<const char*>& extensions)
+{
+    std::set<std::string> missingExtensions(extensions.begin(), extensions.end());
+    for (const vk::ExtensionProperties& extension : availableExtensions)
+    {
+        missingExtensions.erase(extension.extensionName);
+    }
+
+    return missingExtensions.empty();
+}
+
+void Devices::init(const vk::Instance& instance, uint32_t instanceApiVersion, const vk::SurfaceKHR& surface, const ValidationLayers& validationLayers)
 {
     this->pickPhysicalDevice(instance, surface);
-    this->createLogicalDevice(validationLayers);
+    this->createLogicalDevice(validationLayers, instanceApiVersion);
 }
 
 void Devices::pickPhysicalDevice(const vk::Instance& instance, const vk::SurfaceKHR& surface)
@@ -37,7 +55,7 @@ void Devices::pickPhysicalDevice(const vk::Instance& instance, const vk::Surface
     }
 }
 
-void Devices::createLogicalDevice(const ValidationLayers& validationLayers)
+void Devices::createLogicalDevice(const ValidationLayers& validationLayers, uint32_t instanceApiVersion)
 {
     std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { this->familyIndices.graphicsFamily.value(), this->familyIndices.presentFamily.value() };
@@ -53,16 +71,142 @@ void Devices::createLogicalDevice(const ValidationLayers& validationLayers)
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures()
-        .setSamplerAnisotropy(vk::True);
+    vk::PhysicalDeviceProperties properties = this->physicalDevice->getProperties();
+    this->capabilities.apiVersion = std::min(properties.apiVersion, instanceApiVersion);
+
+    // Optional extensions are only enabled when the device has them.
+    std::vector<vk::ExtensionProperties> availableExtensions = this->physicalDevice->enumerateDeviceExtensionProperties();
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    bool pipelineLibrarySupported = hasExtensions(availableExtensions, pipelineLibraryExtensions);
+
+    vk::PhysicalDeviceFeatures supportedFeatures = this->physicalDevice->getFeatures();
+    vk::PhysicalDeviceVulkan12Features supportedFeatures12;
+    vk::PhysicalDeviceVulkan13Features supportedFeatures13;
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedLibraryFeatures;
+    if (this->capabilities.apiVersion >= VK_API_VERSION_1_3)
+    {
+        supportedFeatures12.setPNext(&supportedFeatures13);
+    }
+
+    if (pipelineLibrarySupported)
+    {
+        supportedLibraryFeatures.setPNext(supportedFeatures12.pNext);
+        supportedFeatures12.setPNext(&supportedLibraryFeatures);
+    }
+
+    if (this->capabilities.apiVersion >= VK_API_VERSION_1_2)
+    {
+        vk::PhysicalDeviceFeatures2 supportedFeatures2 = vk::PhysicalDeviceFeatures2()
+            .setPNext(&supportedFeatures12);
+        this->physicalDevice->getFeatures2(&supportedFeatures2);
+    }
+
+    this->capabilities.multiDrawIndirect = (supportedFeatures.multiDrawIndirect == vk::True);
+    this->capabilities.drawIndirectCount = (supportedFeatures12.drawIndirectCount == vk::True);
+    this->capabilities.timelineSemaphore = (supportedFeatures12.timelineSemaphore == vk::True);
+    this->capabilities.dynamicRendering = (supportedFeatures13.dynamicRendering == vk::True);
+    this->capabilities.graphicsPipelineLibrary = (supportedLibraryFeatures.graphicsPipelineLibrary == vk::True);
+
+    // Bindless needs every descriptor indexing feature it relies on, not just the umbrella bit.
+    this->capabilities.descriptorIndexing = (supportedFeatures12.descriptorIndexing == vk::True) &&
+        (supportedFeatures12.shaderSampledImageArrayNonUniformIndexing == vk::True) &&
+        (supportedFeatures12.runtimeDescriptorArray == vk::True) &&
+        (supportedFeatures12.descriptorBindingPartiallyBound == vk::True) &&
+        (supportedFeatures12.descriptorBindingVariableDescriptorCount == vk::True) &&
+        (supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind == vk::True) &&
+        (supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind == vk::True);
+
+    if (this->capabilities.descriptorIndexing)
+    {
+        vk::PhysicalDeviceVulkan12Properties properties12;
+        vk::PhysicalDeviceProperties2 properties2 = vk::PhysicalDeviceProperties2()
+            .setPNext(&properties12);
+        this->physicalDevice->getProperties2(&properties2);
+
+        this->capabilities.maxBindlessTextures = std::min({ MAX_BINDLESS_TEXTURES, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            properties12.maxPerStageDescriptorUpdateAfterBindSamplers });
+        this->capabilities.maxBindlessBuffers = std::min(MAX_BINDLESS_BUFFERS, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    }
+
+    // Update templates are core in 1.1; pushing through a template needs both.
+    this->capabilities.descriptorUpdateTemplate = (this->capabilities.apiVersion >= VK_API_VERSION_1_1);
+    this->capabilities.pushDescriptor = this->capabilities.descriptorUpdateTemplate && hasExtensions(availableExtensions, pushDescriptorExtensions);
+
+    // The budget is read through vkGetPhysicalDeviceMemoryProperties2, which is core in 1.1.
+    this->capabilities.memoryBudget = (this->capabilities.apiVersion >= VK_API_VERSION_1_1) && hasExtensions(availableExtensions, memoryBudgetExtensions);
+
+    // The extended dynamic state 1 and 2 commands we use are core in 1.3 and need no feature bit.
+    this->capabilities.extendedDynamicState = (this->capabilities.apiVersion >= VK_API_VERSION_1_3);
+
+    vk::PhysicalDeviceVulkan12Features enabledFeatures12 = vk::PhysicalDeviceVulkan12Features()
+        .setDrawIndirectCount(this->capabilities.drawIndirectCount)
+        .setTimelineSemaphore(this->capabilities.timelineSemaphore)
+        .setDescriptorIndexing(this->capabilities.descriptorIndexing)
+        .setShaderSampledImageArrayNonUniformIndexing(this->capabilities.descriptorIndexing)
+        .setRuntimeDescriptorArray(this->capabilities.descriptorIndexing)
+        .setDescriptorBindingPartiallyBound(this->capabilities.descriptorIndexing)
+        .setDescriptorBindingVariableDescriptorCount(this->capabilities.descriptorIndexing)
+        .setDescriptorBindingSampledImageUpdateAfterBind(this->capabilities.descriptorIndexing)
+        .setDescriptorBindingStorageBufferUpdateAfterBind(this->capabilities.descriptorIndexing);
+
+    vk::PhysicalDeviceVulkan13Features enabledFeatures13 = vk::PhysicalDeviceVulkan13Features()
+        .setDynamicRendering(this->capabilities.dynamicRendering);
+
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT enabledLibraryFeatures = vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT()
+        .setGraphicsPipelineLibrary(this->capabilities.graphicsPipelineLibrary);
+
+    vk::PhysicalDeviceFeatures2 enabledFeatures2 = vk::PhysicalDeviceFeatures2()
+        .setFeatures
+        (
+            vk::PhysicalDeviceFeatures()
+                .setSamplerAnisotropy(vk::True)
+                .setMultiDrawIndirect(this->capabilities.multiDrawIndirect)
+        );
 
     vk::DeviceCreateInfo createInfo = vk::DeviceCreateInfo()
         .setQueueCreateInfoCount(static_cast<uint32_t>(queueCreateInfos.size()))
         .setPQueueCreateInfos(queueCreateInfos.data())
-        .setPEnabledFeatures(&deviceFeatures)
-        .setPEnabledExtensionNames(deviceExtensions)
         .setPEnabledLayerNames(validationLayers.getData());
 
+    if (this->capabilities.apiVersion >= VK_API_VERSION_1_3)
+    {
+        enabledFeatures12.setPNext(&enabledFeatures13);
+    }
+
+    if (this->capabilities.graphicsPipelineLibrary)
+    {
+        enabledExtensions.insert(enabledExtensions.end(), pipelineLibraryExtensions.begin(), pipelineLibraryExtensions.end());
+        enabledLibraryFeatures.setPNext(enabledFeatures12.pNext);
+        enabledFeatures12.setPNext(&enabledLibraryFeatures);
+    }
+
+    if (this->capabilities.pushDescriptor)
+    {
+        enabledExtensions.insert(enabledExtensions.end(), pushDescriptorExtensions.begin(), pushDescriptorExtensions.end());
+    }
+
+    if (this->capabilities.memoryBudget)
+    {
+        enabledExtensions.insert(enabledExtensions.end(), memoryBudgetExtensions.begin(), memoryBudgetExtensions.end());
+    }
+
+    createInfo.setPEnabledExtensionNames(enabledExtensions);
+
+    if (this->capabilities.apiVersion >= VK_API_VERSION_1_2)
+    {
+        enabledFeatures2.setPNext(&enabledFeatures12);
+    }
+
+    // VkPhysicalDeviceFeatures2 and anything chained to it needs 1.1; older devices take the plain struct.
+    if (this->capabilities.apiVersion >= VK_API_VERSION_1_1)
+    {
+        createInfo.setPNext(&enabledFeatures2);
+    }
+    else
+    {
+        createInfo.setPEnabledFeatures(&enabledFeatures2.features);
+    }
+
     this->logicalDevice.reset(new vk::Device{ physicalDevice->createDevice(createInfo) });
 
     if (!this->logicalDevice)
@@ -96,7 +240,55 @@ const vk::Queue* Devices::getPresentQueue()
     return this->presentQueue.get();
 }
 
+const DeviceCapabilities& Devices::getCapabilities() const
+{
+    return this->capabilities;
+}
+
+std::vector<MemoryHeapUsage> Devices::getMemoryHeapUsage()
+{
+    vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+    vk::PhysicalDeviceMemoryProperties memProperties;
+    if (this->capabilities.memoryBudget)
+    {
+        vk::PhysicalDeviceMemoryProperties2 memProperties2 = vk::PhysicalDeviceMemoryProperties2()
+            .setPNext(&budgetProperties);
+        this->physicalDevice->getMemoryProperties2(&memProperties2);
+        memProperties = memProperties2.memoryProperties;
+    }
+    else
+    {
+        memProperties = this->physicalDevice->getMemoryProperties();
+    }
+
+    std::vector<MemoryHeapUsage> result(memProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+    {
+        result[i].size = memProperties.memoryHeaps[i].size;
+        result[i].deviceLocal = static_cast<bool>(memProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        if (this->capabilities.memoryBudget)
+        {
+            result[i].usage = budgetProperties.heapUsage[i];
+            result[i].budget = budgetProperties.heapBudget[i];
+        }
+    }
+
+    return result;
+}
+
 uint32_t Devices::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+{
+    std::optional<uint32_t> result = this->findOptionalMemoryType(typeFilter, properties);
+
+    if (!result.has_value())
+    {
+        throw std::runtime_error("Failed to find suitable memory type!");
+    }
+
+    return result.value();
+}
+
+std::optional<uint32_t> Devices::findOptionalMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
 {
     vk::PhysicalDeviceMemoryProperties memProperties = physicalDevice->getMemoryProperties();
 
@@ -108,7 +300,7 @@ uint32_t Devices::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags pr
         }
     }
 
-    throw std::runtime_error("Failed to find suitable memory type!");
+    return std::nullopt;
 }
 
 vk::Format Devices::findDepthFormat()
@@ -209,15 +401,7 @@ QueueFamilyIndices Devices::findQueueFamilies(const vk::SurfaceKHR& surface, con
 
 bool Devices::checkDeviceExtensionSupport(const vk::PhysicalDevice& device)
 {
-    std::vector<vk::ExtensionProperties> availableExtensions = device.enumerateDeviceExtensionProperties();
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-    for (const vk::ExtensionProperties& extension : availableExtensions)
-    {
-        requiredExtensions.erase(extension.extensionName);
-    }
-
-    return requiredExtensions.empty();
+    return hasExtensions(device.enumerateDeviceExtensionProperties(), deviceExtensions);
 }
 
 vk::ImageView Devices::createImageView(vk::Image& image, vk::Format format, vk::ImageAspectFlags aspectFlags)
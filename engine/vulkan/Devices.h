@@ -19,6 +19,33 @@ struct QueueFamilyIndices
     }
 };
 
+struct DeviceCapabilities
+{
+    uint32_t apiVersion = 0;
+    bool multiDrawIndirect = false;
+    bool drawIndirectCount = false;
+    bool timelineSemaphore = false;
+    bool dynamicRendering = false;
+    bool graphicsPipelineLibrary = false;
+    bool extendedDynamicState = false;
+    bool descriptorIndexing = false;
+    bool descriptorUpdateTemplate = false;
+    bool pushDescriptor = false;
+    bool memoryBudget = false;
+    // Descriptor counts for runtime-sized (bindless) arrays, within the device's update-after-bind limits.
+    uint32_t maxBindlessTextures = 0;
+    uint32_t maxBindlessBuffers = 0;
+};
+
+// Usage and budget are only known with VK_EXT_memory_budget; without it they stay 0.
+struct MemoryHeapUsage
+{
+    uint64_t size = 0;
+    uint64_t usage = 0;
+    uint64_t budget = 0;
+    bool deviceLocal = false;
+};
+
 struct SwapChainSupportDetails;
 
 class Devices
@@ -27,18 +54,22 @@ private:
 	std::shared_ptr<vk::PhysicalDevice> physicalDevice;
 	std::shared_ptr<vk::Device> logicalDevice;
     QueueFamilyIndices familyIndices;
+    DeviceCapabilities capabilities;
     std::shared_ptr<vk::Queue> graphicsQueue;
     std::shared_ptr<vk::Queue> presentQueue;
 
 private:
-    void init(const vk::Instance& instance, const vk::SurfaceKHR& surface, const ValidationLayers& validationLayers);
+    void init(const vk::Instance& instance, uint32_t instanceApiVersion, const vk::SurfaceKHR& surface, const ValidationLayers& validationLayers);
     void pickPhysicalDevice(const vk::Instance& instance, const vk::SurfaceKHR& surface);
-    void createLogicalDevice(const ValidationLayers& validationLayers);
+    void createLogicalDevice(const ValidationLayers& validationLayers, uint32_t instanceApiVersion);
     vk::Device* getDevice();
     vk::PhysicalDevice* getPhysicalDevice();
     const vk::Queue* getGraphicsQueue();
     const vk::Queue* getPresentQueue();
+    const DeviceCapabilities& getCapabilities() const;
+    std::vector<MemoryHeapUsage> getMemoryHeapUsage();
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+    std::optional<uint32_t> findOptionalMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
     vk::Format findDepthFormat();
     vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
     bool hasStencilComponent(vk::Format format);
@@ -52,4 +83,8 @@ friend class VulkanAPI;
 friend class Swapchain;
 friend class RenderPass;
 friend class CommandBuffers;
+friend class GpuCulling;
+friend class TransientImages;
+friend class GraphicsPipelines;
+friend class GpuTimer;
 };
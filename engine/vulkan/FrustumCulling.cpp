@@ -0,0 +1,221 @@
+#include "FrustumCulling.h"
+#include "engine/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FRUSTUM_CULLING_SSE
+#endif
+
+// Bounds arrays are padded to a multiple of this so every SIMD iteration runs full lanes.
+const uint32_t CULLING_PADDING = 8;
+// Below this many objects per batch, spreading the work across threads costs more than it saves.
+const uint32_t MIN_OBJECTS_PER_BATCH = 4096;
+
+void FrustumCulling::resize(uint32_t count)
+{
+    uint32_t paddedCount = ((count + CULLING_PADDING - 1) / CULLING_PADDING) * CULLING_PADDING;
+
+    this->objectCount = count;
+    this->centerX.assign(paddedCount, 0.0f);
+    this->centerY.assign(paddedCount, 0.0f);
+    this->centerZ.assign(paddedCount, 0.0f);
+    this->extentX.assign(paddedCount, 0.0f);
+    this->extentY.assign(paddedCount, 0.0f);
+    this->extentZ.assign(paddedCount, 0.0f);
+    this->radius.assign(paddedCount, 0.0f);
+    this->visibility.assign(paddedCount, 1);
+}
+
+void FrustumCulling::setObjectBounds(uint32_t index, const Bounds& localBounds, const glm::mat4& transform)
+{
+    glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(localBounds.center, 1.0f));
+
+    // Arvo's method: the world AABB extents are the local extents projected onto the absolute rotation/scale.
+    glm::mat3 absolute{ glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])) };
+    glm::vec3 worldExtents = absolute * localBounds.extents;
+
+    float maxScale = std::max
+    (
+        glm::length(glm::vec3(transform[0])),
+        std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])))
+    );
+
+    this->centerX[index] = worldCenter.x;
+    this->centerY[index] = worldCenter.y;
+    this->centerZ[index] = worldCenter.z;
+    this->extentX[index] = worldExtents.x;
+    this->extentY[index] = worldExtents.y;
+    this->extentZ[index] = worldExtents.z;
+    this->radius[index] = localBounds.radius * maxScale;
+}
+
+void FrustumCulling::cull(const glm::mat4& viewProjection, ThreadPool* threadPool)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    extractPlanes(viewProjection, this->planes);
+
+    uint32_t packetCount = static_cast<uint32_t>(this->radius.size()) / CULLING_PADDING;
+    if (threadPool != nullptr)
+    {
+        threadPool->parallelFor(packetCount, MIN_OBJECTS_PER_BATCH / CULLING_PADDING, [this](uint32_t begin, uint32_t end)
+        {
+            this->cullRange(begin * CULLING_PADDING, end * CULLING_PADDING);
+        });
+    }
+    else
+    {
+        this->cullRange(0, packetCount * CULLING_PADDING);
+    }
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < this->objectCount; i++)
+    {
+        visibleCount += this->visibility[i];
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    this->stats.visibleCount = visibleCount;
+    this->stats.culledCount = this->objectCount - visibleCount;
+    this->stats.cullTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+void FrustumCulling::cullRange(uint32_t begin, uint32_t end)
+{
+    // An object is outside when it lies fully behind any plane. Both the sphere and the AABB
+    // are conservative, so the smaller of the two projected radii gives the tighter test.
+#if defined(__AVX__)
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (uint32_t i = begin; i < end; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(&this->centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&this->centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&this->centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&this->extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&this->extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&this->extentZ[i]);
+        __m256 r = _mm256_loadu_ps(&this->radius[i]);
+        __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+        for (const glm::vec4& plane : this->planes)
+        {
+            __m256 distance = _mm256_add_ps
+            (
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz), _mm256_set1_ps(plane.w))
+            );
+
+            __m256 boxRadius = _mm256_add_ps
+            (
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.y)), ey)),
+                _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.z)), ez)
+            );
+
+            __m256 projectedRadius = _mm256_min_ps(boxRadius, r);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, projectedRadius), zero, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(visible);
+        for (uint32_t lane = 0; lane < 8; lane++)
+        {
+            this->visibility[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+        }
+    }
+#elif defined(FRUSTUM_CULLING_SSE)
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&this->centerX[i]);
+        __m128 cy = _mm_loadu_ps(&this->centerY[i]);
+        __m128 cz = _mm_loadu_ps(&this->centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&this->extentX[i]);
+        __m128 ey = _mm_loadu_ps(&this->extentY[i]);
+        __m128 ez = _mm_loadu_ps(&this->extentZ[i]);
+        __m128 r = _mm_loadu_ps(&this->radius[i]);
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+
+        for (const glm::vec4& plane : this->planes)
+        {
+            __m128 distance = _mm_add_ps
+            (
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w))
+            );
+
+            __m128 boxRadius = _mm_add_ps
+            (
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), ey)),
+                _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), ez)
+            );
+
+            __m128 projectedRadius = _mm_min_ps(boxRadius, r);
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, projectedRadius), zero));
+        }
+
+        int mask = _mm_movemask_ps(visible);
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            this->visibility[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+        }
+    }
+#else
+    for (uint32_t i = begin; i < end; i++)
+    {
+        bool visible = true;
+        for (const glm::vec4& plane : this->planes)
+        {
+            float distance = (plane.x * this->centerX[i]) + (plane.y * this->centerY[i]) + (plane.z * this->centerZ[i]) + plane.w;
+            float boxRadius = (std::fabs(plane.x) * this->extentX[i]) + (std::fabs(plane.y) * this->extentY[i]) + (std::fabs(plane.z) * this->extentZ[i]);
+
+            if ((distance + std::min(boxRadius, this->radius[i])) < 0.0f)
+            {
+                visible = false;
+                break;
+            }
+        }
+
+        this->visibility[i] = visible ? 1 : 0;
+    }
+#endif
+}
+
+bool FrustumCulling::isVisible(uint32_t index) const
+{
+    return this->visibility[index] != 0;
+}
+
+const CullingStats& FrustumCulling::getStats() const
+{
+    return this->stats;
+}
+
+void FrustumCulling::extractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    // Gribb/Hartmann extraction; glm is column major so rows are gathered across columns.
+    // The projection uses a [0, 1] depth range, so the near plane is the third row alone.
+    glm::vec4 row0{ viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0] };
+    glm::vec4 row1{ viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1] };
+    glm::vec4 row2{ viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2] };
+    glm::vec4 row3{ viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3] };
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+    {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Model.h"
+
+#include <vector>
+
+class ThreadPool;
+
+struct CullingStats
+{
+	uint32_t visibleCount = 0;
+	uint32_t culledCount = 0;
+	double cullTimeMs = 0.0;
+};
+
+class FrustumCulling
+{
+private:
+	// World space bounds stored as SoA, padded to the SIMD width so the tail needs no special case.
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<float> radius;
+	std::vector<uint8_t> visibility;
+	uint32_t objectCount = 0;
+	glm::vec4 planes[6];
+	CullingStats stats;
+
+private:
+	void resize(uint32_t count);
+	void setObjectBounds(uint32_t index, const Bounds& localBounds, const glm::mat4& transform);
+	void cull(const glm::mat4& viewProjection, ThreadPool* threadPool);
+	void cullRange(uint32_t begin, uint32_t end);
+	bool isVisible(uint32_t index) const;
+	const CullingStats& getStats() const;
+	static void extractPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+friend class CommandBuffers;
+friend class GpuCulling;
+friend class VulkanAPI;
+};
@@ -0,0 +1,377 @@
+#include "GpuCulling.h"
+#include "CommandBuffers.h"
+#include "Devices.h"
+#include "FrustumCulling.h"
+
+#include "engine/Utils.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <iostream>
+
+// Mirrors the std430 layouts in cull.comp.
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec4 boundsCenterRadius;
+    glm::vec4 boundsExtents;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t padding;
+};
+
+// Mirrors the DrawCount block; drawCount must stay first for drawIndexedIndirectCount.
+struct CullingCounters
+{
+    uint32_t drawCount;
+    uint32_t triangleCount;
+};
+
+struct CullingConstants
+{
+    glm::vec4 planes[6];
+    uint32_t instanceCount;
+    uint32_t compact;
+};
+
+const uint32_t CULLING_GROUP_SIZE = 64;
+
+vk::DescriptorSetLayout cullingDescriptorSetLayout;
+vk::DescriptorPool cullingDescriptorPool;
+std::vector<vk::DescriptorSet> cullingDescriptorSets;
+vk::PipelineLayout cullingPipelineLayout;
+vk::Pipeline cullingPipeline;
+
+std::vector<vk::Buffer> instanceBuffers;
+std::vector<vk::DeviceMemory> instanceBuffersMemory;
+std::vector<InstanceData*> instanceBuffersMapped;
+std::vector<vk::Buffer> drawCommandBuffers;
+std::vector<vk::DeviceMemory> drawCommandBuffersMemory;
+std::vector<vk::Buffer> drawCountBuffers;
+std::vector<vk::DeviceMemory> drawCountBuffersMemory;
+std::vector<vk::Buffer> counterReadbackBuffers;
+std::vector<vk::DeviceMemory> counterReadbackBuffersMemory;
+std::vector<CullingCounters*> counterReadbackMapped;
+
+void GpuCulling::init(Devices& devices, CommandBuffers& commandBuffers, int maxFramesInFlight, uint32_t instanceCount)
+{
+    std::vector<char> shaderCode;
+    try
+    {
+        shaderCode = Utils::readFile("../../shaders/cull.spv");
+    }
+    catch (const std::exception&)
+    {
+        std::cout << "GPU culling disabled: cull.spv not found, falling back to CPU culling." << std::endl;
+        return;
+    }
+
+    const DeviceCapabilities& capabilities = devices.getCapabilities();
+    this->compact = capabilities.drawIndirectCount;
+    this->multiDraw = capabilities.multiDrawIndirect;
+    this->instanceCount = instanceCount;
+    this->maxFramesInFlight = maxFramesInFlight;
+
+    vk::Device* logicalDevice = devices.getDevice();
+    this->createBuffers(devices, commandBuffers);
+    this->createDescriptorSets(logicalDevice);
+    this->createPipeline(logicalDevice, shaderCode);
+
+    this->enabled = true;
+}
+
+void GpuCulling::createBuffers(Devices& devices, CommandBuffers& commandBuffers)
+{
+    vk::Device* logicalDevice = devices.getDevice();
+    vk::DeviceSize instancesSize = sizeof(InstanceData) * this->instanceCount;
+    vk::DeviceSize drawCommandsSize = sizeof(vk::DrawIndexedIndirectCommand) * this->instanceCount;
+
+    instanceBuffers.resize(this->maxFramesInFlight);
+    instanceBuffersMemory.resize(this->maxFramesInFlight);
+    instanceBuffersMapped.resize(this->maxFramesInFlight);
+    drawCommandBuffers.resize(this->maxFramesInFlight);
+    drawCommandBuffersMemory.resize(this->maxFramesInFlight);
+    drawCountBuffers.resize(this->maxFramesInFlight);
+    drawCountBuffersMemory.resize(this->maxFramesInFlight);
+    counterReadbackBuffers.resize(this->maxFramesInFlight);
+    counterReadbackBuffersMemory.resize(this->maxFramesInFlight);
+    counterReadbackMapped.resize(this->maxFramesInFlight);
+    this->countersPending.assign(this->maxFramesInFlight, false);
+
+    for (size_t i = 0; i < this->maxFramesInFlight; i++)
+    {
+        commandBuffers.createBuffer(devices, instancesSize, vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, instanceBuffers[i], instanceBuffersMemory[i]);
+        instanceBuffersMapped[i] = static_cast<InstanceData*>(logicalDevice->mapMemory(instanceBuffersMemory[i], 0, instancesSize));
+
+        commandBuffers.createBuffer(devices, drawCommandsSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+
+        commandBuffers.createBuffer(devices, sizeof(CullingCounters),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst |
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, drawCountBuffers[i], drawCountBuffersMemory[i]);
+
+        commandBuffers.createBuffer(devices, sizeof(CullingCounters), vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, counterReadbackBuffers[i], counterReadbackBuffersMemory[i]);
+        counterReadbackMapped[i] = static_cast<CullingCounters*>(logicalDevice->mapMemory(counterReadbackBuffersMemory[i], 0, sizeof(CullingCounters)));
+    }
+}
+
+void GpuCulling::createDescriptorSets(vk::Device* logicalDevice)
+{
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings =
+    {
+        vk::DescriptorSetLayoutBinding{ 0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
+        vk::DescriptorSetLayoutBinding{ 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
+        vk::DescriptorSetLayoutBinding{ 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }
+    };
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{ {}, bindings };
+    cullingDescriptorSetLayout = logicalDevice->createDescriptorSetLayout(layoutInfo);
+
+    uint32_t setCount = static_cast<uint32_t>(this->maxFramesInFlight);
+    vk::DescriptorPoolSize poolSize{ vk::DescriptorType::eStorageBuffer, setCount * static_cast<uint32_t>(bindings.size()) };
+    vk::DescriptorPoolCreateInfo poolInfo{ {}, setCount, poolSize };
+    cullingDescriptorPool = logicalDevice->createDescriptorPool(poolInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(setCount, cullingDescriptorSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(cullingDescriptorPool)
+        .setSetLayouts(layouts);
+
+    cullingDescriptorSets = logicalDevice->allocateDescriptorSets(allocInfo);
+
+    for (uint32_t i = 0; i < setCount; i++)
+    {
+        std::array<vk::DescriptorBufferInfo, 3> bufferInfos =
+        {
+            vk::DescriptorBufferInfo{ instanceBuffers[i], 0, VK_WHOLE_SIZE },
+            vk::DescriptorBufferInfo{ drawCommandBuffers[i], 0, VK_WHOLE_SIZE },
+            vk::DescriptorBufferInfo{ drawCountBuffers[i], 0, VK_WHOLE_SIZE }
+        };
+
+        std::array<vk::WriteDescriptorSet, 3> descriptorWrites;
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+        {
+            descriptorWrites[binding].setDstSet(cullingDescriptorSets[i])
+                .setDstBinding(binding)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setBufferInfo(bufferInfos[binding]);
+        }
+
+        logicalDevice->updateDescriptorSets(descriptorWrites, nullptr);
+    }
+}
+
+void GpuCulling::createPipeline(vk::Device* logicalDevice, const std::vector<char>& shaderCode)
+{
+    vk::ShaderModuleCreateInfo moduleInfo = vk::ShaderModuleCreateInfo()
+        .setCodeSize(shaderCode.size())
+        .setPCode(reinterpret_cast<const uint32_t*>(shaderCode.data()));
+    vk::ShaderModule shaderModule = logicalDevice->createShaderModule(moduleInfo);
+
+    vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingConstants) };
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
+        .setSetLayoutCount(1)
+        .setPSetLayouts(&cullingDescriptorSetLayout)
+        .setPushConstantRangeCount(1)
+        .setPPushConstantRanges(&pushConstantRange);
+
+    if (logicalDevice->createPipelineLayout(&pipelineLayoutInfo, nullptr, &cullingPipelineLayout) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to create culling pipeline layout!");
+    }
+
+    vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
+        .setStage
+        (
+            vk::PipelineShaderStageCreateInfo()
+                .setStage(vk::ShaderStageFlagBits::eCompute)
+                .setModule(shaderModule)
+                .setPName("main")
+        )
+        .setLayout(cullingPipelineLayout);
+
+    vk::Result result;
+    std::tie(result, cullingPipeline) = logicalDevice->createComputePipeline(nullptr, pipelineInfo);
+    if (result != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to create culling pipeline!");
+    }
+
+    logicalDevice->destroyShaderModule(shaderModule);
+}
+
+bool GpuCulling::isEnabled() const
+{
+    return this->enabled;
+}
+
+void GpuCulling::setInstance(uint32_t instanceIndex, const Bounds& bounds, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset)
+{
+    InstanceData instance;
+    instance.model = glm::mat4(1.0f);
+    instance.boundsCenterRadius = glm::vec4(bounds.center, bounds.radius);
+    instance.boundsExtents = glm::vec4(bounds.extents, 0.0f);
+    instance.indexCount = indexCount;
+    instance.firstIndex = firstIndex;
+    instance.vertexOffset = vertexOffset;
+    instance.padding = 0;
+
+    for (InstanceData* mapped : instanceBuffersMapped)
+    {
+        mapped[instanceIndex] = instance;
+    }
+}
+
+void GpuCulling::setInstanceTransform(uint32_t frameIndex, uint32_t instanceIndex, const glm::mat4& model)
+{
+    instanceBuffersMapped[frameIndex][instanceIndex].model = model;
+}
+
+void GpuCulling::recordCulling(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection)
+{
+    // The frame's fence has signaled, so the counters its previous submission copied back are complete.
+    if (this->countersPending[frameIndex])
+    {
+        this->visibleDrawCount = counterReadbackMapped[frameIndex]->drawCount;
+        this->visibleTriangleCount = counterReadbackMapped[frameIndex]->triangleCount;
+    }
+
+    CullingConstants constants;
+    FrustumCulling::extractPlanes(viewProjection, constants.planes);
+    constants.instanceCount = this->instanceCount;
+    constants.compact = this->compact ? 1 : 0;
+
+    // The counters are accumulated in both modes, so they are always cleared.
+    commandBuffer.fillBuffer(drawCountBuffers[frameIndex], 0, sizeof(CullingCounters), 0);
+
+    vk::BufferMemoryBarrier clearBarrier = vk::BufferMemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setBuffer(drawCountBuffers[frameIndex])
+        .setOffset(0)
+        .setSize(VK_WHOLE_SIZE);
+
+    commandBuffer.pipelineBarrier
+    (
+        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+        {}, 0, nullptr, 1, &clearBarrier, 0, nullptr
+    );
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullingPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullingPipelineLayout, 0, 1, &cullingDescriptorSets[frameIndex], 0, nullptr);
+    commandBuffer.pushConstants(cullingPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingConstants), &constants);
+    commandBuffer.dispatch((this->instanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+    this->recordCounterReadback(commandBuffer, frameIndex);
+}
+
+void GpuCulling::recordCounterReadback(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+{
+    // A transfer read doesn't conflict with the later indirect read, so the render graph's barrier
+    // from the culling pass to the main pass still covers the draw count.
+    vk::BufferMemoryBarrier countersBarrier = vk::BufferMemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setBuffer(drawCountBuffers[frameIndex])
+        .setOffset(0)
+        .setSize(VK_WHOLE_SIZE);
+
+    commandBuffer.pipelineBarrier
+    (
+        vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+        {}, 0, nullptr, 1, &countersBarrier, 0, nullptr
+    );
+
+    vk::BufferCopy copyRegion{ 0, 0, sizeof(CullingCounters) };
+    commandBuffer.copyBuffer(drawCountBuffers[frameIndex], counterReadbackBuffers[frameIndex], 1, &copyRegion);
+
+    vk::BufferMemoryBarrier hostBarrier = vk::BufferMemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setBuffer(counterReadbackBuffers[frameIndex])
+        .setOffset(0)
+        .setSize(VK_WHOLE_SIZE);
+
+    commandBuffer.pipelineBarrier
+    (
+        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+        {}, 0, nullptr, 1, &hostBarrier, 0, nullptr
+    );
+
+    this->countersPending[frameIndex] = true;
+}
+
+void GpuCulling::recordDraws(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+{
+    uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+    if (this->compact)
+    {
+        commandBuffer.drawIndexedIndirectCount(drawCommandBuffers[frameIndex], 0, drawCountBuffers[frameIndex], 0, this->instanceCount, stride);
+    }
+    else if (this->multiDraw)
+    {
+        commandBuffer.drawIndexedIndirect(drawCommandBuffers[frameIndex], 0, this->instanceCount, stride);
+    }
+    else
+    {
+        // Without multiDrawIndirect each command needs its own call; culled ones have instanceCount 0.
+        for (uint32_t i = 0; i < this->instanceCount; i++)
+        {
+            commandBuffer.drawIndexedIndirect(drawCommandBuffers[frameIndex], static_cast<vk::DeviceSize>(i) * stride, 1, stride);
+        }
+    }
+}
+
+const vk::Buffer& GpuCulling::getDrawCommandBuffer(uint32_t frameIndex) const
+{
+    return drawCommandBuffers[frameIndex];
+}
+
+const vk::Buffer& GpuCulling::getDrawCountBuffer(uint32_t frameIndex) const
+{
+    return drawCountBuffers[frameIndex];
+}
+
+void GpuCulling::release(vk::Device* logicalDevice)
+{
+    if (!this->enabled)
+    {
+        return;
+    }
+
+    logicalDevice->destroyPipeline(cullingPipeline);
+    logicalDevice->destroyPipelineLayout(cullingPipelineLayout);
+    logicalDevice->destroyDescriptorPool(cullingDescriptorPool);
+    logicalDevice->destroyDescriptorSetLayout(cullingDescriptorSetLayout);
+
+    for (size_t i = 0; i < this->maxFramesInFlight; i++)
+    {
+        logicalDevice->destroyBuffer(instanceBuffers[i]);
+        logicalDevice->freeMemory(instanceBuffersMemory[i]);
+        logicalDevice->destroyBuffer(drawCommandBuffers[i]);
+        logicalDevice->freeMemory(drawCommandBuffersMemory[i]);
+        logicalDevice->destroyBuffer(drawCountBuffers[i]);
+        logicalDevice->freeMemory(drawCountBuffersMemory[i]);
+        logicalDevice->destroyBuffer(counterReadbackBuffers[i]);
+        logicalDevice->freeMemory(counterReadbackBuffersMemory[i]);
+    }
+
+    this->countersPending.clear();
+    this->visibleDrawCount = 0;
+    this->visibleTriangleCount = 0;
+    this->enabled = false;
+}
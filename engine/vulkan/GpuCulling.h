@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Model.h"
+#include "vk_forward_declarations.h"
+
+#include <vector>
+
+class Devices;
+class CommandBuffers;
+
+class GpuCulling
+{
+private:
+	bool enabled = false;
+	bool compact = false;
+	bool multiDraw = false;
+	uint32_t instanceCount = 0;
+	int maxFramesInFlight = 0;
+	// Visible draws and triangles as counted by the culling shader; they lag by the frames in flight.
+	uint32_t visibleDrawCount = 0;
+	uint64_t visibleTriangleCount = 0;
+	std::vector<bool> countersPending;
+
+private:
+	void init(Devices& devices, CommandBuffers& commandBuffers, int maxFramesInFlight, uint32_t instanceCount);
+	void createBuffers(Devices& devices, CommandBuffers& commandBuffers);
+	void createDescriptorSets(vk::Device* logicalDevice);
+	void createPipeline(vk::Device* logicalDevice, const std::vector<char>& shaderCode);
+	bool isEnabled() const;
+	void setInstance(uint32_t instanceIndex, const Bounds& bounds, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset);
+	void setInstanceTransform(uint32_t frameIndex, uint32_t instanceIndex, const glm::mat4& model);
+	void recordCulling(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection);
+	void recordCounterReadback(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+	void recordDraws(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+	const vk::Buffer& getDrawCommandBuffer(uint32_t frameIndex) const;
+	const vk::Buffer& getDrawCountBuffer(uint32_t frameIndex) const;
+	void release(vk::Device* logicalDevice);
+
+friend class CommandBuffers;
+friend class VulkanAPI;
+};
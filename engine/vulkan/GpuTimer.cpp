@@ -0,0 +1,94 @@
+#include "GpuTimer.h"
+#include "Devices.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+
+vk::QueryPool timestampQueryPool;
+
+void GpuTimer::init(Devices& devices, int maxFramesInFlight)
+{
+    vk::PhysicalDevice* physicalDevice = devices.getPhysicalDevice();
+    vk::PhysicalDeviceProperties properties = physicalDevice->getProperties();
+    std::vector<vk::QueueFamilyProperties> queueFamilies = physicalDevice->getQueueFamilyProperties();
+    uint32_t validBits = queueFamilies[devices.familyIndices.graphicsFamily.value()].timestampValidBits;
+
+    this->enabled = (validBits > 0) && (properties.limits.timestampPeriod > 0.0f);
+    this->pendingFrames.assign(maxFramesInFlight, 0);
+    if (!this->enabled)
+    {
+        return;
+    }
+
+    this->timestampPeriodNs = properties.limits.timestampPeriod;
+    this->timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+    vk::QueryPoolCreateInfo queryPoolInfo = vk::QueryPoolCreateInfo()
+        .setQueryType(vk::QueryType::eTimestamp)
+        .setQueryCount(static_cast<uint32_t>(maxFramesInFlight) * 2);
+
+    timestampQueryPool = devices.getDevice()->createQueryPool(queryPoolInfo);
+}
+
+bool GpuTimer::isEnabled() const
+{
+    return this->enabled;
+}
+
+void GpuTimer::writeBegin(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint64_t frameNumber)
+{
+    if (!this->enabled)
+    {
+        return;
+    }
+
+    // Has to be recorded outside a render pass, so it goes first in the frame.
+    commandBuffer.resetQueryPool(timestampQueryPool, frameIndex * 2, 2);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampQueryPool, frameIndex * 2);
+    this->pendingFrames[frameIndex] = frameNumber;
+}
+
+void GpuTimer::writeEnd(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex)
+{
+    if (this->enabled)
+    {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampQueryPool, (frameIndex * 2) + 1);
+    }
+}
+
+bool GpuTimer::readFrame(vk::Device* logicalDevice, uint32_t frameIndex, uint64_t& frameNumber, double& gpuTimeMs)
+{
+    if (!this->enabled || (this->pendingFrames[frameIndex] == 0))
+    {
+        return false;
+    }
+
+    std::array<uint64_t, 2> timestamps = {};
+    vk::Result result = logicalDevice->getQueryPoolResults(timestampQueryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps.data(),
+        sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+    frameNumber = this->pendingFrames[frameIndex];
+    this->pendingFrames[frameIndex] = 0;
+    if (result != vk::Result::eSuccess)
+    {
+        return false;
+    }
+
+    uint64_t ticks = (timestamps[1] - timestamps[0]) & this->timestampMask;
+    gpuTimeMs = (ticks * this->timestampPeriodNs) / 1000000.0;
+
+    return true;
+}
+
+void GpuTimer::release(vk::Device* logicalDevice)
+{
+    if (this->enabled)
+    {
+        logicalDevice->destroyQueryPool(timestampQueryPool);
+        timestampQueryPool = nullptr;
+    }
+
+    this->enabled = false;
+    this->pendingFrames.clear();
+}
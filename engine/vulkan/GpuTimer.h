@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+#include <vector>
+
+class Devices;
+
+/*
+* Measures how long the GPU spends on each frame with a pair of timestamp queries around the
+* frame's primary command buffer. Results are read back once the frame's fence has signaled, so
+* reading never stalls. Disabled on queues without timestamp support.
+*/
+class GpuTimer
+{
+private:
+	bool enabled = false;
+	double timestampPeriodNs = 1.0;
+	uint64_t timestampMask = ~0ull;
+	// Frame number each slot was last written for, or 0 while it holds no pending result.
+	std::vector<uint64_t> pendingFrames;
+
+private:
+	void init(Devices& devices, int maxFramesInFlight);
+	bool isEnabled() const;
+	void writeBegin(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex, uint64_t frameNumber);
+	void writeEnd(const vk::CommandBuffer& commandBuffer, uint32_t frameIndex);
+	bool readFrame(vk::Device* logicalDevice, uint32_t frameIndex, uint64_t& frameNumber, double& gpuTimeMs);
+	void release(vk::Device* logicalDevice);
+
+friend class CommandBuffers;
+friend class VulkanAPI;
+};
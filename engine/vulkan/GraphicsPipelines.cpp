@@ -0,0 +1,1027 @@
+#include "GraphicsPipelines.h"
+#include "Devices.h"
+#include "RenderPass.h"
+#include "SyncObjects.h"
+#include "Vertex.h"
+#include "engine/Profiler.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+vk::PipelineLayout libraryPipelineLayout;
+vk::RenderPass libraryRenderPass;
+vk::PipelineRenderingCreateInfo libraryRenderingInfo;
+bool libraryDynamicRendering = false;
+
+// The vertex input interface fixes the topology class, so there is one library per class.
+const uint32_t TOPOLOGY_CLASS_COUNT = 3;
+const std::array<Topology, TOPOLOGY_CLASS_COUNT> TOPOLOGY_CLASSES = { Topology::PointList, Topology::LineList, Topology::TriangleList };
+std::array<vk::Pipeline, TOPOLOGY_CLASS_COUNT> vertexInputLibraries;
+std::array<vk::Pipeline, BLEND_MODE_COUNT> fragmentOutputLibraries;
+// Shader modules stay alive so new variants can be specialized from them at any time.
+std::vector<vk::ShaderModule> shaderModules;
+std::vector<bool> shaderVertexStages;
+
+struct ShaderPartData
+{
+    uint32_t shader;
+    ShaderSpecialization specialization;
+};
+
+std::vector<ShaderPartData> partData;
+std::vector<vk::Pipeline> partLibraries;
+
+// Null until a background build finishes; bind() falls back to the fallback pipeline meanwhile.
+std::vector<vk::Pipeline> linkedPipelines;
+
+struct CompletedPipeline
+{
+    uint32_t index;
+    vk::Pipeline pipeline;
+    double buildTimeMs;
+    bool optimized;
+    bool failed;
+};
+
+std::vector<CompletedPipeline> completedPipelines;
+
+const std::array<vk::DynamicState, 8> DYNAMIC_STATES =
+{
+    vk::DynamicState::eViewport,
+    vk::DynamicState::eScissor,
+    vk::DynamicState::eCullMode,
+    vk::DynamicState::eFrontFace,
+    vk::DynamicState::ePrimitiveTopology,
+    vk::DynamicState::eDepthTestEnable,
+    vk::DynamicState::eDepthWriteEnable,
+    vk::DynamicState::eDepthCompareOp
+};
+
+// Only viewport and scissor are dynamic without extended dynamic state.
+const uint32_t BASE_DYNAMIC_STATE_COUNT = 2;
+
+vk::CullModeFlags getCullMode(CullMode cullMode)
+{
+    switch (cullMode)
+    {
+    case CullMode::Front: return vk::CullModeFlagBits::eFront;
+    case CullMode::Back: return vk::CullModeFlagBits::eBack;
+    default: return vk::CullModeFlagBits::eNone;
+    }
+}
+
+vk::FrontFace getFrontFace(FrontFace frontFace)
+{
+    return (frontFace == FrontFace::Clockwise) ? vk::FrontFace::eClockwise : vk::FrontFace::eCounterClockwise;
+}
+
+vk::PrimitiveTopology getTopology(Topology topology)
+{
+    switch (topology)
+    {
+    case Topology::PointList: return vk::PrimitiveTopology::ePointList;
+    case Topology::LineList: return vk::PrimitiveTopology::eLineList;
+    case Topology::LineStrip: return vk::PrimitiveTopology::eLineStrip;
+    case Topology::TriangleStrip: return vk::PrimitiveTopology::eTriangleStrip;
+    default: return vk::PrimitiveTopology::eTriangleList;
+    }
+}
+
+vk::CompareOp getCompareOp(CompareOp compareOp)
+{
+    switch (compareOp)
+    {
+    case CompareOp::Never: return vk::CompareOp::eNever;
+    case CompareOp::Equal: return vk::CompareOp::eEqual;
+    case CompareOp::LessOrEqual: return vk::CompareOp::eLessOrEqual;
+    case CompareOp::Greater: return vk::CompareOp::eGreater;
+    case CompareOp::GreaterOrEqual: return vk::CompareOp::eGreaterOrEqual;
+    case CompareOp::Always: return vk::CompareOp::eAlways;
+    default: return vk::CompareOp::eLess;
+    }
+}
+
+vk::BlendFactor getDstColorBlendFactor(BlendMode blendMode)
+{
+    switch (blendMode)
+    {
+    case BlendMode::AlphaBlend: return vk::BlendFactor::eOneMinusSrcAlpha;
+    case BlendMode::Additive: return vk::BlendFactor::eOne;
+    default: return vk::BlendFactor::eZero;
+    }
+}
+
+// Dynamic topology must stay within the topology class the pipeline was built with.
+Topology getTopologyClass(Topology topology)
+{
+    switch (topology)
+    {
+    case Topology::PointList: return Topology::PointList;
+    case Topology::LineList:
+    case Topology::LineStrip: return Topology::LineList;
+    default: return Topology::TriangleList;
+    }
+}
+
+uint32_t getTopologyClassIndex(Topology topology)
+{
+    Topology topologyClass = getTopologyClass(topology);
+    for (uint32_t i = 0; i < TOPOLOGY_CLASS_COUNT; i++)
+    {
+        if (TOPOLOGY_CLASSES[i] == topologyClass)
+        {
+            return i;
+        }
+    }
+
+    return TOPOLOGY_CLASS_COUNT - 1;
+}
+
+// FNV-1a, fed one 32-bit field at a time.
+const size_t FNV_OFFSET_BASIS = 2166136261u;
+const size_t FNV_PRIME = 16777619u;
+
+void hashCombine(size_t& hash, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= FNV_PRIME;
+    }
+}
+
+bool RasterState::operator==(const RasterState& other) const
+{
+    return (this->cullMode == other.cullMode) && (this->frontFace == other.frontFace) && (this->topology == other.topology) &&
+        (this->depthTest == other.depthTest) && (this->depthWrite == other.depthWrite) && (this->depthCompare == other.depthCompare);
+}
+
+bool PipelineKey::operator==(const PipelineKey& other) const
+{
+    return (this->vertexPart == other.vertexPart) && (this->fragmentPart == other.fragmentPart) &&
+        (this->vertexLayout == other.vertexLayout) && (this->rasterState == other.rasterState) && (this->blendMode == other.blendMode) &&
+        (this->colorFormat == other.colorFormat) && (this->depthFormat == other.depthFormat);
+}
+
+size_t PipelineKey::hash() const
+{
+    size_t result = FNV_OFFSET_BASIS;
+    hashCombine(result, this->vertexPart);
+    hashCombine(result, this->fragmentPart);
+    hashCombine(result, this->vertexLayout);
+    hashCombine(result, static_cast<uint32_t>(this->rasterState.cullMode) | (static_cast<uint32_t>(this->rasterState.frontFace) << 8) |
+        (static_cast<uint32_t>(this->rasterState.topology) << 16) | (static_cast<uint32_t>(this->rasterState.depthCompare) << 24));
+    hashCombine(result, (this->rasterState.depthTest ? 1u : 0u) | (this->rasterState.depthWrite ? 2u : 0u) |
+        (static_cast<uint32_t>(this->blendMode) << 8));
+    hashCombine(result, this->colorFormat);
+    hashCombine(result, this->depthFormat);
+
+    return result;
+}
+
+bool SpecializationConstant::operator==(const SpecializationConstant& other) const
+{
+    return (this->id == other.id) && (this->value == other.value);
+}
+
+void ShaderSpecialization::setBool(uint32_t id, bool value)
+{
+    this->setValue(id, value ? VK_TRUE : VK_FALSE);
+}
+
+void ShaderSpecialization::setFloat(uint32_t id, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    this->setValue(id, bits);
+}
+
+void ShaderSpecialization::setValue(uint32_t id, uint32_t value)
+{
+    // Kept sorted by id so equal specializations compare and hash equal regardless of set order.
+    auto position = std::lower_bound(this->constants.begin(), this->constants.end(), id,
+        [](const SpecializationConstant& constant, uint32_t id) { return constant.id < id; });
+
+    if ((position != this->constants.end()) && (position->id == id))
+    {
+        position->value = value;
+    }
+    else
+    {
+        this->constants.insert(position, { id, value });
+    }
+}
+
+bool ShaderSpecialization::operator==(const ShaderSpecialization& other) const
+{
+    return this->constants == other.constants;
+}
+
+size_t ShaderSpecialization::hash() const
+{
+    size_t result = FNV_OFFSET_BASIS;
+    for (const SpecializationConstant& constant : this->constants)
+    {
+        hashCombine(result, constant.id);
+        hashCombine(result, constant.value);
+    }
+
+    return result;
+}
+
+ShaderSpecialization ShaderSpecialization::fromFeatures(ShaderFeatureMask features, float alphaCutoff)
+{
+    ShaderSpecialization result;
+    for (ShaderFeature feature : { ShaderFeature::Texturing, ShaderFeature::VertexColor, ShaderFeature::AlphaTest, ShaderFeature::PrecomputedMvp })
+    {
+        result.setBool(static_cast<uint32_t>(feature), (features & getFeatureBit(feature)) != 0);
+    }
+
+    if ((features & getFeatureBit(ShaderFeature::AlphaTest)) != 0)
+    {
+        result.setFloat(static_cast<uint32_t>(ShaderFeature::AlphaCutoff), alphaCutoff);
+    }
+
+    return result;
+}
+
+bool ShaderPartKey::operator==(const ShaderPartKey& other) const
+{
+    return (this->shader == other.shader) && (this->specialization == other.specialization);
+}
+
+size_t ShaderPartKeyHash::operator()(const ShaderPartKey& key) const
+{
+    size_t result = key.specialization.hash();
+    hashCombine(result, key.shader);
+
+    return result;
+}
+
+// Anything that changes how vertex data is fetched has to change this hash.
+uint32_t getVertexLayoutHash()
+{
+    vk::VertexInputBindingDescription binding = Vertex::getBindingDescription();
+    size_t hash = FNV_OFFSET_BASIS;
+    hashCombine(hash, binding.binding);
+    hashCombine(hash, binding.stride);
+    hashCombine(hash, static_cast<uint32_t>(binding.inputRate));
+
+    for (const vk::VertexInputAttributeDescription& attribute : Vertex::getAttributeDescriptions())
+    {
+        hashCombine(hash, attribute.location);
+        hashCombine(hash, attribute.binding);
+        hashCombine(hash, static_cast<uint32_t>(attribute.format));
+        hashCombine(hash, attribute.offset);
+    }
+
+    return static_cast<uint32_t>(hash);
+}
+
+// Fixed-function state for one pipeline, whether linked from libraries or built in one go.
+// The create infos point into the struct itself, so it is never copied.
+struct FixedFunctionState
+{
+    vk::VertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
+    std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
+    vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+    vk::PipelineVertexInputStateCreateInfo vertexInput;
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly;
+    vk::PipelineViewportStateCreateInfo viewport;
+    vk::PipelineRasterizationStateCreateInfo rasterization;
+    vk::PipelineMultisampleStateCreateInfo multisample;
+    vk::PipelineDepthStencilStateCreateInfo depthStencil;
+    vk::PipelineColorBlendStateCreateInfo colorBlend;
+    vk::PipelineDynamicStateCreateInfo dynamic;
+
+    FixedFunctionState(const RasterState& rasterState, BlendMode blendMode, bool dynamicRasterState)
+    {
+        this->vertexInput = vk::PipelineVertexInputStateCreateInfo()
+            .setVertexBindingDescriptions(this->bindingDescription)
+            .setVertexAttributeDescriptions(this->attributeDescriptions);
+
+        this->inputAssembly = vk::PipelineInputAssemblyStateCreateInfo()
+            .setTopology(getTopology(rasterState.topology))
+            .setPrimitiveRestartEnable(vk::False);
+
+        this->viewport = vk::PipelineViewportStateCreateInfo()
+            .setViewportCount(1)
+            .setScissorCount(1);
+
+        this->rasterization = vk::PipelineRasterizationStateCreateInfo()
+            .setDepthClampEnable(vk::False)
+            .setRasterizerDiscardEnable(vk::False)
+            .setPolygonMode(vk::PolygonMode::eFill)
+            .setLineWidth(1.0f)
+            .setCullMode(getCullMode(rasterState.cullMode))
+            .setFrontFace(getFrontFace(rasterState.frontFace))
+            .setDepthBiasEnable(vk::False)
+            .setDepthBiasConstantFactor(0.0f)
+            .setDepthBiasClamp(0.0f)
+            .setDepthBiasSlopeFactor(0.0f);
+
+        this->multisample = vk::PipelineMultisampleStateCreateInfo()
+            .setSampleShadingEnable(vk::False)
+            .setRasterizationSamples(vk::SampleCountFlagBits::e1)
+            .setMinSampleShading(1.0f)
+            .setPSampleMask(nullptr)
+            .setAlphaToCoverageEnable(vk::False)
+            .setAlphaToOneEnable(vk::False);
+
+        this->depthStencil = vk::PipelineDepthStencilStateCreateInfo()
+            .setDepthTestEnable(rasterState.depthTest)
+            .setDepthWriteEnable(rasterState.depthWrite)
+            .setDepthCompareOp(getCompareOp(rasterState.depthCompare))
+            .setDepthBoundsTestEnable(vk::False)
+            .setMinDepthBounds(0.0f)
+            .setMaxDepthBounds(1.0f)
+            .setStencilTestEnable(vk::False);
+
+        this->colorBlendAttachment = vk::PipelineColorBlendAttachmentState()
+            .setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
+            .setBlendEnable(blendMode != BlendMode::Opaque)
+            .setSrcColorBlendFactor((blendMode == BlendMode::Opaque) ? vk::BlendFactor::eOne : vk::BlendFactor::eSrcAlpha)
+            .setDstColorBlendFactor(getDstColorBlendFactor(blendMode))
+            .setColorBlendOp(vk::BlendOp::eAdd)
+            .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+            .setDstAlphaBlendFactor((blendMode == BlendMode::AlphaBlend) ? vk::BlendFactor::eOneMinusSrcAlpha : vk::BlendFactor::eZero)
+            .setAlphaBlendOp(vk::BlendOp::eAdd);
+
+        this->colorBlend = vk::PipelineColorBlendStateCreateInfo()
+            .setLogicOpEnable(vk::False)
+            .setLogicOp(vk::LogicOp::eCopy)
+            .setAttachments(this->colorBlendAttachment)
+            .setBlendConstants(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 0.0f });
+
+        this->dynamic = vk::PipelineDynamicStateCreateInfo()
+            .setDynamicStateCount(dynamicRasterState ? static_cast<uint32_t>(DYNAMIC_STATES.size()) : BASE_DYNAMIC_STATE_COUNT)
+            .setPDynamicStates(DYNAMIC_STATES.data());
+    }
+
+    FixedFunctionState(const FixedFunctionState&) = delete;
+    FixedFunctionState& operator=(const FixedFunctionState&) = delete;
+};
+
+// The specialization info points into the struct itself, so it is never copied.
+struct SpecializationState
+{
+    std::vector<vk::SpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+    vk::SpecializationInfo info;
+
+    SpecializationState(const ShaderSpecialization& specialization)
+    {
+        for (const SpecializationConstant& constant : specialization.constants)
+        {
+            this->entries.push_back(vk::SpecializationMapEntry(constant.id, static_cast<uint32_t>(this->data.size() * sizeof(uint32_t)), sizeof(uint32_t)));
+            this->data.push_back(constant.value);
+        }
+
+        this->info = vk::SpecializationInfo()
+            .setMapEntries(this->entries)
+            .setDataSize(this->data.size() * sizeof(uint32_t))
+            .setPData(this->data.data());
+    }
+
+    const vk::SpecializationInfo* get() const
+    {
+        return this->entries.empty() ? nullptr : &this->info;
+    }
+
+    SpecializationState(const SpecializationState&) = delete;
+    SpecializationState& operator=(const SpecializationState&) = delete;
+};
+
+vk::PipelineShaderStageCreateInfo createStageInfo(const vk::ShaderModule& module, bool vertexStage, const SpecializationState& specialization)
+{
+    return vk::PipelineShaderStageCreateInfo()
+        .setStage(vertexStage ? vk::ShaderStageFlagBits::eVertex : vk::ShaderStageFlagBits::eFragment)
+        .setModule(module)
+        .setPName("main")
+        .setPSpecializationInfo(specialization.get());
+}
+
+vk::Pipeline createPipeline(vk::Device* logicalDevice, const vk::GraphicsPipelineCreateInfo& pipelineInfo)
+{
+    vk::Result result;
+    vk::Pipeline pipeline;
+    std::tie(result, pipeline) = logicalDevice->createGraphicsPipeline(nullptr, pipelineInfo);
+    if (result != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to create graphics pipeline!");
+    }
+
+    return pipeline;
+}
+
+// Builds one of the four library parts; libraryInfo selects which state the part owns.
+vk::Pipeline createLibraryPart(vk::Device* logicalDevice, vk::GraphicsPipelineLibraryFlagsEXT parts, vk::GraphicsPipelineCreateInfo& pipelineInfo)
+{
+    vk::GraphicsPipelineLibraryCreateInfoEXT libraryInfo = vk::GraphicsPipelineLibraryCreateInfoEXT()
+        .setFlags(parts);
+
+    if (libraryDynamicRendering)
+    {
+        libraryInfo.setPNext(&libraryRenderingInfo);
+    }
+
+    pipelineInfo
+        .setPNext(&libraryInfo)
+        .setFlags(vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT)
+        .setRenderPass(libraryRenderPass)
+        .setSubpass(0);
+
+    return createPipeline(logicalDevice, pipelineInfo);
+}
+
+vk::Pipeline createMonolithicPipeline(vk::Device* logicalDevice, const PipelineKey& key, const vk::ShaderModule& vertexModule,
+    const ShaderSpecialization& vertexSpecialization, const vk::ShaderModule& fragmentModule, const ShaderSpecialization& fragmentSpecialization,
+    bool dynamicRasterState)
+{
+    FixedFunctionState state(key.rasterState, key.blendMode, dynamicRasterState);
+    SpecializationState vertexState(vertexSpecialization);
+    SpecializationState fragmentState(fragmentSpecialization);
+    std::array<vk::PipelineShaderStageCreateInfo, 2> stages =
+    {
+        createStageInfo(vertexModule, true, vertexState),
+        createStageInfo(fragmentModule, false, fragmentState)
+    };
+
+    vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo()
+        .setStages(stages)
+        .setPVertexInputState(&state.vertexInput)
+        .setPInputAssemblyState(&state.inputAssembly)
+        .setPViewportState(&state.viewport)
+        .setPRasterizationState(&state.rasterization)
+        .setPMultisampleState(&state.multisample)
+        .setPDepthStencilState(&state.depthStencil)
+        .setPColorBlendState(&state.colorBlend)
+        .setPDynamicState(&state.dynamic)
+        .setLayout(libraryPipelineLayout)
+        .setRenderPass(libraryRenderPass)
+        .setSubpass(0)
+        .setBasePipelineHandle(nullptr)
+        .setBasePipelineIndex(-1);
+
+    // With dynamic rendering the pipeline only needs the attachment formats, not a render pass object.
+    if (libraryDynamicRendering)
+    {
+        pipelineInfo.setPNext(&libraryRenderingInfo);
+    }
+
+    return createPipeline(logicalDevice, pipelineInfo);
+}
+
+vk::Pipeline linkLibraries(vk::Device* logicalDevice, const std::array<vk::Pipeline, 4>& libraries, bool optimize)
+{
+    vk::PipelineLibraryCreateInfoKHR linkInfo = vk::PipelineLibraryCreateInfoKHR()
+        .setLibraries(libraries);
+
+    vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo()
+        .setPNext(&linkInfo)
+        .setLayout(libraryPipelineLayout);
+
+    if (optimize)
+    {
+        pipelineInfo.setFlags(vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT);
+    }
+
+    return createPipeline(logicalDevice, pipelineInfo);
+}
+
+void GraphicsPipelines::init(Devices& devices, RenderPass& renderPass, const vk::PipelineLayout& pipelineLayout, SyncObjects* syncObjects)
+{
+    this->logicalDevice = devices.getDevice();
+    this->syncObjects = syncObjects;
+    this->dynamicRasterState = devices.getCapabilities().extendedDynamicState;
+    this->libraryEnabled = devices.getCapabilities().graphicsPipelineLibrary && this->dynamicRasterState;
+
+    libraryPipelineLayout = pipelineLayout;
+    libraryRenderPass = renderPass.getRenderPassRef();
+    libraryRenderingInfo = renderPass.getPipelineRenderingInfo();
+    libraryDynamicRendering = renderPass.isDynamicRendering();
+
+    this->vertexLayoutHash = getVertexLayoutHash();
+    this->colorFormat = static_cast<uint32_t>(renderPass.colorFormat);
+    this->depthFormat = static_cast<uint32_t>(renderPass.depthFormat);
+
+    if (this->libraryEnabled)
+    {
+        this->createInterfaceLibraries();
+    }
+
+    this->backgroundStopping = false;
+    this->backgroundThread = std::thread([this]() { this->backgroundLoop(); });
+}
+
+void GraphicsPipelines::createInterfaceLibraries()
+{
+    for (uint32_t i = 0; i < TOPOLOGY_CLASS_COUNT; i++)
+    {
+        RasterState rasterState;
+        rasterState.topology = TOPOLOGY_CLASSES[i];
+        FixedFunctionState state(rasterState, BlendMode::Opaque, true);
+
+        vk::GraphicsPipelineCreateInfo vertexInputInfo = vk::GraphicsPipelineCreateInfo()
+            .setPVertexInputState(&state.vertexInput)
+            .setPInputAssemblyState(&state.inputAssembly)
+            .setPDynamicState(&state.dynamic);
+
+        vertexInputLibraries[i] = createLibraryPart(this->logicalDevice, vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+            vertexInputInfo);
+    }
+
+    // Blending lives in the output interface, so there is one output library per blend mode.
+    for (uint32_t i = 0; i < BLEND_MODE_COUNT; i++)
+    {
+        FixedFunctionState blendState(RasterState(), static_cast<BlendMode>(i), true);
+
+        vk::GraphicsPipelineCreateInfo fragmentOutputInfo = vk::GraphicsPipelineCreateInfo()
+            .setPColorBlendState(&blendState.colorBlend)
+            .setPMultisampleState(&blendState.multisample)
+            .setPDynamicState(&blendState.dynamic);
+
+        fragmentOutputLibraries[i] = createLibraryPart(this->logicalDevice, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface,
+            fragmentOutputInfo);
+    }
+}
+
+uint32_t GraphicsPipelines::createShader(const std::vector<char>& code, bool vertexStage)
+{
+    vk::ShaderModuleCreateInfo moduleInfo = vk::ShaderModuleCreateInfo()
+        .setCodeSize(code.size())
+        .setPCode(reinterpret_cast<const uint32_t*>(code.data()));
+
+    shaderModules.push_back(this->logicalDevice->createShaderModule(moduleInfo));
+    shaderVertexStages.push_back(vertexStage);
+
+    return static_cast<uint32_t>(shaderModules.size() - 1);
+}
+
+void GraphicsPipelines::releaseShader(uint32_t shader)
+{
+    // Workers may still be building from this module or its parts, and their results have to be in
+    // linkedPipelines before they can be retired.
+    this->finishBackgroundBuilds();
+
+    vk::Device* device = this->logicalDevice;
+    std::vector<uint32_t> releasedParts;
+    for (auto part = this->shaderParts.begin(); part != this->shaderParts.end();)
+    {
+        if (part->first.shader != shader)
+        {
+            ++part;
+            continue;
+        }
+
+        vk::Pipeline library = partLibraries[part->second];
+        if (library)
+        {
+            this->syncObjects->deferDestruction([device, library]() { device->destroyPipeline(library); });
+            partLibraries[part->second] = nullptr;
+        }
+
+        releasedParts.push_back(part->second);
+        part = this->shaderParts.erase(part);
+    }
+
+    // Slots stay in place, so indices held by callers keep pointing at the same (now empty) entries.
+    for (auto cached = this->pipelineCache.begin(); cached != this->pipelineCache.end();)
+    {
+        const PipelineKey& key = cached->first;
+        bool usesShader = std::find_if(releasedParts.begin(), releasedParts.end(),
+            [&key](uint32_t part) { return (part == key.vertexPart) || (part == key.fragmentPart); }) != releasedParts.end();
+        if (!usesShader)
+        {
+            ++cached;
+            continue;
+        }
+
+        vk::Pipeline pipeline = linkedPipelines[cached->second];
+        if (pipeline)
+        {
+            this->syncObjects->deferDestruction([device, pipeline]() { device->destroyPipeline(pipeline); });
+            linkedPipelines[cached->second] = nullptr;
+        }
+
+        cached = this->pipelineCache.erase(cached);
+    }
+
+    vk::ShaderModule module = shaderModules[shader];
+    this->syncObjects->deferDestruction([device, module]() { device->destroyShaderModule(module); });
+    shaderModules[shader] = nullptr;
+}
+
+uint32_t GraphicsPipelines::createShaderPart(uint32_t shader, const ShaderSpecialization& specialization)
+{
+    ShaderPartKey partKey;
+    partKey.shader = shader;
+    partKey.specialization = specialization;
+
+    auto cached = this->shaderParts.find(partKey);
+    if (cached != this->shaderParts.end())
+    {
+        return cached->second;
+    }
+
+    bool vertexStage = shaderVertexStages[shader];
+    vk::Pipeline library = nullptr;
+
+    if (this->libraryEnabled)
+    {
+        FixedFunctionState state(RasterState(), BlendMode::Opaque, true);
+        SpecializationState specializationState(specialization);
+        vk::PipelineShaderStageCreateInfo stageInfo = createStageInfo(shaderModules[shader], vertexStage, specializationState);
+
+        vk::GraphicsPipelineCreateInfo partInfo = vk::GraphicsPipelineCreateInfo()
+            .setStages(stageInfo)
+            .setPDynamicState(&state.dynamic)
+            .setLayout(libraryPipelineLayout);
+
+        if (vertexStage)
+        {
+            partInfo
+                .setPViewportState(&state.viewport)
+                .setPRasterizationState(&state.rasterization);
+
+            library = createLibraryPart(this->logicalDevice, vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, partInfo);
+        }
+        else
+        {
+            partInfo
+                .setPDepthStencilState(&state.depthStencil)
+                .setPMultisampleState(&state.multisample);
+
+            library = createLibraryPart(this->logicalDevice, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, partInfo);
+        }
+    }
+
+    partData.push_back({ shader, specialization });
+    partLibraries.push_back(library);
+
+    uint32_t index = static_cast<uint32_t>(partLibraries.size() - 1);
+    this->shaderParts.emplace(partKey, index);
+    this->stats.shaderVariantCount++;
+
+    return index;
+}
+
+uint32_t GraphicsPipelines::requestVariant(uint32_t vertexShader, uint32_t fragmentShader, ShaderFeatureMask features, const RasterState& rasterState,
+    BlendMode blendMode)
+{
+    // Both stages get the same constants; each ignores the ids it doesn't declare.
+    ShaderSpecialization specialization = ShaderSpecialization::fromFeatures(features);
+    uint32_t vertexPart = this->createShaderPart(vertexShader, specialization);
+    uint32_t fragmentPart = this->createShaderPart(fragmentShader, specialization);
+
+    return this->request(vertexPart, fragmentPart, rasterState, blendMode);
+}
+
+PipelineKey GraphicsPipelines::createKey(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode) const
+{
+    PipelineKey key;
+    key.vertexPart = vertexPart;
+    key.fragmentPart = fragmentPart;
+    key.vertexLayout = this->vertexLayoutHash;
+    key.blendMode = blendMode;
+    key.colorFormat = this->colorFormat;
+    key.depthFormat = this->depthFormat;
+
+    if (this->dynamicRasterState)
+    {
+        key.rasterState.topology = getTopologyClass(rasterState.topology);
+    }
+    else
+    {
+        key.rasterState = rasterState;
+    }
+
+    return key;
+}
+
+uint32_t GraphicsPipelines::addPipeline(const PipelineKey& key, const vk::Pipeline& pipeline)
+{
+    linkedPipelines.push_back(pipeline);
+    uint32_t index = static_cast<uint32_t>(linkedPipelines.size() - 1);
+    this->pipelineCache.emplace(key, index);
+
+    return index;
+}
+
+uint32_t GraphicsPipelines::link(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode)
+{
+    PipelineKey key = this->createKey(vertexPart, fragmentPart, rasterState, blendMode);
+    auto cached = this->pipelineCache.find(key);
+    if (cached != this->pipelineCache.end())
+    {
+        return cached->second;
+    }
+
+    PROFILE_ZONE("LinkPipeline");
+    auto startTime = std::chrono::high_resolution_clock::now();
+    vk::Pipeline pipeline;
+
+    if (this->libraryEnabled)
+    {
+        pipeline = linkLibraries(this->logicalDevice, this->getLibraries(key), false);
+    }
+    else
+    {
+        const ShaderPartData& vertexData = partData[vertexPart];
+        const ShaderPartData& fragmentData = partData[fragmentPart];
+        pipeline = createMonolithicPipeline(this->logicalDevice, key, shaderModules[vertexData.shader], vertexData.specialization,
+            shaderModules[fragmentData.shader], fragmentData.specialization, this->dynamicRasterState);
+    }
+
+    uint32_t index = this->addPipeline(key, pipeline);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    this->stats.fastLinkCount++;
+    this->stats.lastFastLinkMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+    if (this->libraryEnabled)
+    {
+        this->buildInBackground(index, key, true);
+    }
+
+    return index;
+}
+
+uint32_t GraphicsPipelines::request(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode)
+{
+    PipelineKey key = this->createKey(vertexPart, fragmentPart, rasterState, blendMode);
+    auto cached = this->pipelineCache.find(key);
+    if (cached != this->pipelineCache.end())
+    {
+        this->stats.cacheHits++;
+        return cached->second;
+    }
+
+    this->stats.cacheMisses++;
+
+    // A library link is cheap enough to do right away; a monolithic build is not.
+    if (this->libraryEnabled)
+    {
+        return this->link(vertexPart, fragmentPart, rasterState, blendMode);
+    }
+
+    uint32_t index = this->addPipeline(key, nullptr);
+    this->buildInBackground(index, key, false);
+
+    return index;
+}
+
+std::array<vk::Pipeline, 4> GraphicsPipelines::getLibraries(const PipelineKey& key) const
+{
+    return
+    {
+        vertexInputLibraries[getTopologyClassIndex(key.rasterState.topology)],
+        partLibraries[key.vertexPart],
+        partLibraries[key.fragmentPart],
+        fragmentOutputLibraries[static_cast<uint32_t>(key.blendMode)]
+    };
+}
+
+void GraphicsPipelines::buildInBackground(uint32_t index, const PipelineKey& key, bool optimize)
+{
+    // Handles are copied now; the part vectors may grow while the worker runs.
+    std::array<vk::Pipeline, 4> libraries;
+    ShaderPartData vertexData = partData[key.vertexPart];
+    ShaderPartData fragmentData = partData[key.fragmentPart];
+    vk::ShaderModule vertexModule = shaderModules[vertexData.shader];
+    vk::ShaderModule fragmentModule = shaderModules[fragmentData.shader];
+    if (this->libraryEnabled)
+    {
+        libraries = this->getLibraries(key);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->backgroundMutex);
+        this->pendingBackgroundBuilds++;
+    }
+
+    std::function<void()> build = [this, index, key, optimize, libraries, vertexModule, fragmentModule, vertexData, fragmentData]()
+    {
+        PROFILE_ZONE("BuildPipelineInBackground");
+        auto startTime = std::chrono::high_resolution_clock::now();
+        vk::Pipeline pipeline;
+        bool failed = false;
+
+        // An exception escaping the thread would terminate the process, and release() would wait on this build forever.
+        try
+        {
+            pipeline = optimize ?
+                linkLibraries(this->logicalDevice, libraries, true) :
+                createMonolithicPipeline(this->logicalDevice, key, vertexModule, vertexData.specialization, fragmentModule,
+                    fragmentData.specialization, this->dynamicRasterState);
+        }
+        catch (const std::exception&)
+        {
+            failed = true;
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        std::lock_guard<std::mutex> lock(this->backgroundMutex);
+        completedPipelines.push_back({ index, pipeline, std::chrono::duration<double, std::milli>(endTime - startTime).count(), optimize, failed });
+        this->pendingBackgroundBuilds--;
+        this->backgroundCondition.notify_all();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(this->backgroundMutex);
+        this->backgroundBuilds.push(std::move(build));
+    }
+
+    this->backgroundCondition.notify_all();
+}
+
+void GraphicsPipelines::backgroundLoop()
+{
+    Profiler::setThreadName("Pipeline Builder");
+
+    while (true)
+    {
+        std::function<void()> build;
+        {
+            std::unique_lock<std::mutex> lock(this->backgroundMutex);
+            this->backgroundCondition.wait(lock, [this]() { return this->backgroundStopping || !this->backgroundBuilds.empty(); });
+            if (this->backgroundBuilds.empty())
+            {
+                return;
+            }
+
+            build = std::move(this->backgroundBuilds.front());
+            this->backgroundBuilds.pop();
+        }
+
+        build();
+    }
+}
+
+void GraphicsPipelines::setFallback(uint32_t index)
+{
+    this->fallbackPipeline = index;
+}
+
+bool GraphicsPipelines::isReady(uint32_t index) const
+{
+    return static_cast<bool>(linkedPipelines[index]);
+}
+
+void GraphicsPipelines::bind(const vk::CommandBuffer& commandBuffer, uint32_t index, const RasterState& rasterState)
+{
+    // Until a background build lands, draw with the fallback; it shares layout and formats.
+    vk::Pipeline pipeline = linkedPipelines[index];
+    if (!pipeline)
+    {
+        pipeline = linkedPipelines[this->fallbackPipeline];
+    }
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+
+    if (!this->dynamicRasterState)
+    {
+        return;
+    }
+
+    commandBuffer.setCullMode(getCullMode(rasterState.cullMode));
+    commandBuffer.setFrontFace(getFrontFace(rasterState.frontFace));
+    commandBuffer.setPrimitiveTopology(getTopology(rasterState.topology));
+    commandBuffer.setDepthTestEnable(rasterState.depthTest);
+    commandBuffer.setDepthWriteEnable(rasterState.depthWrite);
+    commandBuffer.setDepthCompareOp(getCompareOp(rasterState.depthCompare));
+}
+
+void GraphicsPipelines::collectCompletedPipelines()
+{
+    std::vector<CompletedPipeline> completed;
+    {
+        std::lock_guard<std::mutex> lock(this->backgroundMutex);
+        completed.swap(completedPipelines);
+        this->stats.pendingCount = this->pendingBackgroundBuilds;
+    }
+
+    // Frames already recorded may still use the fast-linked pipeline, so it goes once they retire.
+    for (const CompletedPipeline& built : completed)
+    {
+        // The variant keeps drawing with what it has: its fast link, or the fallback for a monolithic build.
+        if (built.failed)
+        {
+            this->stats.failedCount++;
+            PROFILE_EVENT("PipelineBuildFailed");
+            continue;
+        }
+
+        vk::Pipeline previous = linkedPipelines[built.index];
+        if (previous)
+        {
+            vk::Device* device = this->logicalDevice;
+            this->syncObjects->deferDestruction([device, previous]() { device->destroyPipeline(previous); });
+        }
+
+        linkedPipelines[built.index] = built.pipeline;
+        PROFILE_EVENT("PipelineCompiled");
+
+        if (built.optimized)
+        {
+            this->stats.optimizedCount++;
+            this->stats.lastOptimizedLinkMs = built.buildTimeMs;
+        }
+        else
+        {
+            this->stats.backgroundCount++;
+            this->stats.lastBackgroundBuildMs = built.buildTimeMs;
+        }
+    }
+}
+
+void GraphicsPipelines::finishBackgroundBuilds()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->backgroundMutex);
+        this->backgroundCondition.wait(lock, [this]() { return this->pendingBackgroundBuilds == 0; });
+    }
+
+    this->collectCompletedPipelines();
+}
+
+bool GraphicsPipelines::isLibraryEnabled() const
+{
+    return this->libraryEnabled;
+}
+
+bool GraphicsPipelines::isDynamicRasterState() const
+{
+    return this->dynamicRasterState;
+}
+
+const PipelineStats& GraphicsPipelines::getStats() const
+{
+    return this->stats;
+}
+
+void GraphicsPipelines::release()
+{
+    if (this->logicalDevice == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->backgroundMutex);
+        this->backgroundCondition.wait(lock, [this]() { return this->pendingBackgroundBuilds == 0; });
+        this->backgroundStopping = true;
+    }
+
+    this->backgroundCondition.notify_all();
+    this->backgroundThread.join();
+
+    for (const CompletedPipeline& built : completedPipelines)
+    {
+        this->logicalDevice->destroyPipeline(built.pipeline);
+    }
+
+    for (const vk::Pipeline& pipeline : linkedPipelines)
+    {
+        this->logicalDevice->destroyPipeline(pipeline);
+    }
+
+    for (const vk::Pipeline& library : partLibraries)
+    {
+        this->logicalDevice->destroyPipeline(library);
+    }
+
+    for (const vk::ShaderModule& module : shaderModules)
+    {
+        this->logicalDevice->destroyShaderModule(module);
+    }
+
+    if (this->libraryEnabled)
+    {
+        for (const vk::Pipeline& library : vertexInputLibraries)
+        {
+            this->logicalDevice->destroyPipeline(library);
+        }
+
+        for (const vk::Pipeline& library : fragmentOutputLibraries)
+        {
+            this->logicalDevice->destroyPipeline(library);
+        }
+    }
+
+    completedPipelines.clear();
+    linkedPipelines.clear();
+    this->pipelineCache.clear();
+    this->shaderParts.clear();
+    partLibraries.clear();
+    partData.clear();
+    shaderModules.clear();
+    shaderVertexStages.clear();
+    this->logicalDevice = nullptr;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Devices;
+class RenderPass;
+class SyncObjects;
+
+enum class CullMode : uint8_t
+{
+	None,
+	Front,
+	Back
+};
+
+enum class FrontFace : uint8_t
+{
+	CounterClockwise,
+	Clockwise
+};
+
+enum class Topology : uint8_t
+{
+	PointList,
+	LineList,
+	LineStrip,
+	TriangleList,
+	TriangleStrip
+};
+
+enum class CompareOp : uint8_t
+{
+	Never,
+	Less,
+	Equal,
+	LessOrEqual,
+	Greater,
+	GreaterOrEqual,
+	Always
+};
+
+enum class BlendMode : uint8_t
+{
+	Opaque,
+	AlphaBlend,
+	Additive
+};
+
+const uint32_t BLEND_MODE_COUNT = 3;
+
+// Specialization constant ids shared with shader.vert and shader.frag.
+enum class ShaderFeature : uint32_t
+{
+	Texturing,
+	VertexColor,
+	AlphaTest,
+	PrecomputedMvp,
+	AlphaCutoff
+};
+
+// Bit per boolean ShaderFeature, used to name a material's shader variant.
+typedef uint32_t ShaderFeatureMask;
+
+inline ShaderFeatureMask getFeatureBit(ShaderFeature feature)
+{
+	return 1u << static_cast<uint32_t>(feature);
+}
+
+struct SpecializationConstant
+{
+	uint32_t id = 0;
+	// Raw 32-bit value; booleans are VkBool32 and floats are stored by bit pattern.
+	uint32_t value = 0;
+
+	bool operator==(const SpecializationConstant& other) const;
+};
+
+struct ShaderSpecialization
+{
+	std::vector<SpecializationConstant> constants;
+
+	void setBool(uint32_t id, bool value);
+	void setFloat(uint32_t id, float value);
+	void setValue(uint32_t id, uint32_t value);
+	bool operator==(const ShaderSpecialization& other) const;
+	size_t hash() const;
+
+	static ShaderSpecialization fromFeatures(ShaderFeatureMask features, float alphaCutoff = 0.5f);
+};
+
+// A shader part is one shader module compiled with one set of specialization constants.
+struct ShaderPartKey
+{
+	uint32_t shader = 0;
+	ShaderSpecialization specialization;
+
+	bool operator==(const ShaderPartKey& other) const;
+};
+
+struct ShaderPartKeyHash
+{
+	size_t operator()(const ShaderPartKey& key) const;
+};
+
+// Per-material state that extended dynamic state lets us set per draw instead of per pipeline.
+struct RasterState
+{
+	CullMode cullMode = CullMode::Back;
+	FrontFace frontFace = FrontFace::CounterClockwise;
+	Topology topology = Topology::TriangleList;
+	bool depthTest = true;
+	bool depthWrite = true;
+	CompareOp depthCompare = CompareOp::Less;
+
+	bool operator==(const RasterState& other) const;
+};
+
+// Compact pipeline description used as the cache key; state that is dynamic on this device is
+// left at its defaults so it doesn't split the cache.
+struct PipelineKey
+{
+	uint32_t vertexPart = 0;
+	uint32_t fragmentPart = 0;
+	uint32_t vertexLayout = 0;
+	RasterState rasterState;
+	BlendMode blendMode = BlendMode::Opaque;
+	uint32_t colorFormat = 0;
+	uint32_t depthFormat = 0;
+
+	bool operator==(const PipelineKey& other) const;
+	size_t hash() const;
+};
+
+struct PipelineKeyHash
+{
+	size_t operator()(const PipelineKey& key) const
+	{
+		return key.hash();
+	}
+};
+
+struct PipelineStats
+{
+	uint32_t fastLinkCount = 0;
+	uint32_t optimizedCount = 0;
+	uint32_t backgroundCount = 0;
+	uint32_t pendingCount = 0;
+	uint32_t failedCount = 0;
+	uint32_t cacheHits = 0;
+	uint32_t cacheMisses = 0;
+	double lastFastLinkMs = 0.0;
+	double lastOptimizedLinkMs = 0.0;
+	double lastBackgroundBuildMs = 0.0;
+	uint32_t shaderVariantCount = 0;
+};
+
+/*
+* Builds graphics pipelines from separately compiled parts. With VK_EXT_graphics_pipeline_library
+* the vertex input and fragment output interfaces are compiled once per topology class and blend
+* mode, each shader becomes its own library, and a pipeline is a quick link of four libraries; a
+* link-time optimized version is then built on a dedicated builder thread, outside the frame
+* ThreadPool, and swapped in when ready. Without the extension every link is a monolithic pipeline
+* build. Libraries are only used together with extended dynamic state, so no part depends on
+* per-material raster or depth state.
+*
+* Pipelines are cached by PipelineKey. request() never blocks on a monolithic build: a miss is
+* built on the builder thread and bind() uses the fallback pipeline until it is ready. A build
+* that fails leaves the variant on its previous or fallback pipeline.
+*
+* Shader variants are specialization constants rather than separate GLSL files: each shader
+* module can be turned into any number of parts, one per specialization, and the driver drops the
+* code paths a variant disables. Parts are registered by (shader, specialization), so materials
+* asking for the same features share parts and, through the pipeline cache, pipelines.
+*/
+class GraphicsPipelines
+{
+private:
+	vk::Device* logicalDevice = nullptr;
+	SyncObjects* syncObjects = nullptr;
+	bool libraryEnabled = false;
+	bool dynamicRasterState = false;
+	uint32_t vertexLayoutHash = 0;
+	uint32_t colorFormat = 0;
+	uint32_t depthFormat = 0;
+	uint32_t fallbackPipeline = 0;
+	std::unordered_map<PipelineKey, uint32_t, PipelineKeyHash> pipelineCache;
+	std::unordered_map<ShaderPartKey, uint32_t, ShaderPartKeyHash> shaderParts;
+	PipelineStats stats;
+
+	// Guards the link queue and the pipelines finished by the builder thread until the main thread swaps them in.
+	std::mutex backgroundMutex;
+	std::condition_variable backgroundCondition;
+	std::queue<std::function<void()>> backgroundBuilds;
+	std::thread backgroundThread;
+	bool backgroundStopping = false;
+	uint32_t pendingBackgroundBuilds = 0;
+
+private:
+	void init(Devices& devices, RenderPass& renderPass, const vk::PipelineLayout& pipelineLayout, SyncObjects* syncObjects);
+	void createInterfaceLibraries();
+	uint32_t createShader(const std::vector<char>& code, bool vertexStage);
+	void releaseShader(uint32_t shader);
+	uint32_t createShaderPart(uint32_t shader, const ShaderSpecialization& specialization);
+	uint32_t requestVariant(uint32_t vertexShader, uint32_t fragmentShader, ShaderFeatureMask features, const RasterState& rasterState,
+		BlendMode blendMode = BlendMode::Opaque);
+	PipelineKey createKey(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode) const;
+	uint32_t addPipeline(const PipelineKey& key, const vk::Pipeline& pipeline);
+	uint32_t link(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode = BlendMode::Opaque);
+	uint32_t request(uint32_t vertexPart, uint32_t fragmentPart, const RasterState& rasterState, BlendMode blendMode = BlendMode::Opaque);
+	std::array<vk::Pipeline, 4> getLibraries(const PipelineKey& key) const;
+	void buildInBackground(uint32_t index, const PipelineKey& key, bool optimize);
+	void backgroundLoop();
+	void setFallback(uint32_t index);
+	bool isReady(uint32_t index) const;
+	void bind(const vk::CommandBuffer& commandBuffer, uint32_t index, const RasterState& rasterState);
+	void collectCompletedPipelines();
+	void finishBackgroundBuilds();
+	bool isLibraryEnabled() const;
+	bool isDynamicRasterState() const;
+	const PipelineStats& getStats() const;
+	void release();
+
+friend class VulkanAPI;
+friend class CommandBuffers;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+enum class LatencyMode
+{
+	LowLatency,
+	Balanced,
+	Throughput
+};
+
+struct LatencySettings
+{
+	uint32_t framesInFlight;
+	uint32_t extraSwapchainImages;
+};
+
+// Fewer frames in flight and a shorter swapchain queue mean input reaches the screen sooner;
+// more of both lets the CPU run further ahead and keep the GPU busy through hitches.
+inline LatencySettings getLatencySettings(LatencyMode mode)
+{
+	switch (mode)
+	{
+	case LatencyMode::LowLatency:
+		return { 1, 0 };
+	case LatencyMode::Throughput:
+		return { 3, 2 };
+	default:
+		return { 2, 1 };
+	}
+}
+
+inline const char* getLatencyModeName(LatencyMode mode)
+{
+	switch (mode)
+	{
+	case LatencyMode::LowLatency:
+		return "low latency";
+	case LatencyMode::Throughput:
+		return "throughput";
+	default:
+		return "balanced";
+	}
+}
@@ -0,0 +1,312 @@
+#include "LayoutCache.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+
+// Deques keep references to cached handles valid as new layouts are added.
+std::deque<vk::DescriptorSetLayout> cachedSetLayouts;
+std::deque<vk::PipelineLayout> cachedPipelineLayouts;
+std::deque<vk::DescriptorUpdateTemplate> cachedUpdateTemplates;
+
+static_assert((sizeof(vk::DescriptorImageInfo) <= DESCRIPTOR_TEMPLATE_STRIDE) && (sizeof(vk::DescriptorBufferInfo) <= DESCRIPTOR_TEMPLATE_STRIDE),
+    "Descriptor template slots are too small!");
+
+const size_t LAYOUT_FNV_OFFSET_BASIS = static_cast<size_t>(14695981039346656037ull);
+const size_t LAYOUT_FNV_PRIME = static_cast<size_t>(1099511628211ull);
+
+void hashLayoutValue(size_t& hash, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= LAYOUT_FNV_PRIME;
+    }
+}
+
+bool DescriptorSetLayoutKey::operator==(const DescriptorSetLayoutKey& other) const
+{
+    return (this->bindings == other.bindings) && (this->pushDescriptor == other.pushDescriptor);
+}
+
+size_t DescriptorSetLayoutKey::hash() const
+{
+    size_t result = LAYOUT_FNV_OFFSET_BASIS;
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        hashLayoutValue(result, binding.binding);
+        hashLayoutValue(result, binding.descriptorType);
+        hashLayoutValue(result, binding.count);
+        hashLayoutValue(result, binding.stageFlags);
+    }
+
+    hashLayoutValue(result, this->pushDescriptor ? 1 : 0);
+
+    return result;
+}
+
+bool PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const
+{
+    return (this->setLayouts == other.setLayouts) && (this->pushConstantRanges == other.pushConstantRanges);
+}
+
+size_t PipelineLayoutKey::hash() const
+{
+    size_t result = LAYOUT_FNV_OFFSET_BASIS;
+    for (uint32_t setLayout : this->setLayouts)
+    {
+        hashLayoutValue(result, setLayout);
+    }
+
+    for (const ReflectedPushConstantRange& range : this->pushConstantRanges)
+    {
+        hashLayoutValue(result, range.offset);
+        hashLayoutValue(result, range.size);
+        hashLayoutValue(result, range.stageFlags);
+    }
+
+    return result;
+}
+
+void LayoutCache::init(vk::Device* logicalDevice, uint32_t maxBindlessTextures, uint32_t maxBindlessBuffers)
+{
+    this->logicalDevice = logicalDevice;
+    this->maxBindlessTextures = maxBindlessTextures;
+    this->maxBindlessBuffers = maxBindlessBuffers;
+}
+
+uint32_t LayoutCache::getBindlessCount(uint32_t descriptorType) const
+{
+    switch (static_cast<vk::DescriptorType>(descriptorType))
+    {
+    case vk::DescriptorType::eCombinedImageSampler:
+    case vk::DescriptorType::eSampledImage:
+        return this->maxBindlessTextures;
+    case vk::DescriptorType::eStorageBuffer:
+        return this->maxBindlessBuffers;
+    default:
+        return 0;
+    }
+}
+
+void LayoutCache::setPushDescriptorSet(uint32_t set)
+{
+    this->pushDescriptorSet = set;
+}
+
+uint32_t LayoutCache::getDescriptorSetLayoutIndex(const std::vector<ReflectedBinding>& bindings, bool pushDescriptor)
+{
+    DescriptorSetLayoutKey key;
+    key.bindings = bindings;
+    key.pushDescriptor = pushDescriptor;
+    for (ReflectedBinding& binding : key.bindings)
+    {
+        binding.set = 0;
+    }
+
+    auto cached = this->setLayoutIndices.find(key);
+    if (cached != this->setLayoutIndices.end())
+    {
+        return cached->second;
+    }
+
+    std::vector<vk::DescriptorSetLayoutBinding> layoutBindings;
+    std::vector<vk::DescriptorBindingFlags> bindingFlags;
+    bool bindless = false;
+    for (size_t i = 0; i < key.bindings.size(); i++)
+    {
+        const ReflectedBinding& binding = key.bindings[i];
+        uint32_t count = binding.count;
+        vk::DescriptorBindingFlags flags;
+
+        if ((count == 0) && pushDescriptor)
+        {
+            throw std::runtime_error("Runtime descriptor arrays can't be pushed!");
+        }
+
+        if (count == 0)
+        {
+            count = this->getBindlessCount(binding.descriptorType);
+            if (count == 0)
+            {
+                throw std::runtime_error("Shader uses a runtime descriptor array the device can't provide!");
+            }
+
+            // Only the last binding of a set may have a variable count.
+            flags = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+            if (i == (key.bindings.size() - 1))
+            {
+                flags |= vk::DescriptorBindingFlagBits::eVariableDescriptorCount;
+            }
+
+            bindless = true;
+        }
+
+        layoutBindings.push_back(vk::DescriptorSetLayoutBinding()
+            .setBinding(binding.binding)
+            .setDescriptorType(static_cast<vk::DescriptorType>(binding.descriptorType))
+            .setDescriptorCount(count)
+            .setStageFlags(static_cast<vk::ShaderStageFlags>(binding.stageFlags)));
+        bindingFlags.push_back(flags);
+    }
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfo()
+        .setBindingFlags(bindingFlags);
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo = vk::DescriptorSetLayoutCreateInfo().setBindings(layoutBindings);
+    if (bindless)
+    {
+        layoutInfo
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+            .setPNext(&bindingFlagsInfo);
+    }
+    else if (pushDescriptor)
+    {
+        layoutInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+    }
+
+    uint32_t result = static_cast<uint32_t>(cachedSetLayouts.size());
+    cachedSetLayouts.push_back(this->logicalDevice->createDescriptorSetLayout(layoutInfo));
+    this->setLayoutIndices[key] = result;
+
+    return result;
+}
+
+const vk::DescriptorSetLayout& LayoutCache::getDescriptorSetLayout(const std::vector<ReflectedBinding>& bindings, bool pushDescriptor)
+{
+    return cachedSetLayouts[this->getDescriptorSetLayoutIndex(bindings, pushDescriptor)];
+}
+
+uint32_t LayoutCache::getPipelineLayoutIndex(const ShaderLayout& layout)
+{
+    // Unused set numbers below the highest one still need a (empty) layout.
+    PipelineLayoutKey key;
+    for (uint32_t set = 0; set < layout.getSetCount(); set++)
+    {
+        key.setLayouts.push_back(this->getDescriptorSetLayoutIndex(layout.getSetBindings(set), set == this->pushDescriptorSet));
+    }
+    key.pushConstantRanges = layout.pushConstantRanges;
+
+    auto cached = this->pipelineLayoutIndices.find(key);
+    if (cached != this->pipelineLayoutIndices.end())
+    {
+        return cached->second;
+    }
+
+    std::vector<vk::DescriptorSetLayout> setLayouts;
+    for (uint32_t index : key.setLayouts)
+    {
+        setLayouts.push_back(cachedSetLayouts[index]);
+    }
+
+    std::vector<vk::PushConstantRange> pushConstantRanges;
+    for (const ReflectedPushConstantRange& range : key.pushConstantRanges)
+    {
+        pushConstantRanges.push_back(vk::PushConstantRange(static_cast<vk::ShaderStageFlags>(range.stageFlags), range.offset, range.size));
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
+        .setSetLayouts(setLayouts)
+        .setPushConstantRanges(pushConstantRanges);
+
+    vk::PipelineLayout pipelineLayout;
+    if (this->logicalDevice->createPipelineLayout(&pipelineLayoutInfo, nullptr, &pipelineLayout) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+
+    uint32_t index = static_cast<uint32_t>(cachedPipelineLayouts.size());
+    cachedPipelineLayouts.push_back(pipelineLayout);
+    this->pipelineLayoutIndices[key] = index;
+
+    return index;
+}
+
+const vk::PipelineLayout& LayoutCache::getPipelineLayout(const ShaderLayout& layout)
+{
+    return cachedPipelineLayouts[this->getPipelineLayoutIndex(layout)];
+}
+
+const vk::DescriptorUpdateTemplate* LayoutCache::getUpdateTemplate(const ShaderLayout& layout, uint32_t set)
+{
+    std::vector<ReflectedBinding> bindings = layout.getSetBindings(set);
+    std::vector<vk::DescriptorUpdateTemplateEntry> entries;
+    for (const ReflectedBinding& binding : bindings)
+    {
+        // Bindless arrays are written slot by slot as resources are registered.
+        if (binding.count == 0)
+        {
+            return nullptr;
+        }
+
+        entries.push_back(vk::DescriptorUpdateTemplateEntry()
+            .setDstBinding(binding.binding)
+            .setDstArrayElement(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(static_cast<vk::DescriptorType>(binding.descriptorType))
+            .setOffset(entries.size() * DESCRIPTOR_TEMPLATE_STRIDE)
+            .setStride(DESCRIPTOR_TEMPLATE_STRIDE));
+    }
+
+    if (entries.empty())
+    {
+        return nullptr;
+    }
+
+    uint32_t pipelineLayoutIndex = this->getPipelineLayoutIndex(layout);
+    uint64_t key = (static_cast<uint64_t>(pipelineLayoutIndex) << 32) | set;
+    auto cached = this->updateTemplateIndices.find(key);
+    if (cached != this->updateTemplateIndices.end())
+    {
+        return &cachedUpdateTemplates[cached->second];
+    }
+
+    vk::DescriptorUpdateTemplateCreateInfo templateInfo = vk::DescriptorUpdateTemplateCreateInfo()
+        .setDescriptorUpdateEntries(entries);
+
+    if (set == this->pushDescriptorSet)
+    {
+        templateInfo
+            .setTemplateType(vk::DescriptorUpdateTemplateType::ePushDescriptorsKHR)
+            .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+            .setPipelineLayout(cachedPipelineLayouts[pipelineLayoutIndex])
+            .setSet(set);
+    }
+    else
+    {
+        templateInfo
+            .setTemplateType(vk::DescriptorUpdateTemplateType::eDescriptorSet)
+            .setDescriptorSetLayout(cachedSetLayouts[this->getDescriptorSetLayoutIndex(bindings)]);
+    }
+
+    uint32_t index = static_cast<uint32_t>(cachedUpdateTemplates.size());
+    cachedUpdateTemplates.push_back(this->logicalDevice->createDescriptorUpdateTemplate(templateInfo));
+    this->updateTemplateIndices[key] = index;
+
+    return &cachedUpdateTemplates[index];
+}
+
+void LayoutCache::release()
+{
+    for (vk::DescriptorUpdateTemplate& updateTemplate : cachedUpdateTemplates)
+    {
+        this->logicalDevice->destroyDescriptorUpdateTemplate(updateTemplate);
+    }
+
+    for (vk::PipelineLayout& pipelineLayout : cachedPipelineLayouts)
+    {
+        this->logicalDevice->destroyPipelineLayout(pipelineLayout);
+    }
+
+    for (vk::DescriptorSetLayout& setLayout : cachedSetLayouts)
+    {
+        this->logicalDevice->destroyDescriptorSetLayout(setLayout);
+    }
+
+    cachedUpdateTemplates.clear();
+    cachedPipelineLayouts.clear();
+    cachedSetLayouts.clear();
+    this->updateTemplateIndices.clear();
+    this->pipelineLayoutIndices.clear();
+    this->setLayoutIndices.clear();
+}
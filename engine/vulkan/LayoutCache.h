@@ -0,0 +1,84 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+#include "ShaderReflection.h"
+
+#include <unordered_map>
+#include <vector>
+
+const uint32_t NO_PUSH_DESCRIPTOR_SET = UINT32_MAX;
+// Bytes per descriptor in update template data, enough for a DescriptorImageInfo or a DescriptorBufferInfo.
+const size_t DESCRIPTOR_TEMPLATE_STRIDE = 24;
+
+struct DescriptorSetLayoutKey
+{
+	// Bindings with the set number cleared, so identical sets at different indices share a layout.
+	std::vector<ReflectedBinding> bindings;
+	bool pushDescriptor = false;
+
+	bool operator==(const DescriptorSetLayoutKey& other) const;
+	size_t hash() const;
+};
+
+struct PipelineLayoutKey
+{
+	std::vector<uint32_t> setLayouts;
+	std::vector<ReflectedPushConstantRange> pushConstantRanges;
+
+	bool operator==(const PipelineLayoutKey& other) const;
+	size_t hash() const;
+};
+
+struct DescriptorSetLayoutKeyHash
+{
+	size_t operator()(const DescriptorSetLayoutKey& key) const
+	{
+		return key.hash();
+	}
+};
+
+struct PipelineLayoutKeyHash
+{
+	size_t operator()(const PipelineLayoutKey& key) const
+	{
+		return key.hash();
+	}
+};
+
+/*
+* Owns every descriptor set layout and pipeline layout. Layouts are built from reflected shader
+* data and deduplicated, so pipelines whose shaders declare the same resources share one layout
+* and are compatible for descriptor set binding.
+*
+* A runtime-sized array in a shader becomes a bindless binding: partially bound and
+* update-after-bind, sized to the device limit, and of variable count when it is the last binding.
+*
+* Each set also gets a descriptor update template built from the same reflection, writing element 0
+* of every binding from DESCRIPTOR_TEMPLATE_STRIDE sized slots in binding order. The push
+* descriptor set, if one is chosen, has a push layout and a push template instead.
+*/
+class LayoutCache
+{
+private:
+	vk::Device* logicalDevice = nullptr;
+	uint32_t maxBindlessTextures = 0;
+	uint32_t maxBindlessBuffers = 0;
+	uint32_t pushDescriptorSet = NO_PUSH_DESCRIPTOR_SET;
+	std::unordered_map<DescriptorSetLayoutKey, uint32_t, DescriptorSetLayoutKeyHash> setLayoutIndices;
+	std::unordered_map<PipelineLayoutKey, uint32_t, PipelineLayoutKeyHash> pipelineLayoutIndices;
+	// Keyed by pipeline layout index in the high half and set number in the low half.
+	std::unordered_map<uint64_t, uint32_t> updateTemplateIndices;
+
+private:
+	void init(vk::Device* logicalDevice, uint32_t maxBindlessTextures, uint32_t maxBindlessBuffers);
+	uint32_t getBindlessCount(uint32_t descriptorType) const;
+	void setPushDescriptorSet(uint32_t set);
+	uint32_t getDescriptorSetLayoutIndex(const std::vector<ReflectedBinding>& bindings, bool pushDescriptor = false);
+	const vk::DescriptorSetLayout& getDescriptorSetLayout(const std::vector<ReflectedBinding>& bindings, bool pushDescriptor = false);
+	uint32_t getPipelineLayoutIndex(const ShaderLayout& layout);
+	const vk::PipelineLayout& getPipelineLayout(const ShaderLayout& layout);
+	const vk::DescriptorUpdateTemplate* getUpdateTemplate(const ShaderLayout& layout, uint32_t set);
+	void release();
+
+friend class VulkanAPI;
+};
@@ -3,8 +3,16 @@
 #include "Vertex.h"
 #include <vector>
 
+struct Bounds
+{
+	glm::vec3 center{ 0.0f };
+	glm::vec3 extents{ 0.0f };
+	float radius = 0.0f;
+};
+
 struct Model
 {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	Bounds bounds;
 };
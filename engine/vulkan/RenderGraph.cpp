@@ -0,0 +1,470 @@
+#include "RenderGraph.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <stdexcept>
+
+struct UsageInfo
+{
+    vk::PipelineStageFlags stages;
+    vk::AccessFlags access;
+    vk::ImageLayout layout;
+};
+
+static UsageInfo getUsageInfo(ResourceUsage usage)
+{
+    switch (usage)
+    {
+    case ResourceUsage::ColorAttachmentWrite:
+        return
+        {
+            vk::PipelineStageFlagBits::eColorAttachmentOutput,
+            vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+            vk::ImageLayout::eColorAttachmentOptimal
+        };
+    case ResourceUsage::DepthAttachmentWrite:
+        return
+        {
+            vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal
+        };
+    case ResourceUsage::DepthAttachmentRead:
+        return
+        {
+            vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+            vk::AccessFlagBits::eDepthStencilAttachmentRead,
+            vk::ImageLayout::eDepthStencilAttachmentOptimal
+        };
+    case ResourceUsage::VertexShaderRead:
+        return { vk::PipelineStageFlagBits::eVertexShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal };
+    case ResourceUsage::FragmentShaderRead:
+        return { vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal };
+    case ResourceUsage::ComputeShaderRead:
+        return { vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral };
+    case ResourceUsage::ComputeShaderWrite:
+        return
+        {
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            vk::ImageLayout::eGeneral
+        };
+    case ResourceUsage::TransferRead:
+        return { vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal };
+    case ResourceUsage::TransferWrite:
+        return { vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal };
+    case ResourceUsage::IndirectRead:
+        return { vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead, vk::ImageLayout::eUndefined };
+    case ResourceUsage::VertexInputRead:
+        return
+        {
+            vk::PipelineStageFlagBits::eVertexInput,
+            vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead,
+            vk::ImageLayout::eUndefined
+        };
+    case ResourceUsage::Present:
+        return { vk::PipelineStageFlagBits::eBottomOfPipe, vk::AccessFlags(), vk::ImageLayout::ePresentSrcKHR };
+    default:
+        return { vk::PipelineStageFlagBits::eTopOfPipe, vk::AccessFlags(), vk::ImageLayout::eUndefined };
+    }
+}
+
+static uint32_t toMask(vk::PipelineStageFlags flags)
+{
+    return static_cast<VkPipelineStageFlags>(flags);
+}
+
+static uint32_t toMask(vk::AccessFlags flags)
+{
+    return static_cast<VkAccessFlags>(flags);
+}
+
+static vk::PipelineStageFlags toStages(uint32_t mask)
+{
+    return (mask != 0) ? vk::PipelineStageFlags(static_cast<vk::PipelineStageFlagBits>(mask)) : vk::PipelineStageFlagBits::eTopOfPipe;
+}
+
+static vk::AccessFlags toAccess(uint32_t mask)
+{
+    return vk::AccessFlags(static_cast<vk::AccessFlagBits>(mask));
+}
+
+void RenderGraph::reset()
+{
+    this->resources.clear();
+    this->passes.clear();
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, const vk::Image& image, uint32_t aspectMask,
+    ResourceUsage initialUsage, bool discardContents, ResourceUsage finalUsage)
+{
+    UsageInfo info = getUsageInfo(initialUsage);
+
+    Resource resource;
+    resource.name = name;
+    resource.image = &image;
+    resource.aspectMask = aspectMask;
+    resource.finalUsage = finalUsage;
+    resource.state.layout = static_cast<uint32_t>(discardContents ? vk::ImageLayout::eUndefined : info.layout);
+
+    if (isWrite(initialUsage))
+    {
+        resource.state.writeStages = toMask(info.stages);
+        resource.state.writeAccess = toMask(info.access);
+    }
+    else if (initialUsage != ResourceUsage::None)
+    {
+        resource.state.readStages = toMask(info.stages);
+        resource.state.readAccess = toMask(info.access);
+    }
+
+    this->resources.push_back(resource);
+    return static_cast<RenderGraphResource>(this->resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, const vk::Buffer& buffer, ResourceUsage initialUsage)
+{
+    UsageInfo info = getUsageInfo(initialUsage);
+
+    Resource resource;
+    resource.name = name;
+    resource.buffer = &buffer;
+    resource.finalUsage = ResourceUsage::None;
+
+    if (isWrite(initialUsage))
+    {
+        resource.state.writeStages = toMask(info.stages);
+        resource.state.writeAccess = toMask(info.access);
+    }
+    else if (initialUsage != ResourceUsage::None)
+    {
+        resource.state.readStages = toMask(info.stages);
+        resource.state.readAccess = toMask(info.access);
+    }
+
+    this->resources.push_back(resource);
+    return static_cast<RenderGraphResource>(this->resources.size() - 1);
+}
+
+void RenderGraph::addPass(const std::string& name, const std::vector<RenderGraphAccess>& accesses,
+    std::function<void(const vk::CommandBuffer&)> record, bool hasSideEffects)
+{
+    Pass pass;
+    pass.name = name;
+    pass.accesses = accesses;
+    pass.record = std::move(record);
+    pass.hasSideEffects = hasSideEffects;
+
+    this->passes.push_back(std::move(pass));
+}
+
+void RenderGraph::compile()
+{
+    this->sortPasses();
+
+    // Walk backwards from the exported resources: a pass survives only if something downstream
+    // reads what it writes, and then everything it reads becomes needed in turn.
+    std::vector<bool> needed(this->resources.size(), false);
+    for (size_t i = 0; i < this->resources.size(); i++)
+    {
+        needed[i] = (this->resources[i].finalUsage != ResourceUsage::None);
+    }
+
+    for (auto pass = this->passes.rbegin(); pass != this->passes.rend(); ++pass)
+    {
+        bool alive = pass->hasSideEffects;
+        for (const RenderGraphAccess& access : pass->accesses)
+        {
+            if (isWrite(access.usage) && needed[access.resource])
+            {
+                alive = true;
+            }
+        }
+
+        pass->culled = !alive;
+        if (!alive)
+        {
+            continue;
+        }
+
+        for (const RenderGraphAccess& access : pass->accesses)
+        {
+            if (!isWrite(access.usage))
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::sortPasses()
+{
+    // Each resource's writers run in the order they were added, and all of them before any reader.
+    std::vector<std::vector<uint32_t>> dependents(this->passes.size());
+    std::vector<uint32_t> dependencyCount(this->passes.size(), 0);
+    std::vector<std::vector<uint32_t>> writers(this->resources.size());
+    std::vector<std::vector<uint32_t>> readers(this->resources.size());
+
+    for (uint32_t i = 0; i < this->passes.size(); i++)
+    {
+        for (const RenderGraphAccess& access : this->passes[i].accesses)
+        {
+            std::vector<uint32_t>& users = isWrite(access.usage) ? writers[access.resource] : readers[access.resource];
+            if (users.empty() || (users.back() != i))
+            {
+                users.push_back(i);
+            }
+        }
+    }
+
+    auto addDependency = [&](uint32_t before, uint32_t after)
+    {
+        if (before != after)
+        {
+            dependents[before].push_back(after);
+            dependencyCount[after]++;
+        }
+    };
+
+    for (size_t resource = 0; resource < this->resources.size(); resource++)
+    {
+        for (size_t i = 1; i < writers[resource].size(); i++)
+        {
+            addDependency(writers[resource][i - 1], writers[resource][i]);
+        }
+
+        for (uint32_t writer : writers[resource])
+        {
+            for (uint32_t reader : readers[resource])
+            {
+                addDependency(writer, reader);
+            }
+        }
+    }
+
+    // Always taking the earliest added pass that is ready keeps the addPass order wherever it is already valid.
+    std::vector<Pass> sorted;
+    sorted.reserve(this->passes.size());
+    std::vector<bool> scheduled(this->passes.size(), false);
+
+    while (sorted.size() < this->passes.size())
+    {
+        uint32_t next = static_cast<uint32_t>(this->passes.size());
+        for (uint32_t i = 0; i < this->passes.size(); i++)
+        {
+            if (!scheduled[i] && (dependencyCount[i] == 0))
+            {
+                next = i;
+                break;
+            }
+        }
+
+        if (next == this->passes.size())
+        {
+            throw std::runtime_error("Render graph passes have a dependency cycle!");
+        }
+
+        scheduled[next] = true;
+        for (uint32_t dependent : dependents[next])
+        {
+            dependencyCount[dependent]--;
+        }
+
+        sorted.push_back(std::move(this->passes[next]));
+    }
+
+    this->passes = std::move(sorted);
+}
+
+void RenderGraph::execute(const vk::CommandBuffer& commandBuffer)
+{
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+    std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+    vk::PipelineStageFlags srcStages;
+    vk::PipelineStageFlags dstStages;
+
+    auto addBarrier = [&](Resource& resource, ResourceUsage usage)
+    {
+        ResourceState previous;
+        if (!this->updateState(resource, usage, previous))
+        {
+            return;
+        }
+
+        UsageInfo info = getUsageInfo(usage);
+        srcStages |= toStages(previous.writeStages | previous.readStages);
+        dstStages |= info.stages;
+
+        if (resource.image != nullptr)
+        {
+            vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier()
+                .setSrcAccessMask(toAccess(previous.writeAccess))
+                .setDstAccessMask(info.access)
+                .setOldLayout(static_cast<vk::ImageLayout>(previous.layout))
+                .setNewLayout(info.layout)
+                .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                .setImage(*resource.image)
+                .setSubresourceRange(vk::ImageSubresourceRange
+                {
+                    static_cast<vk::ImageAspectFlagBits>(resource.aspectMask), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+                });
+
+            imageBarriers.push_back(barrier);
+        }
+        else
+        {
+            vk::BufferMemoryBarrier barrier = vk::BufferMemoryBarrier()
+                .setSrcAccessMask(toAccess(previous.writeAccess))
+                .setDstAccessMask(info.access)
+                .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                .setBuffer(*resource.buffer)
+                .setOffset(0)
+                .setSize(VK_WHOLE_SIZE);
+
+            bufferBarriers.push_back(barrier);
+        }
+    };
+
+    auto flushBarriers = [&]()
+    {
+        if (imageBarriers.empty() && bufferBarriers.empty())
+        {
+            return;
+        }
+
+        commandBuffer.pipelineBarrier
+        (
+            srcStages, dstStages, {}, 0, nullptr,
+            static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+            static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data()
+        );
+
+        imageBarriers.clear();
+        bufferBarriers.clear();
+        srcStages = vk::PipelineStageFlags();
+        dstStages = vk::PipelineStageFlags();
+    };
+
+    for (Pass& pass : this->passes)
+    {
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const RenderGraphAccess& access : pass.accesses)
+        {
+            addBarrier(this->resources[access.resource], access.usage);
+        }
+
+        flushBarriers();
+        pass.record(commandBuffer);
+    }
+
+    for (Resource& resource : this->resources)
+    {
+        if (resource.finalUsage != ResourceUsage::None)
+        {
+            addBarrier(resource, resource.finalUsage);
+        }
+    }
+
+    flushBarriers();
+}
+
+bool RenderGraph::updateState(Resource& resource, ResourceUsage usage, ResourceState& previous)
+{
+    UsageInfo info = getUsageInfo(usage);
+    uint32_t stages = toMask(info.stages);
+    uint32_t access = toMask(info.access);
+    uint32_t layout = static_cast<uint32_t>(info.layout);
+
+    ResourceState& state = resource.state;
+    previous = state;
+
+    bool write = isWrite(usage);
+    bool layoutChange = (resource.image != nullptr) && (layout != state.layout);
+
+    if (write || layoutChange)
+    {
+        // Writes and layout transitions wait for everything before them; later readers wait for this.
+        bool needed = layoutChange || (state.writeStages != 0) || (state.readStages != 0);
+
+        state.writeStages = stages;
+        state.writeAccess = write ? access : 0;
+        state.readStages = write ? 0 : stages;
+        state.readAccess = write ? 0 : access;
+        state.layout = layout;
+
+        return needed;
+    }
+
+    bool alreadyVisible = ((state.readStages & stages) == stages) && ((state.readAccess & access) == access);
+    state.readStages |= stages;
+    state.readAccess |= access;
+
+    return (state.writeAccess != 0) && !alreadyVisible;
+}
+
+bool RenderGraph::isWrite(ResourceUsage usage)
+{
+    return
+    (
+        (usage == ResourceUsage::ColorAttachmentWrite) ||
+        (usage == ResourceUsage::DepthAttachmentWrite) ||
+        (usage == ResourceUsage::ComputeShaderWrite) ||
+        (usage == ResourceUsage::TransferWrite)
+    );
+}
+
+ResourceUsage RenderGraph::getLayoutUsage(vk::ImageLayout layout)
+{
+    // Only layouts that are the layout of some usage are listed: recordTransition takes the layouts
+    // back from the usages, so mapping e.g. a depth read-only layout here would transition from the wrong one.
+    switch (layout)
+    {
+    case vk::ImageLayout::eUndefined:
+        return ResourceUsage::None;
+    case vk::ImageLayout::eColorAttachmentOptimal:
+        return ResourceUsage::ColorAttachmentWrite;
+    case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+        return ResourceUsage::DepthAttachmentWrite;
+    case vk::ImageLayout::eShaderReadOnlyOptimal:
+        return ResourceUsage::FragmentShaderRead;
+    case vk::ImageLayout::eGeneral:
+        return ResourceUsage::ComputeShaderWrite;
+    case vk::ImageLayout::eTransferSrcOptimal:
+        return ResourceUsage::TransferRead;
+    case vk::ImageLayout::eTransferDstOptimal:
+        return ResourceUsage::TransferWrite;
+    case vk::ImageLayout::ePresentSrcKHR:
+        return ResourceUsage::Present;
+    default:
+        // Falling back to None would discard the image's contents, or make it the illegal new layout of a transition.
+        throw std::runtime_error("Unsupported layout transition!");
+    }
+}
+
+void RenderGraph::recordTransition(const vk::CommandBuffer& commandBuffer, const vk::Image& image, uint32_t aspectMask,
+    ResourceUsage from, ResourceUsage to)
+{
+    UsageInfo source = getUsageInfo(from);
+    UsageInfo destination = getUsageInfo(to);
+
+    vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier()
+        .setSrcAccessMask(isWrite(from) ? source.access : vk::AccessFlags())
+        .setDstAccessMask(destination.access)
+        .setOldLayout(source.layout)
+        .setNewLayout(destination.layout)
+        .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+        .setImage(image)
+        .setSubresourceRange(vk::ImageSubresourceRange
+        {
+            static_cast<vk::ImageAspectFlagBits>(aspectMask), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+        });
+
+    commandBuffer.pipelineBarrier(source.stages, destination.stages, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class ResourceUsage
+{
+	None,
+	ColorAttachmentWrite,
+	DepthAttachmentWrite,
+	DepthAttachmentRead,
+	VertexShaderRead,
+	FragmentShaderRead,
+	ComputeShaderRead,
+	ComputeShaderWrite,
+	TransferRead,
+	TransferWrite,
+	IndirectRead,
+	VertexInputRead,
+	Present
+};
+
+typedef uint32_t RenderGraphResource;
+
+struct RenderGraphAccess
+{
+	RenderGraphResource resource;
+	ResourceUsage usage;
+};
+
+/*
+* Passes declare what they read and write; the graph culls passes whose results are never
+* consumed and inserts one batched pipeline barrier in front of every pass that needs it.
+* compile() orders passes so every writer of a resource runs before its readers, and writers of
+* the same resource keep the order they were added in. Passes without a dependency between them
+* also keep their addPass order.
+*/
+class RenderGraph
+{
+private:
+	// Stage/access masks are raw VkFlags so the header doesn't need the full vulkan.hpp.
+	struct ResourceState
+	{
+		uint32_t writeStages = 0;
+		uint32_t writeAccess = 0;
+		uint32_t readStages = 0;
+		uint32_t readAccess = 0;
+		uint32_t layout = 0;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		const vk::Image* image = nullptr;
+		const vk::Buffer* buffer = nullptr;
+		uint32_t aspectMask = 0;
+		ResourceUsage finalUsage;
+		ResourceState state;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<RenderGraphAccess> accesses;
+		std::function<void(const vk::CommandBuffer&)> record;
+		bool hasSideEffects = false;
+		bool culled = false;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+
+private:
+	void reset();
+	RenderGraphResource importImage(const std::string& name, const vk::Image& image, uint32_t aspectMask,
+		ResourceUsage initialUsage, bool discardContents, ResourceUsage finalUsage);
+	RenderGraphResource importBuffer(const std::string& name, const vk::Buffer& buffer, ResourceUsage initialUsage);
+	void addPass(const std::string& name, const std::vector<RenderGraphAccess>& accesses,
+		std::function<void(const vk::CommandBuffer&)> record, bool hasSideEffects = false);
+	void compile();
+	void sortPasses();
+	void execute(const vk::CommandBuffer& commandBuffer);
+	bool updateState(Resource& resource, ResourceUsage usage, ResourceState& previous);
+
+	static bool isWrite(ResourceUsage usage);
+	static ResourceUsage getLayoutUsage(vk::ImageLayout layout);
+	static void recordTransition(const vk::CommandBuffer& commandBuffer, const vk::Image& image, uint32_t aspectMask,
+		ResourceUsage from, ResourceUsage to);
+
+friend class CommandBuffers;
+};
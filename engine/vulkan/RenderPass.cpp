@@ -8,26 +8,33 @@ vk::RenderPass renderPassRef;
 
 void RenderPass::init(Devices& devices, Swapchain& swapchain)
 {
-    vk::Format swapchainImageFormat = swapchain.getImageFormat();
+    this->colorFormat = swapchain.getImageFormat();
+    this->depthFormat = devices.findDepthFormat();
+    this->dynamicRendering = devices.getCapabilities().dynamicRendering;
+
+    if (this->dynamicRendering)
+    {
+        return;
+    }
 
     vk::AttachmentDescription colorAttachment = vk::AttachmentDescription()
-        .setFormat(swapchainImageFormat)
+        .setFormat(this->colorFormat)
         .setSamples(vk::SampleCountFlagBits::e1)
         .setLoadOp(vk::AttachmentLoadOp::eClear)
         .setStoreOp(vk::AttachmentStoreOp::eStore)
         .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
         .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-        .setInitialLayout(vk::ImageLayout::eUndefined)
-        .setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+        .setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
 
     vk::AttachmentDescription depthAttachment = vk::AttachmentDescription()
-        .setFormat(devices.findDepthFormat())
+        .setFormat(this->depthFormat)
         .setSamples(vk::SampleCountFlagBits::e1)
         .setLoadOp(vk::AttachmentLoadOp::eClear)
         .setStoreOp(vk::AttachmentStoreOp::eDontCare)
         .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
         .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-        .setInitialLayout(vk::ImageLayout::eUndefined)
+        .setInitialLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
         .setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
     vk::AttachmentReference colorAttachmentRef = vk::AttachmentReference()
@@ -44,23 +51,14 @@ void RenderPass::init(Devices& devices, Swapchain& swapchain)
         .setPColorAttachments(&colorAttachmentRef)
         .setPDepthStencilAttachment(&depthAttachmentRef);
 
-    vk::SubpassDependency dependency = vk::SubpassDependency()
-        .setSrcSubpass(VK_SUBPASS_EXTERNAL)
-        .setDstSubpass(0)
-        .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests)
-        .setSrcAccessMask(vk::AccessFlagBits::eNone)
-        .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests)
-        .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
-
+    // Layout transitions and external dependencies are recorded by the render graph around the pass.
     std::array<vk::AttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 
     vk::RenderPassCreateInfo renderPassInfo = vk::RenderPassCreateInfo()
         .setAttachmentCount(static_cast<uint32_t>(attachments.size()))
         .setAttachments(attachments)
         .setSubpassCount(1)
-        .setPSubpasses(&subpass)
-        .setDependencyCount(1)
-        .setPDependencies(&dependency);
+        .setPSubpasses(&subpass);
 
     if (devices.getDevice()->createRenderPass(&renderPassInfo, nullptr, &renderPassRef) != vk::Result::eSuccess)
     {
@@ -68,20 +66,105 @@ void RenderPass::init(Devices& devices, Swapchain& swapchain)
     }
 }
 
-vk::RenderPassBeginInfo RenderPass::createInfo(Swapchain& swapchain, const vk::Extent2D& extent, uint32_t imageIndex)
+bool RenderPass::isDynamicRendering() const
 {
+    return this->dynamicRendering;
+}
+
+void RenderPass::begin(const vk::CommandBuffer& commandBuffer, Swapchain& swapchain, uint32_t imageIndex, const vk::ImageView& depthImageView,
+    const vk::Extent2D& extent, bool secondaryContents)
+{
+    vk::ClearValue colorClear{ vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 1.0f } };
+    vk::ClearValue depthClear{ vk::ClearDepthStencilValue{ 1.0f, 0 } };
+    vk::Rect2D renderArea{ {0, 0}, extent };
+
+    if (this->dynamicRendering)
+    {
+        // Same load/store behaviour as the legacy attachments; layouts are handled by the render graph.
+        vk::RenderingAttachmentInfo colorAttachment = vk::RenderingAttachmentInfo()
+            .setImageView(swapchain.getImageView(imageIndex))
+            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setClearValue(colorClear);
+
+        vk::RenderingAttachmentInfo depthAttachment = vk::RenderingAttachmentInfo()
+            .setImageView(depthImageView)
+            .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+            .setClearValue(depthClear);
+
+        vk::RenderingInfo renderingInfo = vk::RenderingInfo()
+            .setRenderArea(renderArea)
+            .setLayerCount(1)
+            .setColorAttachments(colorAttachment)
+            .setPDepthAttachment(&depthAttachment);
+
+        if (secondaryContents)
+        {
+            renderingInfo.setFlags(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+        }
+
+        commandBuffer.beginRendering(renderingInfo);
+        return;
+    }
+
     vk::Framebuffer framebuffer;
     swapchain.getFramebuffer(imageIndex, framebuffer);
 
-    vk::ClearValue clearColor{ {0.0f, 0.0f, 0.0f, 1.0f} };
-    vk::RenderPassBeginInfo result = vk::RenderPassBeginInfo()
+    std::array<vk::ClearValue, 2> clearValues = { colorClear, depthClear };
+    vk::RenderPassBeginInfo renderPassInfo = vk::RenderPassBeginInfo()
         .setRenderPass(renderPassRef)
         .setFramebuffer(framebuffer)
-        .setRenderArea(vk::Rect2D{ {0, 0}, extent })
-        .setClearValueCount(1)
-        .setPClearValues(&clearColor);
+        .setRenderArea(renderArea)
+        .setClearValues(clearValues);
 
-    return result;
+    commandBuffer.beginRenderPass(renderPassInfo, secondaryContents ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+}
+
+void RenderPass::end(const vk::CommandBuffer& commandBuffer)
+{
+    if (this->dynamicRendering)
+    {
+        commandBuffer.endRendering();
+    }
+    else
+    {
+        commandBuffer.endRenderPass();
+    }
+}
+
+void RenderPass::fillInheritanceInfo(Swapchain& swapchain, uint32_t imageIndex, vk::CommandBufferInheritanceInfo& inheritanceInfo,
+    vk::CommandBufferInheritanceRenderingInfo& renderingInfo)
+{
+    if (this->dynamicRendering)
+    {
+        // Secondaries inherit attachment formats instead of a render pass and framebuffer.
+        renderingInfo = vk::CommandBufferInheritanceRenderingInfo()
+            .setColorAttachmentFormats(this->colorFormat)
+            .setDepthAttachmentFormat(this->depthFormat)
+            .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+        inheritanceInfo = vk::CommandBufferInheritanceInfo()
+            .setPNext(&renderingInfo);
+        return;
+    }
+
+    vk::Framebuffer framebuffer;
+    swapchain.getFramebuffer(imageIndex, framebuffer);
+
+    inheritanceInfo = vk::CommandBufferInheritanceInfo()
+        .setRenderPass(renderPassRef)
+        .setSubpass(0)
+        .setFramebuffer(framebuffer);
+}
+
+vk::PipelineRenderingCreateInfo RenderPass::getPipelineRenderingInfo()
+{
+    return vk::PipelineRenderingCreateInfo()
+        .setColorAttachmentFormats(this->colorFormat)
+        .setDepthAttachmentFormat(this->depthFormat);
 }
 
 vk::RenderPass& RenderPass::getRenderPassRef()
@@ -91,5 +174,9 @@ vk::RenderPass& RenderPass::getRenderPassRef()
 
 void RenderPass::release(vk::Device* logicalDevice)
 {
-    logicalDevice->destroyRenderPass(renderPassRef);
+    if (renderPassRef)
+    {
+        logicalDevice->destroyRenderPass(renderPassRef);
+        renderPassRef = nullptr;
+    }
 }
@@ -6,18 +6,31 @@
 class Swapchain;
 class Devices;
 
-namespace vk
-{
-	struct RenderPassBeginInfo;
-}
-
+/*
+* Begins and ends the main pass. With Vulkan 1.3 dynamic rendering it renders straight into the
+* image views, so there is no render pass object and no framebuffers to rebuild on resize;
+* otherwise it falls back to a classic render pass plus the swapchain's framebuffers.
+*/
 class RenderPass
 {
+private:
+	bool dynamicRendering = false;
+	vk::Format colorFormat;
+	vk::Format depthFormat;
+
 private:
 	void init(Devices& devices, Swapchain& swapchain);
-	vk::RenderPassBeginInfo createInfo(Swapchain& swapchain, const vk::Extent2D& extent, uint32_t imageIndex);
+	bool isDynamicRendering() const;
+	void begin(const vk::CommandBuffer& commandBuffer, Swapchain& swapchain, uint32_t imageIndex, const vk::ImageView& depthImageView,
+		const vk::Extent2D& extent, bool secondaryContents);
+	void end(const vk::CommandBuffer& commandBuffer);
+	void fillInheritanceInfo(Swapchain& swapchain, uint32_t imageIndex, vk::CommandBufferInheritanceInfo& inheritanceInfo,
+		vk::CommandBufferInheritanceRenderingInfo& renderingInfo);
+	vk::PipelineRenderingCreateInfo getPipelineRenderingInfo();
 	vk::RenderPass& getRenderPassRef();
 	void release(vk::Device* logicalDevice);
 
 friend class VulkanAPI;
+friend class CommandBuffers;
+friend class GraphicsPipelines;
 };
@@ -0,0 +1,75 @@
+#include "SecondaryCommandBuffers.h"
+
+#include <vulkan/vulkan.hpp>
+
+// One pool and one secondary buffer per (frame in flight, recording slot), indexed frame * slotCount + slot.
+// A slot is only ever recorded by one thread at a time, so the pools need no locking.
+std::vector<vk::CommandPool> secondaryCommandPools;
+std::vector<vk::CommandBuffer> secondaryCommandBuffers;
+
+void SecondaryCommandBuffers::init(vk::Device* logicalDevice, uint32_t queueFamilyIndex, int maxFramesInFlight, uint32_t slotCount)
+{
+    this->logicalDevice = logicalDevice;
+    this->slotCount = slotCount;
+
+    vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(queueFamilyIndex);
+
+    uint32_t poolCount = static_cast<uint32_t>(maxFramesInFlight) * slotCount;
+    secondaryCommandPools.resize(poolCount);
+    secondaryCommandBuffers.resize(poolCount);
+
+    for (uint32_t i = 0; i < poolCount; i++)
+    {
+        secondaryCommandPools[i] = logicalDevice->createCommandPool(poolInfo);
+
+        vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
+            .setCommandPool(secondaryCommandPools[i])
+            .setLevel(vk::CommandBufferLevel::eSecondary)
+            .setCommandBufferCount(1);
+
+        secondaryCommandBuffers[i] = logicalDevice->allocateCommandBuffers(allocInfo).front();
+    }
+}
+
+void SecondaryCommandBuffers::resetFrame(uint32_t frameIndex)
+{
+    for (uint32_t slot = 0; slot < this->slotCount; slot++)
+    {
+        this->logicalDevice->resetCommandPool(secondaryCommandPools[(frameIndex * this->slotCount) + slot]);
+    }
+}
+
+const vk::CommandBuffer& SecondaryCommandBuffers::begin(uint32_t frameIndex, uint32_t slot, const vk::CommandBufferInheritanceInfo& inheritanceInfo)
+{
+    vk::CommandBuffer& commandBuffer = secondaryCommandBuffers[(frameIndex * this->slotCount) + slot];
+
+    vk::CommandBufferBeginInfo beginInfo = vk::CommandBufferBeginInfo()
+        .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+        .setPInheritanceInfo(&inheritanceInfo);
+
+    commandBuffer.begin(beginInfo);
+    return commandBuffer;
+}
+
+const vk::CommandBuffer* SecondaryCommandBuffers::getCommandBuffers(uint32_t frameIndex)
+{
+    return &secondaryCommandBuffers[frameIndex * this->slotCount];
+}
+
+uint32_t SecondaryCommandBuffers::getSlotCount() const
+{
+    return this->slotCount;
+}
+
+void SecondaryCommandBuffers::release()
+{
+    for (vk::CommandPool& commandPool : secondaryCommandPools)
+    {
+        this->logicalDevice->destroyCommandPool(commandPool);
+    }
+
+    secondaryCommandPools.clear();
+    secondaryCommandBuffers.clear();
+}
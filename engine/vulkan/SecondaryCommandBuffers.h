@@ -0,0 +1,20 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+class SecondaryCommandBuffers
+{
+private:
+	vk::Device* logicalDevice = nullptr;
+	uint32_t slotCount = 0;
+
+private:
+	void init(vk::Device* logicalDevice, uint32_t queueFamilyIndex, int maxFramesInFlight, uint32_t slotCount);
+	void resetFrame(uint32_t frameIndex);
+	const vk::CommandBuffer& begin(uint32_t frameIndex, uint32_t slot, const vk::CommandBufferInheritanceInfo& inheritanceInfo);
+	const vk::CommandBuffer* getCommandBuffers(uint32_t frameIndex);
+	uint32_t getSlotCount() const;
+	void release();
+
+friend class CommandBuffers;
+};
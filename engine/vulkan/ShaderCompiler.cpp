@@ -0,0 +1,260 @@
+#include "ShaderCompiler.h"
+
+#include "engine/Utils.h"
+
+#if defined(ENGINE_RUNTIME_SHADERS)
+#include <shaderc/shaderc.hpp>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(ENGINE_RUNTIME_SHADERS)
+
+// Resolves #include relative to the including file and records every file it opens.
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+{
+private:
+    struct IncludeData
+    {
+        std::string name;
+        std::string content;
+    };
+
+    std::vector<std::string>* includedFiles;
+
+public:
+    ShaderIncluder(std::vector<std::string>* includedFiles) : includedFiles(includedFiles)
+    {
+    }
+
+    shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+    {
+        std::filesystem::path path = requestedSource;
+        if (type == shaderc_include_type_relative)
+        {
+            path = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+        }
+
+        IncludeData* data = new IncludeData();
+        data->name = ShaderCompiler::normalizePath(path.string());
+
+        std::ifstream file(data->name, std::ios::binary);
+        if (file.is_open())
+        {
+            std::stringstream content;
+            content << file.rdbuf();
+            data->content = content.str();
+            this->includedFiles->push_back(data->name);
+        }
+        else
+        {
+            // An empty source name tells shaderc the include failed; the content is the message.
+            data->content = "Couldn't open include file " + data->name;
+            data->name.clear();
+        }
+
+        shaderc_include_result* result = new shaderc_include_result();
+        result->source_name = data->name.c_str();
+        result->source_name_length = data->name.size();
+        result->content = data->content.c_str();
+        result->content_length = data->content.size();
+        result->user_data = data;
+
+        return result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override
+    {
+        delete static_cast<IncludeData*>(result->user_data);
+        delete result;
+    }
+};
+
+// Macros are already expanded in the preprocessed source, so these are the only options the cache hash needs beyond it.
+const shaderc_target_env TARGET_ENVIRONMENT = shaderc_target_env_vulkan;
+const shaderc_env_version TARGET_ENVIRONMENT_VERSION = shaderc_env_version_vulkan_1_0;
+const shaderc_optimization_level OPTIMIZATION_LEVEL = shaderc_optimization_level_performance;
+
+shaderc_shader_kind getShaderKind(ShaderStage stage)
+{
+    switch (stage)
+    {
+    case ShaderStage::Vertex: return shaderc_glsl_vertex_shader;
+    case ShaderStage::Fragment: return shaderc_glsl_fragment_shader;
+    default: return shaderc_glsl_compute_shader;
+    }
+}
+
+#endif
+
+// FNV-1a over the preprocessed source, so edits to an include change the hash too, followed by the
+// stage and the compile options that shape the SPIR-V.
+uint64_t hashSource(const std::string& source, ShaderStage stage, const std::vector<uint32_t>& options)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : source)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+
+    hash ^= static_cast<uint64_t>(stage);
+    hash *= 1099511628211ull;
+
+    for (uint32_t option : options)
+    {
+        hash ^= option;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+void ShaderCompiler::init(const std::string& cacheDirectory)
+{
+    this->cacheDirectory = cacheDirectory;
+
+    if (this->isAvailable())
+    {
+        std::filesystem::create_directories(this->cacheDirectory);
+    }
+}
+
+bool ShaderCompiler::isAvailable() const
+{
+#if defined(ENGINE_RUNTIME_SHADERS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<char> ShaderCompiler::loadShader(const std::string& sourcePath, ShaderStage stage, const std::string& precompiledPath)
+{
+    if (!this->isAvailable())
+    {
+        this->dependencies[normalizePath(sourcePath)] = { normalizePath(sourcePath) };
+        return Utils::readFile(precompiledPath);
+    }
+
+    return this->compile(sourcePath, stage);
+}
+
+std::vector<char> ShaderCompiler::compile(const std::string& sourcePath, ShaderStage stage)
+{
+#if defined(ENGINE_RUNTIME_SHADERS)
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::string path = normalizePath(sourcePath);
+    std::vector<char> sourceData = Utils::readFile(path);
+    std::string source(sourceData.begin(), sourceData.end());
+
+    std::vector<std::string> includedFiles = { path };
+    shaderc::CompileOptions options;
+    options.SetIncluder(std::make_unique<ShaderIncluder>(&includedFiles));
+    options.SetTargetEnvironment(TARGET_ENVIRONMENT, TARGET_ENVIRONMENT_VERSION);
+    options.SetOptimizationLevel(OPTIMIZATION_LEVEL);
+
+    shaderc::Compiler compiler;
+    shaderc::PreprocessedSourceCompilationResult preprocessed = compiler.PreprocessGlsl(source, getShaderKind(stage), path.c_str(), options);
+    if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+        throw std::runtime_error("Failed to preprocess shader: " + preprocessed.GetErrorMessage());
+    }
+
+    // Dependencies are known once preprocessing has followed every include.
+    this->dependencies[path] = includedFiles;
+
+    std::string preprocessedSource(preprocessed.cbegin(), preprocessed.cend());
+    std::vector<uint32_t> hashedOptions =
+    {
+        static_cast<uint32_t>(TARGET_ENVIRONMENT),
+        static_cast<uint32_t>(TARGET_ENVIRONMENT_VERSION),
+        static_cast<uint32_t>(OPTIMIZATION_LEVEL)
+    };
+    uint64_t hash = hashSource(preprocessedSource, stage, hashedOptions);
+    char hashName[32];
+    snprintf(hashName, sizeof(hashName), "%016llx.spv", static_cast<unsigned long long>(hash));
+    std::filesystem::path cachePath = std::filesystem::path(this->cacheDirectory) / hashName;
+
+    if (std::filesystem::exists(cachePath))
+    {
+        std::vector<char> code = Utils::readFile(cachePath.string());
+
+        // Preprocessing still ran, so a hit is timed too; otherwise the time of an older compile would be reported.
+        auto endTime = std::chrono::high_resolution_clock::now();
+        this->stats.cacheHits++;
+        this->stats.lastCompileMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+        return code;
+    }
+
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(preprocessedSource, getShaderKind(stage), path.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+    {
+        throw std::runtime_error("Failed to compile shader: " + result.GetErrorMessage());
+    }
+
+    std::vector<char> code(reinterpret_cast<const char*>(result.cbegin()), reinterpret_cast<const char*>(result.cend()));
+
+    std::ofstream cacheFile(cachePath, std::ios::binary);
+    cacheFile.write(code.data(), code.size());
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    this->stats.compileCount++;
+    this->stats.lastCompileMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+    return code;
+#else
+    throw std::runtime_error("Runtime shader compilation isn't available in this build!");
+#endif
+}
+
+bool ShaderCompiler::dependsOn(const std::string& sourcePath, const std::string& changedPath) const
+{
+    auto entry = this->dependencies.find(normalizePath(sourcePath));
+    if (entry == this->dependencies.end())
+    {
+        return false;
+    }
+
+    std::string changed = normalizePath(changedPath);
+    for (const std::string& dependency : entry->second)
+    {
+        if (dependency == changed)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ShaderCompiler::recordReload(bool succeeded, double compileMs)
+{
+    if (succeeded)
+    {
+        this->stats.reloadCount++;
+        this->stats.lastReloadMs = compileMs;
+    }
+    else
+    {
+        this->stats.failedReloadCount++;
+    }
+}
+
+const ShaderCompileStats& ShaderCompiler::getStats() const
+{
+    return this->stats;
+}
+
+std::string ShaderCompiler::normalizePath(const std::string& path)
+{
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class ShaderStage
+{
+	Vertex,
+	Fragment,
+	Compute
+};
+
+struct ShaderCompileStats
+{
+	uint32_t compileCount = 0;
+	uint32_t cacheHits = 0;
+	// Time of the last compile() call, whether it compiled or was served from the cache.
+	double lastCompileMs = 0.0;
+	uint32_t reloadCount = 0;
+	uint32_t failedReloadCount = 0;
+	// Compile time of the shaders swapped in by the last successful hot reload.
+	double lastReloadMs = 0.0;
+};
+
+/*
+* Compiles GLSL to SPIR-V in-process with shaderc when ENGINE_RUNTIME_SHADERS is defined. #include
+* is resolved relative to the including file, and compiled SPIR-V is cached on disk under the hash
+* of the preprocessed source and compile options, so unchanged shaders (and their includes) are
+* never recompiled.
+* Builds without shaderc load the precompiled .spv files instead.
+*/
+class ShaderCompiler
+{
+private:
+	std::string cacheDirectory;
+	// Source path -> every file it was built from, including itself.
+	std::unordered_map<std::string, std::vector<std::string>> dependencies;
+	ShaderCompileStats stats;
+
+private:
+	void init(const std::string& cacheDirectory);
+	bool isAvailable() const;
+	std::vector<char> loadShader(const std::string& sourcePath, ShaderStage stage, const std::string& precompiledPath);
+	std::vector<char> compile(const std::string& sourcePath, ShaderStage stage);
+	bool dependsOn(const std::string& sourcePath, const std::string& changedPath) const;
+	void recordReload(bool succeeded, double compileMs);
+	const ShaderCompileStats& getStats() const;
+	static std::string normalizePath(const std::string& path);
+
+friend class VulkanAPI;
+};
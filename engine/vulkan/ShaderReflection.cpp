@@ -0,0 +1,527 @@
+#include "ShaderReflection.h"
+#include "Vertex.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const uint32_t SPIRV_HEADER_WORDS = 5;
+
+// The subset of SPIR-V opcodes, decorations and enums reflection needs.
+enum SpvOp : uint32_t
+{
+    OpEntryPoint = 15,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpTypeAccelerationStructureKHR = 5341
+};
+
+enum SpvDecoration : uint32_t
+{
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBuiltIn = 11,
+    DecorationLocation = 30,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35
+};
+
+enum SpvStorageClass : uint32_t
+{
+    StorageUniformConstant = 0,
+    StorageInput = 1,
+    StorageUniform = 2,
+    StoragePushConstant = 9,
+    StorageStorageBuffer = 12
+};
+
+const uint32_t SPV_DIM_BUFFER = 5;
+const uint32_t SPV_DIM_SUBPASS_DATA = 6;
+const uint32_t NOT_DECORATED = UINT32_MAX;
+
+struct SpvType
+{
+    uint32_t opcode = 0;
+    // Operands after the result id.
+    std::vector<uint32_t> operands;
+};
+
+struct SpvMemberDecorations
+{
+    uint32_t offset = 0;
+    uint32_t matrixStride = 0;
+};
+
+struct SpvDecorations
+{
+    uint32_t set = NOT_DECORATED;
+    uint32_t binding = NOT_DECORATED;
+    uint32_t location = NOT_DECORATED;
+    uint32_t arrayStride = 0;
+    bool builtIn = false;
+    bool block = false;
+    bool bufferBlock = false;
+    std::vector<SpvMemberDecorations> members;
+};
+
+struct SpvVariable
+{
+    uint32_t id = 0;
+    uint32_t pointerType = 0;
+    uint32_t storageClass = 0;
+};
+
+struct SpvModule
+{
+    uint32_t stageFlags = 0;
+    std::vector<SpvType> types;
+    std::vector<uint32_t> constants;
+    std::vector<SpvDecorations> decorations;
+    std::vector<SpvVariable> variables;
+};
+
+uint32_t toStageFlags(uint32_t executionModel)
+{
+    switch (executionModel)
+    {
+    case 0: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eVertex);
+    case 1: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eTessellationControl);
+    case 2: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eTessellationEvaluation);
+    case 3: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eGeometry);
+    case 4: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eFragment);
+    case 5: return static_cast<uint32_t>(vk::ShaderStageFlagBits::eCompute);
+    default: throw std::runtime_error("Unsupported shader execution model!");
+    }
+}
+
+SpvMemberDecorations& getMember(SpvDecorations& decorations, uint32_t member)
+{
+    if (decorations.members.size() <= member)
+    {
+        decorations.members.resize(member + 1);
+    }
+
+    return decorations.members[member];
+}
+
+SpvModule parseModule(const std::vector<char>& code)
+{
+    if (((code.size() % sizeof(uint32_t)) != 0) || (code.size() < (SPIRV_HEADER_WORDS * sizeof(uint32_t))))
+    {
+        throw std::runtime_error("Invalid SPIR-V size!");
+    }
+
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    memcpy(words.data(), code.data(), code.size());
+
+    if (words[0] != SPIRV_MAGIC)
+    {
+        throw std::runtime_error("Invalid SPIR-V magic number!");
+    }
+
+    uint32_t idBound = words[3];
+    SpvModule result;
+    result.types.resize(idBound);
+    result.constants.resize(idBound, 0);
+    result.decorations.resize(idBound);
+
+    size_t position = SPIRV_HEADER_WORDS;
+    while (position < words.size())
+    {
+        uint32_t wordCount = words[position] >> 16;
+        uint32_t opcode = words[position] & 0xffff;
+        if ((wordCount == 0) || ((position + wordCount) > words.size()))
+        {
+            throw std::runtime_error("Malformed SPIR-V instruction!");
+        }
+
+        const uint32_t* operands = &words[position + 1];
+        uint32_t operandCount = wordCount - 1;
+
+        switch (opcode)
+        {
+        case OpEntryPoint:
+            // Only single entry point modules are used, so the first one decides the stage.
+            if (result.stageFlags == 0)
+            {
+                result.stageFlags = toStageFlags(operands[0]);
+            }
+            break;
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+        case OpTypeAccelerationStructureKHR:
+            result.types[operands[0]].opcode = opcode;
+            result.types[operands[0]].operands.assign(operands + 1, operands + operandCount);
+            break;
+        case OpConstant:
+            result.constants[operands[1]] = operands[2];
+            break;
+        case OpVariable:
+            result.variables.push_back({ operands[1], operands[0], operands[2] });
+            break;
+        case OpDecorate:
+        {
+            SpvDecorations& decorations = result.decorations[operands[0]];
+            uint32_t value = (operandCount > 2) ? operands[2] : 0;
+            switch (operands[1])
+            {
+            case DecorationBlock: decorations.block = true; break;
+            case DecorationBufferBlock: decorations.bufferBlock = true; break;
+            case DecorationArrayStride: decorations.arrayStride = value; break;
+            case DecorationBuiltIn: decorations.builtIn = true; break;
+            case DecorationLocation: decorations.location = value; break;
+            case DecorationBinding: decorations.binding = value; break;
+            case DecorationDescriptorSet: decorations.set = value; break;
+            default: break;
+            }
+            break;
+        }
+        case OpMemberDecorate:
+            if (operands[2] == DecorationOffset)
+            {
+                getMember(result.decorations[operands[0]], operands[1]).offset = operands[3];
+            }
+            else if (operands[2] == DecorationMatrixStride)
+            {
+                getMember(result.decorations[operands[0]], operands[1]).matrixStride = operands[3];
+            }
+            break;
+        default:
+            break;
+        }
+
+        position += wordCount;
+    }
+
+    return result;
+}
+
+// Byte size of a type inside a push constant block, following the explicit layout decorations.
+uint32_t getTypeSize(const SpvModule& module, uint32_t typeId, uint32_t matrixStride)
+{
+    const SpvType& type = module.types[typeId];
+    switch (type.opcode)
+    {
+    case OpTypeInt:
+    case OpTypeFloat:
+        return type.operands[0] / 8;
+    case OpTypeVector:
+        return type.operands[1] * getTypeSize(module, type.operands[0], 0);
+    case OpTypeMatrix:
+        return type.operands[1] * ((matrixStride > 0) ? matrixStride : getTypeSize(module, type.operands[0], 0));
+    case OpTypeArray:
+        return module.constants[type.operands[1]] * module.decorations[typeId].arrayStride;
+    case OpTypeStruct:
+    {
+        const SpvDecorations& decorations = module.decorations[typeId];
+        uint32_t size = 0;
+        for (uint32_t i = 0; i < type.operands.size(); i++)
+        {
+            SpvMemberDecorations member = (i < decorations.members.size()) ? decorations.members[i] : SpvMemberDecorations();
+            size = std::max(size, member.offset + getTypeSize(module, type.operands[i], member.matrixStride));
+        }
+        return size;
+    }
+    default:
+        return 0;
+    }
+}
+
+uint32_t getDescriptorType(const SpvModule& module, uint32_t typeId, uint32_t storageClass)
+{
+    const SpvType& type = module.types[typeId];
+
+    if (storageClass == StorageStorageBuffer)
+    {
+        return static_cast<uint32_t>(vk::DescriptorType::eStorageBuffer);
+    }
+
+    if (storageClass == StorageUniform)
+    {
+        return static_cast<uint32_t>(module.decorations[typeId].bufferBlock ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer);
+    }
+
+    switch (type.opcode)
+    {
+    case OpTypeSampler:
+        return static_cast<uint32_t>(vk::DescriptorType::eSampler);
+    case OpTypeSampledImage:
+        return static_cast<uint32_t>(vk::DescriptorType::eCombinedImageSampler);
+    case OpTypeAccelerationStructureKHR:
+        return static_cast<uint32_t>(vk::DescriptorType::eAccelerationStructureKHR);
+    case OpTypeImage:
+    {
+        // Operands: sampled type, dim, depth, arrayed, multisampled, sampled (1 = sampled, 2 = storage).
+        uint32_t dim = type.operands[1];
+        bool sampled = (type.operands[5] == 1);
+        if (dim == SPV_DIM_BUFFER)
+        {
+            return static_cast<uint32_t>(sampled ? vk::DescriptorType::eUniformTexelBuffer : vk::DescriptorType::eStorageTexelBuffer);
+        }
+        if (dim == SPV_DIM_SUBPASS_DATA)
+        {
+            return static_cast<uint32_t>(vk::DescriptorType::eInputAttachment);
+        }
+        return static_cast<uint32_t>(sampled ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageImage);
+    }
+    default:
+        throw std::runtime_error("Unsupported descriptor type in shader!");
+    }
+}
+
+uint32_t getVertexFormat(const SpvModule& module, uint32_t typeId)
+{
+    const SpvType& type = module.types[typeId];
+    uint32_t componentCount = 1;
+    const SpvType* component = &type;
+    if (type.opcode == OpTypeVector)
+    {
+        componentCount = type.operands[1];
+        component = &module.types[type.operands[0]];
+    }
+
+    static const vk::Format floatFormats[] = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+    static const vk::Format intFormats[] = { vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint };
+    static const vk::Format uintFormats[] = { vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint };
+
+    if ((componentCount < 1) || (componentCount > 4) || (component->operands[0] != 32))
+    {
+        throw std::runtime_error("Unsupported vertex input type in shader!");
+    }
+
+    if (component->opcode == OpTypeFloat)
+    {
+        return static_cast<uint32_t>(floatFormats[componentCount - 1]);
+    }
+
+    bool isSigned = (component->operands[1] != 0);
+    return static_cast<uint32_t>(isSigned ? intFormats[componentCount - 1] : uintFormats[componentCount - 1]);
+}
+
+bool ReflectedBinding::operator==(const ReflectedBinding& other) const
+{
+    return (this->set == other.set) && (this->binding == other.binding) && (this->descriptorType == other.descriptorType) &&
+        (this->count == other.count) && (this->stageFlags == other.stageFlags);
+}
+
+bool ReflectedPushConstantRange::operator==(const ReflectedPushConstantRange& other) const
+{
+    return (this->offset == other.offset) && (this->size == other.size) && (this->stageFlags == other.stageFlags);
+}
+
+uint32_t ShaderLayout::getSetCount() const
+{
+    uint32_t result = 0;
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        result = std::max(result, binding.set + 1);
+    }
+
+    return result;
+}
+
+std::vector<ReflectedBinding> ShaderLayout::getSetBindings(uint32_t set) const
+{
+    std::vector<ReflectedBinding> result;
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        if (binding.set == set)
+        {
+            result.push_back(binding);
+        }
+    }
+
+    return result;
+}
+
+const ReflectedBinding* ShaderLayout::findBinding(uint32_t set, uint32_t descriptorType) const
+{
+    for (const ReflectedBinding& binding : this->bindings)
+    {
+        if ((binding.set == set) && (binding.descriptorType == descriptorType))
+        {
+            return &binding;
+        }
+    }
+
+    return nullptr;
+}
+
+namespace ShaderReflection
+{
+
+ShaderLayout reflect(const std::vector<char>& code)
+{
+    SpvModule module = parseModule(code);
+
+    ShaderLayout result;
+    result.stageFlags = module.stageFlags;
+
+    for (const SpvVariable& variable : module.variables)
+    {
+        const SpvDecorations& decorations = module.decorations[variable.id];
+        uint32_t typeId = module.types[variable.pointerType].operands[1];
+
+        switch (variable.storageClass)
+        {
+        case StorageUniformConstant:
+        case StorageUniform:
+        case StorageStorageBuffer:
+        {
+            ReflectedBinding binding;
+            binding.set = (decorations.set != NOT_DECORATED) ? decorations.set : 0;
+            binding.binding = decorations.binding;
+            binding.stageFlags = module.stageFlags;
+
+            // Arrays of resources become the descriptor count; a runtime array has no fixed count.
+            while (module.types[typeId].opcode == OpTypeArray || module.types[typeId].opcode == OpTypeRuntimeArray)
+            {
+                const SpvType& arrayType = module.types[typeId];
+                binding.count = (arrayType.opcode == OpTypeArray) ? (binding.count * module.constants[arrayType.operands[1]]) : 0;
+                typeId = arrayType.operands[0];
+            }
+
+            binding.descriptorType = getDescriptorType(module, typeId, variable.storageClass);
+            if (decorations.binding != NOT_DECORATED)
+            {
+                result.bindings.push_back(binding);
+            }
+            break;
+        }
+        case StoragePushConstant:
+        {
+            ReflectedPushConstantRange range;
+            const SpvDecorations& typeDecorations = module.decorations[typeId];
+            range.offset = typeDecorations.members.empty() ? 0 : UINT32_MAX;
+            for (const SpvMemberDecorations& member : typeDecorations.members)
+            {
+                range.offset = std::min(range.offset, member.offset);
+            }
+            range.size = getTypeSize(module, typeId, 0) - range.offset;
+            range.stageFlags = module.stageFlags;
+            result.pushConstantRanges.push_back(range);
+            break;
+        }
+        case StorageInput:
+            if ((module.stageFlags == static_cast<uint32_t>(vk::ShaderStageFlagBits::eVertex)) && !decorations.builtIn &&
+                (decorations.location != NOT_DECORATED))
+            {
+                result.vertexInputs.push_back({ decorations.location, getVertexFormat(module, typeId) });
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::sort(result.bindings.begin(), result.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+    {
+        return (a.set != b.set) ? (a.set < b.set) : (a.binding < b.binding);
+    });
+
+    return result;
+}
+
+ShaderLayout merge(const ShaderLayout& first, const ShaderLayout& second)
+{
+    ShaderLayout result = first;
+    result.stageFlags |= second.stageFlags;
+
+    for (const ReflectedBinding& binding : second.bindings)
+    {
+        auto existing = std::find_if(result.bindings.begin(), result.bindings.end(), [&binding](const ReflectedBinding& other)
+        {
+            return (other.set == binding.set) && (other.binding == binding.binding);
+        });
+
+        if (existing == result.bindings.end())
+        {
+            result.bindings.push_back(binding);
+        }
+        else if ((existing->descriptorType != binding.descriptorType) || (existing->count != binding.count))
+        {
+            throw std::runtime_error("Shader stages disagree on descriptor set " + std::to_string(binding.set) +
+                " binding " + std::to_string(binding.binding) + "!");
+        }
+        else
+        {
+            existing->stageFlags |= binding.stageFlags;
+        }
+    }
+
+    std::sort(result.bindings.begin(), result.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b)
+    {
+        return (a.set != b.set) ? (a.set < b.set) : (a.binding < b.binding);
+    });
+
+    // Vulkan allows each stage in only one range, so all stages share a single range covering every block.
+    std::vector<ReflectedPushConstantRange> ranges = first.pushConstantRanges;
+    ranges.insert(ranges.end(), second.pushConstantRanges.begin(), second.pushConstantRanges.end());
+    result.pushConstantRanges.clear();
+    if (!ranges.empty())
+    {
+        ReflectedPushConstantRange combined = ranges[0];
+        uint32_t end = combined.offset + combined.size;
+        for (const ReflectedPushConstantRange& range : ranges)
+        {
+            combined.offset = std::min(combined.offset, range.offset);
+            end = std::max(end, range.offset + range.size);
+            combined.stageFlags |= range.stageFlags;
+        }
+        combined.size = end - combined.offset;
+        result.pushConstantRanges.push_back(combined);
+    }
+
+    result.vertexInputs.insert(result.vertexInputs.end(), second.vertexInputs.begin(), second.vertexInputs.end());
+
+    return result;
+}
+
+void checkVertexInputs(const ShaderLayout& layout)
+{
+    std::array<vk::VertexInputAttributeDescription, 3> attributes = Vertex::getAttributeDescriptions();
+
+    for (const ReflectedVertexInput& input : layout.vertexInputs)
+    {
+        auto attribute = std::find_if(attributes.begin(), attributes.end(), [&input](const vk::VertexInputAttributeDescription& description)
+        {
+            return description.location == input.location;
+        });
+
+        if ((attribute == attributes.end()) || (static_cast<uint32_t>(attribute->format) != input.format))
+        {
+            throw std::runtime_error("Vertex shader input at location " + std::to_string(input.location) + " doesn't match the vertex format!");
+        }
+    }
+}
+
+} // namespace
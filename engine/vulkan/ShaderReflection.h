@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Values are the raw Vulkan enums (VkDescriptorType, VkShaderStageFlags, VkFormat) so the
+// reflection data can be used as a cache key without including vulkan.hpp.
+struct ReflectedBinding
+{
+	uint32_t set = 0;
+	uint32_t binding = 0;
+	uint32_t descriptorType = 0;
+	// Zero for a runtime-sized array.
+	uint32_t count = 1;
+	uint32_t stageFlags = 0;
+
+	bool operator==(const ReflectedBinding& other) const;
+};
+
+struct ReflectedPushConstantRange
+{
+	uint32_t offset = 0;
+	uint32_t size = 0;
+	uint32_t stageFlags = 0;
+
+	bool operator==(const ReflectedPushConstantRange& other) const;
+};
+
+struct ReflectedVertexInput
+{
+	uint32_t location = 0;
+	uint32_t format = 0;
+};
+
+// Everything a pipeline layout and vertex input state need to know about a set of shader stages.
+struct ShaderLayout
+{
+	uint32_t stageFlags = 0;
+	std::vector<ReflectedBinding> bindings;
+	std::vector<ReflectedPushConstantRange> pushConstantRanges;
+	std::vector<ReflectedVertexInput> vertexInputs;
+
+	uint32_t getSetCount() const;
+	std::vector<ReflectedBinding> getSetBindings(uint32_t set) const;
+	const ReflectedBinding* findBinding(uint32_t set, uint32_t descriptorType) const;
+};
+
+namespace ShaderReflection
+{
+
+// Reads descriptor bindings, the push constant block and vertex inputs straight from SPIR-V.
+ShaderLayout reflect(const std::vector<char>& code);
+
+// Combines stages into one layout; stages that disagree on a binding are an error.
+ShaderLayout merge(const ShaderLayout& first, const ShaderLayout& second);
+
+// Throws if the vertex shader reads an attribute that Vertex doesn't provide.
+void checkVertexInputs(const ShaderLayout& layout);
+
+} // namespace
@@ -1,9 +1,12 @@
 #include "Swapchain.h"
 #include "Devices.h"
+#include "engine/Profiler.h"
 
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
+
 struct SwapChainSupportDetails
 {
     vk::SurfaceCapabilitiesKHR capabilities;
@@ -17,6 +20,12 @@ vk::Extent2D swapchainExtent;
 std::vector<vk::ImageView> swapchainImageViews;
 std::vector<vk::Framebuffer> swapchainFramebuffers;
 
+// Indexed by PresentModePolicy.
+const vk::PresentModeKHR PRESENT_MODES[] =
+{
+    vk::PresentModeKHR::eFifo, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate
+};
+
 void Swapchain::init(const vk::SurfaceKHR& surface, SDL_Window* window, Devices& devices)
 {
     SwapChainSupportDetails swapchainSupport = this->querySwapChainSupport(surface, devices.getPhysicalDevice());
@@ -25,7 +34,7 @@ void Swapchain::init(const vk::SurfaceKHR& surface, SDL_Window* window, Devices&
     vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
     vk::Extent2D extent = chooseSwapExtent(swapchainSupport.capabilities, window);
 
-    uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
+    uint32_t imageCount = swapchainSupport.capabilities.minImageCount + this->extraImageCount;
     if ((swapchainSupport.capabilities.maxImageCount > 0) && (imageCount > swapchainSupport.capabilities.maxImageCount))
     {
         imageCount = swapchainSupport.capabilities.maxImageCount;
@@ -120,6 +129,16 @@ void Swapchain::getFramebuffer(uint32_t index, vk::Framebuffer& result)
     result = swapchainFramebuffers[index];
 }
 
+const vk::Image& Swapchain::getImage(uint32_t index)
+{
+    return swapchainImages[index];
+}
+
+const vk::ImageView& Swapchain::getImageView(uint32_t index)
+{
+    return swapchainImageViews[index];
+}
+
 SwapChainSupportDetails Swapchain::querySwapChainSupport(const vk::SurfaceKHR& surface, const vk::PhysicalDevice* device)
 {
     SwapChainSupportDetails details;
@@ -154,17 +173,63 @@ vk::SurfaceFormatKHR Swapchain::chooseSwapSurfaceFormat(const std::vector<vk::Su
 
 vk::PresentModeKHR Swapchain::chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
 {
-    for (const auto& availablePresentMode : availablePresentModes)
+    // Each policy falls back to the closest mode with the same tearing/latency trade-off;
+    // FIFO is the only mode every implementation has to support.
+    std::vector<PresentModePolicy> preferences;
+    switch (this->presentModePolicy)
     {
-        if (availablePresentMode == vk::PresentModeKHR::eMailbox)
+    case PresentModePolicy::Immediate:
+        preferences = { PresentModePolicy::Immediate, PresentModePolicy::Mailbox };
+        break;
+    case PresentModePolicy::Mailbox:
+        preferences = { PresentModePolicy::Mailbox };
+        break;
+    case PresentModePolicy::FifoRelaxed:
+        preferences = { PresentModePolicy::FifoRelaxed };
+        break;
+    default:
+        break;
+    }
+
+    for (PresentModePolicy preference : preferences)
+    {
+        vk::PresentModeKHR presentMode = PRESENT_MODES[static_cast<size_t>(preference)];
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end())
         {
-            return availablePresentMode;
+            this->activePresentMode = preference;
+            return presentMode;
         }
     }
 
+    this->activePresentMode = PresentModePolicy::Fifo;
     return vk::PresentModeKHR::eFifo;
 }
 
+void Swapchain::setPresentModePolicy(PresentModePolicy policy)
+{
+    this->presentModePolicy = policy;
+}
+
+PresentModePolicy Swapchain::getActivePresentMode() const
+{
+    return this->activePresentMode;
+}
+
+const char* Swapchain::getPresentModeName(PresentModePolicy mode)
+{
+    switch (mode)
+    {
+    case PresentModePolicy::FifoRelaxed:
+        return "FIFO relaxed";
+    case PresentModePolicy::Mailbox:
+        return "mailbox";
+    case PresentModePolicy::Immediate:
+        return "immediate";
+    default:
+        return "FIFO";
+    }
+}
+
 vk::Extent2D Swapchain::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, SDL_Window* window)
 {
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
@@ -189,9 +254,18 @@ vk::Extent2D Swapchain::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capab
     return actualExtent;
 }
 
+void Swapchain::setExtraImageCount(uint32_t count)
+{
+    this->extraImageCount = count;
+}
+
 void Swapchain::recreate(const vk::SurfaceKHR& surface, SDL_Window* window, Devices& devices)
 {
-    devices.getDevice()->waitIdle();
+    PROFILE_FUNCTION();
+    {
+        PROFILE_ZONE("Swapchain::recreate waitIdle");
+        devices.getDevice()->waitIdle();
+    }
 
     this->release(devices);
 
@@ -207,6 +281,8 @@ void Swapchain::release(Devices& devices)
         logicalDevice->destroyFramebuffer(framebuffer);
     }
 
+    swapchainFramebuffers.clear();
+
     for (const vk::ImageView& imageView : swapchainImageViews)
     {
         logicalDevice->destroyImageView(imageView);
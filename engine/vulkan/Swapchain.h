@@ -8,10 +8,21 @@ class Devices;
 struct SDL_Window;
 struct SwapChainSupportDetails;
 
+enum class PresentModePolicy
+{
+    Fifo,
+    FifoRelaxed,
+    Mailbox,
+    Immediate
+};
+
 class Swapchain
 {
 private:
     std::shared_ptr<vk::SwapchainKHR> swapchainKHR;
+    uint32_t extraImageCount = 1;
+    PresentModePolicy presentModePolicy = PresentModePolicy::Mailbox;
+    PresentModePolicy activePresentMode = PresentModePolicy::Fifo;
 
 private:
 	void init(const vk::SurfaceKHR& surface, SDL_Window* window, Devices& devices);
@@ -21,11 +32,17 @@ private:
     vk::Format getImageFormat();
     const vk::Extent2D& getExtent();
     void getFramebuffer(uint32_t index, vk::Framebuffer& result);
+    const vk::Image& getImage(uint32_t index);
+    const vk::ImageView& getImageView(uint32_t index);
     static SwapChainSupportDetails querySwapChainSupport(const vk::SurfaceKHR& surface, const vk::PhysicalDevice* device);
     static bool isSwapChainAdequate(const vk::SurfaceKHR& surface, const vk::PhysicalDevice* device);
     vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats);
     vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes);
     vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities, SDL_Window* window);
+    void setExtraImageCount(uint32_t count);
+    void setPresentModePolicy(PresentModePolicy policy);
+    PresentModePolicy getActivePresentMode() const;
+    static const char* getPresentModeName(PresentModePolicy mode);
     void recreate(const vk::SurfaceKHR& surface, SDL_Window* window, Devices& devices);
     void release(Devices& devices);
 
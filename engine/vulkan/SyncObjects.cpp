@@ -1,30 +1,66 @@
 #include "SyncObjects.h"
+#include "engine/Profiler.h"
 
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
+#include <algorithm>
+
 std::vector<vk::Semaphore> imageAvailableSemaphores;
 std::vector<vk::Semaphore> renderFinishedSemaphores;
 std::vector<vk::Fence> inFlightFences;
+vk::Semaphore timelineSemaphore;
 
-void SyncObjects::init(vk::Device* logicalDevice, int maxFramesInFlight)
+void SyncObjects::init(vk::Device* logicalDevice, int maxFramesInFlight, bool timelineSupported)
 {
+    this->timelineEnabled = timelineSupported;
+    this->submittedValue = 0;
+    this->completedValue = 0;
+    this->uploadValue = 0;
+    this->frameValues.assign(maxFramesInFlight, 0);
+
     vk::SemaphoreCreateInfo semaphoreInfo;
     vk::FenceCreateInfo fenceInfo = vk::FenceCreateInfo()
         .setFlags(vk::FenceCreateFlagBits::eSignaled);
 
     imageAvailableSemaphores.resize(maxFramesInFlight);
     renderFinishedSemaphores.resize(maxFramesInFlight);
-    inFlightFences.resize(maxFramesInFlight);
 
+    // The swapchain only works with binary semaphores, so those stay even on the timeline path.
     for (size_t i = 0; i < maxFramesInFlight; i++)
     {
         imageAvailableSemaphores[i] = logicalDevice->createSemaphore(semaphoreInfo);
         renderFinishedSemaphores[i] = logicalDevice->createSemaphore(semaphoreInfo);
-        inFlightFences[i] = logicalDevice->createFence(fenceInfo);
+    }
+
+    if (this->timelineEnabled)
+    {
+        vk::SemaphoreTypeCreateInfo typeInfo = vk::SemaphoreTypeCreateInfo()
+            .setSemaphoreType(vk::SemaphoreType::eTimeline)
+            .setInitialValue(0);
+
+        timelineSemaphore = logicalDevice->createSemaphore(vk::SemaphoreCreateInfo().setPNext(&typeInfo));
+    }
+    else
+    {
+        inFlightFences.resize(maxFramesInFlight);
+        for (size_t i = 0; i < maxFramesInFlight; i++)
+        {
+            inFlightFences[i] = logicalDevice->createFence(fenceInfo);
+        }
     }
 }
 
+bool SyncObjects::isTimelineEnabled() const
+{
+    return this->timelineEnabled;
+}
+
+const vk::Semaphore& SyncObjects::getTimelineSemaphore()
+{
+    return timelineSemaphore;
+}
+
 const vk::Semaphore& SyncObjects::getImageSemaphore(int currentFrame)
 {
     return imageAvailableSemaphores[currentFrame];
@@ -40,28 +76,141 @@ const vk::Fence& SyncObjects::getInFlightFence(int currentFrame)
     return inFlightFences[currentFrame];
 }
 
-void SyncObjects::waitForFence(vk::Device* logicalDevice, int currentFrame)
+uint64_t SyncObjects::signalFrame(int currentFrame)
 {
+    this->frameValues[currentFrame] = ++this->submittedValue;
+    return this->submittedValue;
+}
+
+uint64_t SyncObjects::signalUpload()
+{
+    this->uploadValue = ++this->submittedValue;
+    return this->uploadValue;
+}
+
+uint64_t SyncObjects::getUploadValue() const
+{
+    return this->uploadValue;
+}
+
+void SyncObjects::waitForFrame(vk::Device* logicalDevice, int currentFrame)
+{
+    PROFILE_FUNCTION();
+    if (this->timelineEnabled)
+    {
+        this->waitForValue(logicalDevice, this->frameValues[currentFrame]);
+        return;
+    }
+
     if (logicalDevice->waitForFences(1, &inFlightFences[currentFrame], vk::True, UINT64_MAX) != vk::Result::eSuccess)
     {
         throw std::runtime_error("drawFrame() - Couldn't wait for fence!");
     }
+
+    this->completedValue = std::max(this->completedValue, this->frameValues[currentFrame]);
+}
+
+void SyncObjects::waitForValue(vk::Device* logicalDevice, uint64_t value)
+{
+    PROFILE_FUNCTION();
+    if (value <= this->completedValue)
+    {
+        return;
+    }
+
+    vk::SemaphoreWaitInfo waitInfo = vk::SemaphoreWaitInfo()
+        .setSemaphores(timelineSemaphore)
+        .setValues(value);
+
+    if (logicalDevice->waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+    {
+        throw std::runtime_error("Couldn't wait for timeline semaphore!");
+    }
+
+    this->completedValue = value;
+}
+
+uint64_t SyncObjects::pollCompletedValue(vk::Device* logicalDevice)
+{
+    if (this->timelineEnabled)
+    {
+        this->completedValue = std::max(this->completedValue, logicalDevice->getSemaphoreCounterValue(timelineSemaphore));
+        return this->completedValue;
+    }
+
+    for (size_t i = 0; i < inFlightFences.size(); i++)
+    {
+        if (logicalDevice->getFenceStatus(inFlightFences[i]) == vk::Result::eSuccess)
+        {
+            this->completedValue = std::max(this->completedValue, this->frameValues[i]);
+        }
+    }
+
+    return this->completedValue;
 }
 
 void SyncObjects::resetFence(vk::Device* logicalDevice, int currentFrame)
 {
+    if (this->timelineEnabled)
+    {
+        return;
+    }
+
     if (logicalDevice->resetFences(1, &inFlightFences[currentFrame]) != vk::Result::eSuccess)
     {
         throw std::runtime_error("drawFrame() - Couldn't reset fence!");
     }
 }
 
+void SyncObjects::deferDestruction(std::function<void()> destroy)
+{
+    // Anything submitted so far may still reference the resource.
+    if (this->submittedValue <= this->completedValue)
+    {
+        destroy();
+        return;
+    }
+
+    this->pendingDestructions.push_back({ this->submittedValue, std::move(destroy) });
+}
+
+void SyncObjects::collectGarbage(vk::Device* logicalDevice)
+{
+    if (this->pendingDestructions.empty())
+    {
+        return;
+    }
+
+    uint64_t completed = this->pollCompletedValue(logicalDevice);
+
+    auto firstPending = std::stable_partition(this->pendingDestructions.begin(), this->pendingDestructions.end(),
+        [completed](const PendingDestruction& pending) { return pending.value <= completed; });
+
+    for (auto it = this->pendingDestructions.begin(); it != firstPending; ++it)
+    {
+        it->destroy();
+    }
+
+    this->pendingDestructions.erase(this->pendingDestructions.begin(), firstPending);
+}
+
 void SyncObjects::release(vk::Device* logicalDevice, int maxFramesInFlight)
 {
     for (size_t i = 0; i < maxFramesInFlight; i++)
     {
         logicalDevice->destroySemaphore(renderFinishedSemaphores[i]);
         logicalDevice->destroySemaphore(imageAvailableSemaphores[i]);
-        logicalDevice->destroyFence(inFlightFences[i]);
+    }
+
+    for (vk::Fence& fence : inFlightFences)
+    {
+        logicalDevice->destroyFence(fence);
+    }
+
+    inFlightFences.clear();
+
+    if (this->timelineEnabled)
+    {
+        logicalDevice->destroySemaphore(timelineSemaphore);
     }
 }
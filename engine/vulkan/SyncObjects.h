@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <vector>
+
 namespace vk
 {
 	class Device;
@@ -7,16 +11,45 @@ namespace vk
 	class Fence;
 }
 
+/*
+* With timeline semaphores every frame and upload submission signals the next value of a single
+* counter, so completion can be waited on or polled per value; otherwise frames fall back to fences.
+*/
 class SyncObjects
 {
 private:
-	void init(vk::Device* logicalDevice, int maxFramesInFlight);
+	struct PendingDestruction
+	{
+		uint64_t value;
+		std::function<void()> destroy;
+	};
+
+	bool timelineEnabled = false;
+	uint64_t submittedValue = 0;
+	uint64_t completedValue = 0;
+	uint64_t uploadValue = 0;
+	std::vector<uint64_t> frameValues;
+	std::vector<PendingDestruction> pendingDestructions;
+
+private:
+	void init(vk::Device* logicalDevice, int maxFramesInFlight, bool timelineSupported);
+	bool isTimelineEnabled() const;
+	const vk::Semaphore& getTimelineSemaphore();
 	const vk::Semaphore& getImageSemaphore(int currentFrame);
 	const vk::Semaphore& getRenderSemaphore(int currentFrame);
 	const vk::Fence& getInFlightFence(int currentFrame);
-	void waitForFence(vk::Device* logicalDevice, int currentFrame);
+	uint64_t signalFrame(int currentFrame);
+	uint64_t signalUpload();
+	uint64_t getUploadValue() const;
+	void waitForFrame(vk::Device* logicalDevice, int currentFrame);
+	void waitForValue(vk::Device* logicalDevice, uint64_t value);
+	uint64_t pollCompletedValue(vk::Device* logicalDevice);
 	void resetFence(vk::Device* logicalDevice, int currentFrame);
+	void deferDestruction(std::function<void()> destroy);
+	void collectGarbage(vk::Device* logicalDevice);
 	void release(vk::Device* logicalDevice, int maxFramesInFlight);
 
 friend class VulkanAPI;
+friend class CommandBuffers;
+friend class GraphicsPipelines;
 };
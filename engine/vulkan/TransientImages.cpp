@@ -0,0 +1,180 @@
+#include "TransientImages.h"
+#include "Devices.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+std::vector<vk::Image> transientImages;
+std::vector<vk::ImageView> transientImageViews;
+vk::DeviceMemory transientImagesMemory;
+
+uint32_t TransientImages::add(const std::string& name, uint32_t width, uint32_t height, vk::Format format, uint32_t usage,
+    uint32_t aspectMask, uint32_t firstPass, uint32_t lastPass)
+{
+    Description description;
+    description.name = name;
+    description.width = width;
+    description.height = height;
+    description.format = format;
+    description.usage = usage;
+    description.aspectMask = aspectMask;
+    description.firstPass = firstPass;
+    description.lastPass = lastPass;
+
+    this->descriptions.push_back(description);
+    return static_cast<uint32_t>(this->descriptions.size() - 1);
+}
+
+void TransientImages::allocate(Devices& devices)
+{
+    vk::Device* logicalDevice = devices.getDevice();
+    size_t count = this->descriptions.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    transientImages.resize(count);
+    transientImageViews.resize(count);
+
+    std::vector<uint64_t> alignments(count);
+    uint32_t memoryTypeBits = ~0u;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Description& description = this->descriptions[i];
+
+        vk::ImageCreateInfo imageInfo = vk::ImageCreateInfo()
+            .setImageType(vk::ImageType::e2D)
+            .setExtent(vk::Extent3D{ description.width, description.height, 1 })
+            .setMipLevels(1)
+            .setArrayLayers(1)
+            .setFormat(description.format)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setInitialLayout(vk::ImageLayout::eUndefined)
+            .setUsage(vk::ImageUsageFlags(static_cast<vk::ImageUsageFlagBits>(description.usage)) | vk::ImageUsageFlagBits::eTransientAttachment)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        transientImages[i] = logicalDevice->createImage(imageInfo);
+
+        vk::MemoryRequirements memRequirements = logicalDevice->getImageMemoryRequirements(transientImages[i]);
+        description.size = memRequirements.size;
+        alignments[i] = memRequirements.alignment;
+        memoryTypeBits &= memRequirements.memoryTypeBits;
+    }
+
+    this->placeImages(alignments);
+
+    std::optional<uint32_t> memoryType = devices.findOptionalMemoryType(memoryTypeBits,
+        vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated);
+    this->lazilyAllocated = memoryType.has_value();
+    if (!this->lazilyAllocated)
+    {
+        memoryType = devices.findMemoryType(memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+
+    vk::MemoryAllocateInfo allocInfo = vk::MemoryAllocateInfo()
+        .setAllocationSize(this->memorySize)
+        .setMemoryTypeIndex(memoryType.value());
+
+    transientImagesMemory = logicalDevice->allocateMemory(allocInfo);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Description& description = this->descriptions[i];
+        logicalDevice->bindImageMemory(transientImages[i], transientImagesMemory, description.offset);
+
+        transientImageViews[i] = devices.createImageView(transientImages[i], description.format,
+            vk::ImageAspectFlags(static_cast<vk::ImageAspectFlagBits>(description.aspectMask)));
+    }
+}
+
+void TransientImages::placeImages(const std::vector<uint64_t>& alignments)
+{
+    // Largest first, each one at the lowest offset that doesn't collide with an already placed
+    // image that is alive during any of the same passes.
+    std::vector<uint32_t> order(this->descriptions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+    {
+        return this->descriptions[a].size > this->descriptions[b].size;
+    });
+
+    this->memorySize = 0;
+    this->unaliasedSize = 0;
+
+    std::vector<uint32_t> placed;
+    for (uint32_t index : order)
+    {
+        Description& description = this->descriptions[index];
+        uint64_t alignment = std::max<uint64_t>(alignments[index], 1);
+
+        std::vector<std::pair<uint64_t, uint64_t>> occupied;
+        for (uint32_t other : placed)
+        {
+            const Description& otherDescription = this->descriptions[other];
+            bool overlaps = (description.firstPass <= otherDescription.lastPass) && (otherDescription.firstPass <= description.lastPass);
+            if (overlaps)
+            {
+                occupied.push_back({ otherDescription.offset, otherDescription.offset + otherDescription.size });
+            }
+        }
+
+        std::sort(occupied.begin(), occupied.end());
+
+        uint64_t offset = 0;
+        for (const std::pair<uint64_t, uint64_t>& range : occupied)
+        {
+            if (offset + description.size <= range.first)
+            {
+                break;
+            }
+
+            offset = std::max(offset, (range.second + alignment - 1) / alignment * alignment);
+        }
+
+        description.offset = offset;
+        placed.push_back(index);
+
+        this->memorySize = std::max(this->memorySize, offset + description.size);
+        this->unaliasedSize += description.size;
+    }
+}
+
+const vk::Image& TransientImages::getImage(uint32_t index) const
+{
+    return transientImages[index];
+}
+
+vk::ImageView& TransientImages::getImageView(uint32_t index)
+{
+    return transientImageViews[index];
+}
+
+uint32_t TransientImages::getAspectMask(uint32_t index) const
+{
+    return this->descriptions[index].aspectMask;
+}
+
+void TransientImages::release(vk::Device* logicalDevice)
+{
+    for (size_t i = 0; i < transientImages.size(); i++)
+    {
+        logicalDevice->destroyImageView(transientImageViews[i]);
+        logicalDevice->destroyImage(transientImages[i]);
+    }
+
+    if (!transientImages.empty())
+    {
+        logicalDevice->freeMemory(transientImagesMemory);
+    }
+
+    transientImages.clear();
+    transientImageViews.clear();
+    this->descriptions.clear();
+    this->memorySize = 0;
+    this->unaliasedSize = 0;
+}
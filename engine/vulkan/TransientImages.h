@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vk_forward_declarations.h"
+
+#include <string>
+#include <vector>
+
+class Devices;
+
+/*
+* Attachments that only live inside a frame (depth, intermediate targets). They are created with
+* transient usage, backed by lazily allocated memory when the device has it, and images whose pass
+* lifetimes don't overlap are placed at the same offset of a single allocation.
+*/
+class TransientImages
+{
+private:
+	struct Description
+	{
+		std::string name;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		vk::Format format;
+		uint32_t usage = 0;
+		uint32_t aspectMask = 0;
+		uint32_t firstPass = 0;
+		uint32_t lastPass = 0;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+	std::vector<Description> descriptions;
+	bool lazilyAllocated = false;
+	uint64_t memorySize = 0;
+	uint64_t unaliasedSize = 0;
+
+private:
+	uint32_t add(const std::string& name, uint32_t width, uint32_t height, vk::Format format, uint32_t usage,
+		uint32_t aspectMask, uint32_t firstPass, uint32_t lastPass);
+	void allocate(Devices& devices);
+	void placeImages(const std::vector<uint64_t>& alignments);
+	const vk::Image& getImage(uint32_t index) const;
+	vk::ImageView& getImageView(uint32_t index);
+	uint32_t getAspectMask(uint32_t index) const;
+	void release(vk::Device* logicalDevice);
+
+friend class CommandBuffers;
+friend class VulkanAPI;
+};
@@ -1,65 +1,116 @@
 #include "VulkanAPI.h"
 
 #include "engine/Utils.h"
+#include "engine/Profiler.h"
 
+#include <SDL2/SDL_keycode.h>
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vulkan.hpp>
 
 #include <iostream>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <filesystem>
 
 vk::SurfaceKHR surface = nullptr;
 vk::Instance instance = nullptr;
-
-const int MAX_FRAMES_IN_FLIGHT = 2;
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
 
 vk::PipelineLayout pipelineLayout;
-vk::Pipeline graphicsPipeline;
+
+const std::string SHADER_DIRECTORY = "../../shaders/";
 
 void VulkanAPI::init(SDLAPI& sdlApi)
 {
+    PROFILE_FUNCTION();
     this->sdlApi = &sdlApi;
 
     this->createInstance();
     this->debugMessenger.init(instance, nullptr);
     this->createSurface();
-    this->devices.init(instance, surface, this->validationLayers);
+    this->devices.init(instance, instanceApiVersion, surface, this->validationLayers);
+
+    LatencySettings latencySettings = getLatencySettings(this->latencyMode);
+    this->framesInFlight = latencySettings.framesInFlight;
+    this->swapchain.setExtraImageCount(latencySettings.extraSwapchainImages);
     this->swapchain.init(surface, this->sdlApi->window, this->devices);
     this->swapchain.createImageViews(this->devices);
     this->renderPass.init(this->devices, this->swapchain);
 
     vk::Device* logicalDevice = this->devices.getDevice();
 
-    this->descriptorSets.initLayout(logicalDevice);
     this->createGraphicsPipeline();
 
-    this->commandBuffers.init(surface, this->devices, this->swapchain, MAX_FRAMES_IN_FLIGHT);
-    vk::ImageView& depthImageView = this->commandBuffers.getDepthImageView();
-    this->swapchain.createFramebuffers(devices, this->renderPass.getRenderPassRef(), depthImageView);
+    this->syncObjects.init(logicalDevice, this->framesInFlight, this->devices.getCapabilities().timelineSemaphore);
+    this->commandBuffers.init(surface, this->devices, this->swapchain, &this->syncObjects, this->framesInFlight, &this->threadPool);
+    if (this->bindlessDescriptors.isEnabled())
+    {
+        this->commandBuffers.registerBindlessResources(this->devices, &this->bindlessDescriptors);
+    }
+    if (!this->renderPass.isDynamicRendering())
+    {
+        vk::ImageView& depthImageView = this->commandBuffers.getDepthImageView();
+        this->swapchain.createFramebuffers(devices, this->renderPass.getRenderPassRef(), depthImageView);
+    }
 
-    this->descriptorSets.initPool(logicalDevice, MAX_FRAMES_IN_FLIGHT);
+    this->descriptorSets.initPool(logicalDevice, this->framesInFlight);
     this->createDescriptorSets();
-    this->commandBuffers.createCommandBuffers(this->devices.getDevice(), MAX_FRAMES_IN_FLIGHT);
-    this->syncObjects.init(logicalDevice, MAX_FRAMES_IN_FLIGHT);
+    this->commandBuffers.createCommandBuffers(this->devices.getDevice(), this->framesInFlight);
+    this->latencyStats.submitTimes.resize(this->framesInFlight);
 }
 
 void VulkanAPI::drawFrame()
 {
+    PROFILE_FUNCTION();
+    if (this->requestedLatencyMode.has_value())
+    {
+        this->applyLatencyMode(this->requestedLatencyMode.value());
+        this->requestedLatencyMode.reset();
+    }
+
+    // A minimized window has a zero-size surface; no swapchain can be created for it, so skip
+    // all GPU work until it comes back.
+    if (!this->hasDrawableArea())
+    {
+        this->swapchainOutdated = true;
+        return;
+    }
+
+    if (this->swapchainOutdated && !this->recreateSwapchain())
+    {
+        return;
+    }
+
+    auto frameStart = std::chrono::high_resolution_clock::now();
     uint32_t currentFrame = this->commandBuffers.getCurrentFrameIndex();
     vk::Device* logicalDevice = this->devices.getDevice();
-    this->syncObjects.waitForFence(logicalDevice, currentFrame);
+    this->syncObjects.waitForFrame(logicalDevice, currentFrame);
+    this->syncObjects.collectGarbage(logicalDevice);
+
+    // The fence has signaled, so the frame's timestamps are ready without waiting.
+    uint64_t gpuFrameNumber = 0;
+    double gpuTimeMs = 0.0;
+    if (this->commandBuffers.gpuTimer.readFrame(logicalDevice, currentFrame, gpuFrameNumber, gpuTimeMs) && (this->flightRecorder != nullptr))
+    {
+        this->flightRecorder->recordGpuTime(gpuFrameNumber, gpuTimeMs);
+    }
+    this->graphicsPipelines.collectCompletedPipelines();
+    this->recordLatency(frameStart, currentFrame);
+    this->commandBuffers.beginFrame();
 
     vk::SwapchainKHR* swapchainKHR = swapchain.getSwapchainKHR();
     const vk::Semaphore& currentImageSemaphore = this->syncObjects.getImageSemaphore(currentFrame);
     const vk::Semaphore& currentRenderSemaphore = this->syncObjects.getRenderSemaphore(currentFrame);
-    vk::ResultValue<uint32_t> imageIndex = logicalDevice->acquireNextImageKHR(*swapchainKHR, UINT64_MAX, currentImageSemaphore);
+    vk::ResultValue<uint32_t> imageIndex(vk::Result::eSuccess, 0);
+    {
+        PROFILE_ZONE("AcquireNextImage");
+        imageIndex = logicalDevice->acquireNextImageKHR(*swapchainKHR, UINT64_MAX, currentImageSemaphore);
+    }
 
     if (imageIndex.result == vk::Result::eErrorOutOfDateKHR)
     {
-        vk::ImageView& depthImageView = this->commandBuffers.getDepthImageView();
-        this->swapchain.recreate(surface, this->sdlApi->window, this->devices);
-        this->commandBuffers.recreateDepthResources(this->devices, this->swapchain);
-        this->swapchain.createFramebuffers(this->devices, this->renderPass.getRenderPassRef(), depthImageView);
+        this->recreateSwapchain();
         return;
     }
     else if ((imageIndex.result != vk::Result::eSuccess) && (imageIndex.result != vk::Result::eSuboptimalKHR))
@@ -70,35 +121,73 @@ void VulkanAPI::drawFrame()
     this->syncObjects.resetFence(logicalDevice, currentFrame);
 
     const vk::Extent2D& swapchainExtent = this->swapchain.getExtent();
-    this->commandBuffers.updateUniformBuffer(swapchainExtent);
+    this->camera.sampleInput(*this->sdlApi);
+    this->commandBuffers.updateUniformBuffer(swapchainExtent, this->camera.getViewMatrix());
+    this->commandBuffers.frameNumber = (this->flightRecorder != nullptr) ? this->flightRecorder->getFrameNumber() : 0;
 
-    vk::RenderPassBeginInfo& renderPassInfo = this->renderPass.createInfo(this->swapchain, swapchainExtent, imageIndex.value);
-    this->commandBuffers.recordCommandBuffer(swapchainExtent, renderPassInfo, graphicsPipeline,
-        pipelineLayout, &this->descriptorSets.getDescriptorSet(currentFrame));
+    this->commandBuffers.recordCommandBuffer(swapchainExtent, this->renderPass, this->swapchain, imageIndex.value,
+        this->graphicsPipelines, this->mainPipeline, pipelineLayout, this->descriptorSets);
     const vk::CommandBuffer* commandBuffer = this->commandBuffers.getCurrentCommandBuffer();
+    this->updateFrameMetrics();
 
-    vk::Semaphore waitSemaphores[] = { currentImageSemaphore };
-    vk::Semaphore signalSemaphores[] = { currentRenderSemaphore };
-    vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+    // The timeline entries are only used when timeline semaphores are enabled; the binary
+    // semaphores always come first so presentation can keep using signalSemaphores[0].
+    bool timelineEnabled = this->syncObjects.isTimelineEnabled();
+    uint64_t frameValue = this->syncObjects.signalFrame(currentFrame);
+    uint32_t semaphoreCount = timelineEnabled ? 2 : 1;
+
+    vk::Semaphore waitSemaphores[] = { currentImageSemaphore, nullptr };
+    vk::Semaphore signalSemaphores[] = { currentRenderSemaphore, nullptr };
+    vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eAllCommands };
+    uint64_t waitValues[] = { 0, this->syncObjects.getUploadValue() };
+    uint64_t signalValues[] = { 0, frameValue };
 
     vk::SubmitInfo submitInfo = vk::SubmitInfo()
-        .setWaitSemaphoreCount(1)
+        .setWaitSemaphoreCount(semaphoreCount)
         .setPWaitSemaphores(waitSemaphores)
         .setPWaitDstStageMask(waitStages)
         .setCommandBufferCount(1)
         .setPCommandBuffers(commandBuffer)
-        .setSignalSemaphoreCount(1)
+        .setSignalSemaphoreCount(semaphoreCount)
         .setPSignalSemaphores(signalSemaphores);
 
+    vk::TimelineSemaphoreSubmitInfo timelineInfo = vk::TimelineSemaphoreSubmitInfo()
+        .setWaitSemaphoreValueCount(semaphoreCount)
+        .setPWaitSemaphoreValues(waitValues)
+        .setSignalSemaphoreValueCount(semaphoreCount)
+        .setPSignalSemaphoreValues(signalValues);
+
+    vk::Fence inFlightFence = nullptr;
+    if (timelineEnabled)
+    {
+        waitSemaphores[1] = this->syncObjects.getTimelineSemaphore();
+        signalSemaphores[1] = this->syncObjects.getTimelineSemaphore();
+        submitInfo.setPNext(&timelineInfo);
+    }
+    else
+    {
+        inFlightFence = this->syncObjects.getInFlightFence(currentFrame);
+    }
+
     const vk::Queue* graphicsQueue = this->devices.getGraphicsQueue();
     const vk::Queue* presentQueue = this->devices.getPresentQueue();
 
-    const vk::Fence& inFlightFence = this->syncObjects.getInFlightFence(currentFrame);
-    if (graphicsQueue->submit(1, &submitInfo, inFlightFence) != vk::Result::eSuccess)
+    // Late latch: pick up input that arrived while recording, as close to submit as possible.
+    this->camera.sampleInput(*this->sdlApi);
+    this->commandBuffers.latchView(this->camera.getViewMatrix());
+
     {
-        throw std::runtime_error("Failed to submit draw command buffer!");
+        PROFILE_ZONE("QueueSubmit");
+        if (graphicsQueue->submit(1, &submitInfo, inFlightFence) != vk::Result::eSuccess)
+        {
+            throw std::runtime_error("Failed to submit draw command buffer!");
+        }
     }
 
+    this->camera.markSubmitted();
+
+    this->latencyStats.submitTimes[currentFrame] = std::chrono::high_resolution_clock::now();
+
     vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR()
         .setWaitSemaphoreCount(1)
         .setPWaitSemaphores(signalSemaphores)
@@ -107,22 +196,495 @@ void VulkanAPI::drawFrame()
         .setPImageIndices(&imageIndex.value)
         .setPResults(nullptr);
 
-    vk::Result result = presentQueue->presentKHR(&presentInfo);
+    vk::Result result = vk::Result::eSuccess;
+    {
+        PROFILE_ZONE("QueuePresent");
+        result = presentQueue->presentKHR(&presentInfo);
+    }
 
-    if ((result == vk::Result::eErrorOutOfDateKHR) || (result != vk::Result::eSuboptimalKHR) || framebufferResized)
+    if ((result == vk::Result::eErrorOutOfDateKHR) || (result == vk::Result::eSuboptimalKHR) || framebufferResized)
     {
         framebufferResized = false;
-        vk::ImageView& depthImageView = this->commandBuffers.getDepthImageView();
-        this->swapchain.recreate(surface, this->sdlApi->window, this->devices);
-        this->commandBuffers.recreateDepthResources(this->devices, this->swapchain);
-        this->swapchain.createFramebuffers(this->devices, this->renderPass.getRenderPassRef(), depthImageView);
+        this->recreateSwapchain();
     }
     else if (result != vk::Result::eSuccess)
     {
         throw std::runtime_error("Failed to present swap chain image!");
     }
 
-    this->commandBuffers.increaseFrame(MAX_FRAMES_IN_FLIGHT);
+    this->redrawRequested = false;
+    this->commandBuffers.increaseFrame(this->framesInFlight);
+}
+
+void VulkanAPI::setFlightRecorder(FlightRecorder* flightRecorder)
+{
+    this->flightRecorder = flightRecorder;
+}
+
+void VulkanAPI::setMetrics(MetricsRegistry* metrics)
+{
+    // Needs the device for the heap count, so it must be called after init.
+    this->metrics = metrics;
+    RuntimeMetrics& runtime = this->runtimeMetrics;
+    // With GPU culling the draws are generated on the GPU; their counts are read back from the culling shader and trail by the frames in flight.
+    runtime.drawCalls = metrics->addGauge("engine_draw_calls", "Draw calls in the last frame, as counted by the culling shader under GPU culling.");
+    runtime.drawCallsTotal = metrics->addCounter("engine_draw_calls_total", "Draw calls since start, as counted by the culling shader under GPU culling.");
+    runtime.triangles = metrics->addGauge("engine_triangles", "Triangles submitted in the last frame, as counted by the culling shader under GPU culling.");
+    runtime.trianglesTotal = metrics->addCounter("engine_triangles_total", "Triangles submitted since start, as counted by the culling shader under GPU culling.");
+    runtime.gpuCulling = metrics->addGauge("engine_gpu_culling", "1 while draws are culled and generated by the GPU culling shader.");
+    runtime.uploadBytesTotal = metrics->addCounter("engine_upload_bytes_total", "Bytes copied from staging buffers to the GPU.");
+    runtime.swapchainRecreationsTotal = metrics->addCounter("engine_swapchain_recreations_total", "Times the swapchain was recreated.");
+    runtime.pipelineCacheHitsTotal = metrics->addCounter("engine_pipeline_cache_hits_total", "Pipeline requests served from the cache.");
+    runtime.pipelineCacheMissesTotal = metrics->addCounter("engine_pipeline_cache_misses_total", "Pipeline requests that needed a new pipeline.");
+    runtime.visibleObjects = metrics->addGauge("engine_visible_objects", "Objects left after CPU frustum culling in the last frame.");
+    runtime.culledObjects = metrics->addGauge("engine_culled_objects", "Objects removed by CPU frustum culling in the last frame.");
+    runtime.cullTime = metrics->addGauge("engine_cull_time_seconds", "Time spent on CPU frustum culling in the last frame.");
+    runtime.recordBatches = metrics->addGauge("engine_record_batches", "Secondary command buffers the last frame was recorded into.");
+    runtime.recordTime = metrics->addGauge("engine_record_time_seconds", "Time spent recording the last frame's draws.");
+    runtime.benchmarkMode = metrics->addGauge("engine_benchmark_mode", "1 while benchmark mode runs uncapped with immediate present.");
+
+    // One series per mode with the active one set to 1, so the mode reads as a label.
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(PresentModePolicy::Immediate); i++)
+    {
+        runtime.presentModes.push_back(metrics->addGauge("engine_present_mode", "Present mode the swapchain was created with.",
+            "mode=\"" + std::string(Swapchain::getPresentModeName(static_cast<PresentModePolicy>(i))) + "\""));
+    }
+
+    for (uint32_t i = 0; i <= static_cast<uint32_t>(LatencyMode::Throughput); i++)
+    {
+        runtime.latencyModes.push_back(metrics->addGauge("engine_latency_mode", "Active latency mode.",
+            "mode=\"" + std::string(getLatencyModeName(static_cast<LatencyMode>(i))) + "\""));
+    }
+
+    runtime.framesInFlight = metrics->addGauge("engine_frames_in_flight", "Frames the CPU may record ahead of the GPU.");
+    runtime.frameWait = metrics->addGauge("engine_frame_wait_seconds", "Average time a frame waited for its slot since the last write.");
+    runtime.submitToRetire = metrics->addGauge("engine_submit_to_retire_seconds", "Average time from submit until the CPU saw the frame complete since the last write.");
+    runtime.inputLatency = metrics->addGauge("engine_input_latency_seconds", "Average time from input to the submit using it since the last write.");
+    runtime.inputLatencyMax = metrics->addGauge("engine_input_latency_max_seconds", "Longest time from input to submit since the last write.");
+    runtime.pipelineLinksTotal = metrics->addCounter("engine_pipeline_builds_total", "Pipelines built, by kind.", "kind=\"fast_link\"");
+    runtime.pipelineOptimizedTotal = metrics->addCounter("engine_pipeline_builds_total", "Pipelines built, by kind.", "kind=\"optimized\"");
+    runtime.pipelineBackgroundTotal = metrics->addCounter("engine_pipeline_builds_total", "Pipelines built, by kind.", "kind=\"background\"");
+    runtime.pipelineFailuresTotal = metrics->addCounter("engine_pipeline_build_failures_total", "Background pipeline builds that failed.");
+    runtime.pipelinesPending = metrics->addGauge("engine_pipelines_pending", "Background pipeline builds not finished yet.");
+    runtime.shaderVariants = metrics->addGauge("engine_shader_variants", "Shader parts created from specialization constants.");
+    runtime.shaderCompilesTotal = metrics->addCounter("engine_shader_compiles_total", "Shaders compiled at runtime.");
+    runtime.shaderCacheHitsTotal = metrics->addCounter("engine_shader_cache_hits_total", "Runtime shader compiles served from the SPIR-V cache.");
+    runtime.shaderReloadsTotal = metrics->addCounter("engine_shader_reloads_total", "Shader hot reloads swapped in.");
+    runtime.shaderReloadFailuresTotal = metrics->addCounter("engine_shader_reload_failures_total", "Shader hot reloads rejected, keeping the previous shaders.");
+    runtime.shaderReloadTime = metrics->addGauge("engine_shader_reload_seconds", "Compile time of the last shader hot reload.");
+    runtime.descriptorPools = metrics->addGauge("engine_descriptor_pools", "Descriptor pools allocated.");
+    runtime.descriptorPoolGrowsTotal = metrics->addCounter("engine_descriptor_pool_grows_total", "Times a full descriptor pool chain got a new pool.");
+    runtime.descriptorTemplateUpdatesTotal = metrics->addCounter("engine_descriptor_template_updates_total", "Descriptor sets written through update templates.");
+    runtime.descriptorCacheHitsTotal = metrics->addCounter("engine_descriptor_cache_hits_total", "Descriptor set requests served from the cache.");
+    runtime.descriptorCacheMissesTotal = metrics->addCounter("engine_descriptor_cache_misses_total", "Descriptor set requests that needed a new set.");
+
+    // Added name by name so each metric's heaps are grouped under one HELP line.
+    size_t heapCount = this->devices.getMemoryHeapUsage().size();
+    for (size_t i = 0; i < heapCount; i++)
+    {
+        runtime.heapUsage.push_back(metrics->addGauge("engine_gpu_memory_usage_bytes", "GPU memory used per heap, 0 without VK_EXT_memory_budget.",
+            "heap=\"" + std::to_string(i) + "\""));
+    }
+
+    for (size_t i = 0; i < heapCount; i++)
+    {
+        runtime.heapBudget.push_back(metrics->addGauge("engine_gpu_memory_budget_bytes", "GPU memory available to the process per heap, 0 without VK_EXT_memory_budget.",
+            "heap=\"" + std::to_string(i) + "\""));
+    }
+
+    for (size_t i = 0; i < heapCount; i++)
+    {
+        runtime.heapSize.push_back(metrics->addGauge("engine_gpu_heap_size_bytes", "Size of each GPU memory heap.", "heap=\"" + std::to_string(i) + "\""));
+    }
+}
+
+void VulkanAPI::sampleMetrics()
+{
+    // Values that are cheap to read but not worth tracking every frame, sampled before each write.
+    if (this->metrics == nullptr)
+    {
+        return;
+    }
+
+    RuntimeMetrics& runtime = this->runtimeMetrics;
+    const PipelineStats& pipelineStats = this->graphicsPipelines.getStats();
+    runtime.pipelineCacheHitsTotal->value = static_cast<double>(pipelineStats.cacheHits);
+    runtime.pipelineCacheMissesTotal->value = static_cast<double>(pipelineStats.cacheMisses);
+    runtime.uploadBytesTotal->value = static_cast<double>(this->commandBuffers.uploadedBytes);
+    runtime.pipelineLinksTotal->value = static_cast<double>(pipelineStats.fastLinkCount);
+    runtime.pipelineOptimizedTotal->value = static_cast<double>(pipelineStats.optimizedCount);
+    runtime.pipelineBackgroundTotal->value = static_cast<double>(pipelineStats.backgroundCount);
+    runtime.pipelineFailuresTotal->value = static_cast<double>(pipelineStats.failedCount);
+    runtime.pipelinesPending->set(pipelineStats.pendingCount);
+    runtime.shaderVariants->set(pipelineStats.shaderVariantCount);
+
+    const ShaderCompileStats& shaderStats = this->shaderCompiler.getStats();
+    runtime.shaderCompilesTotal->value = static_cast<double>(shaderStats.compileCount);
+    runtime.shaderCacheHitsTotal->value = static_cast<double>(shaderStats.cacheHits);
+    runtime.shaderReloadsTotal->value = static_cast<double>(shaderStats.reloadCount);
+    runtime.shaderReloadFailuresTotal->value = static_cast<double>(shaderStats.failedReloadCount);
+    runtime.shaderReloadTime->set(shaderStats.lastReloadMs / 1000.0);
+
+    const DescriptorAllocatorStats& descriptorStats = this->descriptorSets.getStats();
+    runtime.descriptorPools->set(descriptorStats.poolCount);
+    runtime.descriptorPoolGrowsTotal->value = static_cast<double>(descriptorStats.growCount);
+    runtime.descriptorTemplateUpdatesTotal->value = static_cast<double>(descriptorStats.templateUpdates);
+    runtime.descriptorCacheHitsTotal->value = static_cast<double>(descriptorStats.cacheHits);
+    runtime.descriptorCacheMissesTotal->value = static_cast<double>(descriptorStats.cacheMisses);
+    runtime.framesInFlight->set(this->framesInFlight);
+    runtime.benchmarkMode->set(this->benchmarkMode ? 1.0 : 0.0);
+    for (size_t i = 0; i < runtime.presentModes.size(); i++)
+    {
+        runtime.presentModes[i]->set((i == static_cast<size_t>(this->swapchain.getActivePresentMode())) ? 1.0 : 0.0);
+    }
+
+    for (size_t i = 0; i < runtime.latencyModes.size(); i++)
+    {
+        runtime.latencyModes[i]->set((i == static_cast<size_t>(this->latencyMode)) ? 1.0 : 0.0);
+    }
+
+    // Averages cover the interval since the previous write, so the accumulators start over here.
+    LatencyStats& latency = this->latencyStats;
+    if (latency.frameCount > 0)
+    {
+        runtime.frameWait->set(latency.waitTimeMs / latency.frameCount / 1000.0);
+        runtime.submitToRetire->set(latency.retireTimeMs / latency.frameCount / 1000.0);
+        latency.frameCount = 0;
+        latency.waitTimeMs = 0.0;
+        latency.retireTimeMs = 0.0;
+    }
+
+    const InputLatencyStats& inputLatency = this->camera.getLatencyStats();
+    if (inputLatency.sampleCount > 0)
+    {
+        runtime.inputLatency->set(inputLatency.totalMs / inputLatency.sampleCount / 1000.0);
+        runtime.inputLatencyMax->set(inputLatency.maxMs / 1000.0);
+    }
+
+    this->camera.resetLatencyStats();
+
+    std::vector<MemoryHeapUsage> heaps = this->devices.getMemoryHeapUsage();
+    for (size_t i = 0; (i < heaps.size()) && (i < runtime.heapSize.size()); i++)
+    {
+        runtime.heapUsage[i]->set(static_cast<double>(heaps[i].usage));
+        runtime.heapBudget[i]->set(static_cast<double>(heaps[i].budget));
+        runtime.heapSize[i]->set(static_cast<double>(heaps[i].size));
+    }
+}
+
+void VulkanAPI::setLatencyMode(LatencyMode mode)
+{
+    // Applied at the start of the next frame, where nothing is being recorded.
+    if (mode != this->latencyMode)
+    {
+        this->requestedLatencyMode = mode;
+    }
+}
+
+void VulkanAPI::setPresentModePolicy(PresentModePolicy policy)
+{
+    this->presentModePolicy = policy;
+    if (!this->benchmarkMode)
+    {
+        this->swapchain.setPresentModePolicy(policy);
+        this->swapchainOutdated = true;
+    }
+}
+
+void VulkanAPI::setBenchmarkMode(bool enabled)
+{
+    // Benchmarking measures raw render throughput, so vsync is taken out of the picture.
+    this->benchmarkMode = enabled;
+    this->swapchain.setPresentModePolicy(enabled ? PresentModePolicy::Immediate : this->presentModePolicy);
+    this->swapchainOutdated = true;
+}
+
+bool VulkanAPI::isBenchmarkMode() const
+{
+    return this->benchmarkMode;
+}
+
+void VulkanAPI::onKeyPressed(int key)
+{
+    switch (key)
+    {
+    case SDLK_F1:
+        this->setLatencyMode(LatencyMode::LowLatency);
+        break;
+    case SDLK_F2:
+        this->setLatencyMode(LatencyMode::Balanced);
+        break;
+    case SDLK_F3:
+        this->setLatencyMode(LatencyMode::Throughput);
+        break;
+    case SDLK_F5:
+        this->setPresentModePolicy(PresentModePolicy::Fifo);
+        break;
+    case SDLK_F6:
+        this->setPresentModePolicy(PresentModePolicy::FifoRelaxed);
+        break;
+    case SDLK_F7:
+        this->setPresentModePolicy(PresentModePolicy::Mailbox);
+        break;
+    case SDLK_F8:
+        this->setPresentModePolicy(PresentModePolicy::Immediate);
+        break;
+    case SDLK_F10:
+        this->cycleCullMode();
+        break;
+    case SDLK_F11:
+        this->toggleShaderFeature(ShaderFeature::Texturing);
+        break;
+    case SDLK_F12:
+        this->toggleShaderFeature(ShaderFeature::VertexColor);
+        break;
+    case SDLK_SPACE:
+        this->commandBuffers.setAnimationPaused(this->commandBuffers.isAnimating());
+        break;
+    default:
+        break;
+    }
+}
+
+void VulkanAPI::applyLatencyMode(LatencyMode mode)
+{
+    vk::Device* logicalDevice = this->devices.getDevice();
+    logicalDevice->waitIdle();
+    this->syncObjects.collectGarbage(logicalDevice);
+
+    // The uniform buffers are recreated below and their handles may come back, so no cached set may still refer to them.
+    // Sets of the other resources stay cached.
+    for (uint32_t i = 0; i < this->framesInFlight; i++)
+    {
+        vk::DescriptorBufferInfo bufferInfo;
+        vk::DescriptorImageInfo imageInfo;
+        this->commandBuffers.createDescriptorsBufferInfo(i, bufferInfo, imageInfo);
+        this->descriptorSets.invalidateBuffer(bufferInfo.buffer);
+    }
+
+    this->syncObjects.release(logicalDevice, this->framesInFlight);
+
+    LatencySettings settings = getLatencySettings(mode);
+    this->latencyMode = mode;
+    this->framesInFlight = settings.framesInFlight;
+
+    this->syncObjects.init(logicalDevice, this->framesInFlight, this->devices.getCapabilities().timelineSemaphore);
+    this->commandBuffers.resizeFrames(this->devices, this->framesInFlight);
+    this->descriptorSets.resizeFrames(this->framesInFlight);
+    this->createDescriptorSets();
+
+    this->swapchain.setExtraImageCount(settings.extraSwapchainImages);
+    this->recreateSwapchain();
+
+    this->latencyStats = LatencyStats();
+    this->latencyStats.submitTimes.resize(this->framesInFlight);
+}
+
+bool VulkanAPI::recreateSwapchain()
+{
+    PROFILE_FUNCTION();
+    if (!this->hasDrawableArea())
+    {
+        this->swapchainOutdated = true;
+        return false;
+    }
+
+    this->swapchain.recreate(surface, this->sdlApi->window, this->devices);
+    this->commandBuffers.recreateDepthResources(this->devices, this->swapchain);
+
+    // Dynamic rendering binds the new image views directly at record time.
+    if (!this->renderPass.isDynamicRendering())
+    {
+        vk::ImageView& depthImageView = this->commandBuffers.getDepthImageView();
+        this->swapchain.createFramebuffers(this->devices, this->renderPass.getRenderPassRef(), depthImageView);
+    }
+
+    this->swapchainOutdated = false;
+    this->redrawRequested = true;
+    PROFILE_EVENT("SwapchainRecreated");
+    if (this->metrics != nullptr)
+    {
+        this->runtimeMetrics.swapchainRecreationsTotal->increment();
+    }
+    return true;
+}
+
+bool VulkanAPI::hasDrawableArea()
+{
+    int width = 0;
+    int height = 0;
+    SDL_Vulkan_GetDrawableSize(this->sdlApi->window, &width, &height);
+
+    return (width > 0) && (height > 0);
+}
+
+void VulkanAPI::cycleCullMode()
+{
+    RasterState& rasterState = this->commandBuffers.rasterState;
+    rasterState.cullMode = (rasterState.cullMode == CullMode::Back) ? CullMode::None :
+        ((rasterState.cullMode == CullMode::None) ? CullMode::Front : CullMode::Back);
+
+    // With extended dynamic state this finds the existing pipeline instead of building a new one.
+    this->mainPipeline = this->graphicsPipelines.requestVariant(this->vertexShader, this->fragmentShader, this->shaderFeatures, rasterState);
+    this->redrawRequested = true;
+}
+
+void VulkanAPI::toggleShaderFeature(ShaderFeature feature)
+{
+    // Each feature set is its own specialized variant; toggling back reuses the cached one.
+    this->shaderFeatures ^= getFeatureBit(feature);
+    this->mainPipeline = this->graphicsPipelines.requestVariant(this->vertexShader, this->fragmentShader, this->shaderFeatures,
+        this->commandBuffers.rasterState);
+    this->redrawRequested = true;
+}
+
+void VulkanAPI::reloadChangedShaders()
+{
+    if (!this->shaderCompiler.isAvailable())
+    {
+        return;
+    }
+
+    std::vector<std::string> changedFiles = this->shaderWatcher.pollChanges();
+    if (changedFiles.empty())
+    {
+        return;
+    }
+
+    const std::string vertexSource = SHADER_DIRECTORY + "shader.vert";
+    const std::string& fragmentSource = this->fragmentSource;
+    bool vertexChanged = false;
+    bool fragmentChanged = false;
+    for (const std::string& changedFile : changedFiles)
+    {
+        vertexChanged = vertexChanged || this->shaderCompiler.dependsOn(vertexSource, changedFile);
+        fragmentChanged = fragmentChanged || this->shaderCompiler.dependsOn(fragmentSource, changedFile);
+    }
+
+    if (!vertexChanged && !fragmentChanged)
+    {
+        return;
+    }
+
+    // A shader with errors keeps the current pipeline, so a typo doesn't end the session.
+    try
+    {
+        std::vector<char> vertexCode;
+        std::vector<char> fragmentCode;
+        ShaderLayout newVertexLayout = this->vertexShaderLayout;
+        ShaderLayout newFragmentLayout = this->fragmentShaderLayout;
+        double compileMs = 0.0;
+        if (vertexChanged)
+        {
+            vertexCode = this->shaderCompiler.compile(vertexSource, ShaderStage::Vertex);
+            compileMs += this->shaderCompiler.getStats().lastCompileMs;
+            newVertexLayout = ShaderReflection::reflect(vertexCode);
+        }
+        if (fragmentChanged)
+        {
+            fragmentCode = this->shaderCompiler.compile(fragmentSource, ShaderStage::Fragment);
+            compileMs += this->shaderCompiler.getStats().lastCompileMs;
+            newFragmentLayout = ShaderReflection::reflect(fragmentCode);
+        }
+
+        // Descriptor sets are allocated against the current layout, so only shaders that keep it can be swapped in.
+        ShaderLayout shaderLayout = ShaderReflection::merge(newVertexLayout, newFragmentLayout);
+        ShaderReflection::checkVertexInputs(shaderLayout);
+        if (this->layoutCache.getPipelineLayout(shaderLayout) != pipelineLayout)
+        {
+            throw std::runtime_error("Shader resources changed, restart to apply them!");
+        }
+
+        uint32_t previousVertexShader = this->vertexShader;
+        uint32_t previousFragmentShader = this->fragmentShader;
+        if (vertexChanged)
+        {
+            this->vertexShader = this->graphicsPipelines.createShader(vertexCode, true);
+            this->vertexShaderLayout = newVertexLayout;
+        }
+        if (fragmentChanged)
+        {
+            this->fragmentShader = this->graphicsPipelines.createShader(fragmentCode, false);
+            this->fragmentShaderLayout = newFragmentLayout;
+        }
+
+        this->mainPipeline = this->graphicsPipelines.requestVariant(this->vertexShader, this->fragmentShader, this->shaderFeatures,
+            this->commandBuffers.rasterState);
+        this->redrawRequested = true;
+
+        // The replaced shaders and every pipeline built from them are retired once in-flight frames are done with them.
+        // The fallback may be one of those pipelines, so the new one is finished and takes its place first.
+        this->graphicsPipelines.finishBackgroundBuilds();
+        if (!this->graphicsPipelines.isReady(this->mainPipeline))
+        {
+            throw std::runtime_error("Reloaded pipeline failed to build, drawing with the previous one!");
+        }
+
+        this->graphicsPipelines.setFallback(this->mainPipeline);
+        if (vertexChanged)
+        {
+            this->graphicsPipelines.releaseShader(previousVertexShader);
+        }
+        if (fragmentChanged)
+        {
+            this->graphicsPipelines.releaseShader(previousFragmentShader);
+        }
+
+        this->shaderCompiler.recordReload(true, compileMs);
+    }
+    catch (const std::exception& e)
+    {
+        // The message is the only place the shader error shows up.
+        this->shaderCompiler.recordReload(false, 0.0);
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+void VulkanAPI::requestRedraw()
+{
+    this->redrawRequested = true;
+}
+
+void VulkanAPI::onWindowResized()
+{
+    this->framebufferResized = true;
+    this->redrawRequested = true;
+}
+
+bool VulkanAPI::needsRedraw()
+{
+    if (!this->hasDrawableArea())
+    {
+        return false;
+    }
+
+    this->reloadChangedShaders();
+
+    // Sampling here also moves the camera, which drawFrame would do anyway.
+    this->camera.sampleInput(*this->sdlApi);
+
+    return this->redrawRequested || this->swapchainOutdated || this->requestedLatencyMode.has_value() ||
+        this->benchmarkMode || this->commandBuffers.isAnimating() || this->camera.isMoving();
+}
+
+void VulkanAPI::recordLatency(std::chrono::high_resolution_clock::time_point frameStart, uint32_t currentFrame)
+{
+    LatencyStats& stats = this->latencyStats;
+    auto now = std::chrono::high_resolution_clock::now();
+
+    if (stats.lastFrameStart != std::chrono::high_resolution_clock::time_point())
+    {
+        stats.waitTimeMs += std::chrono::duration<double, std::milli>(now - frameStart).count();
+
+        if (stats.submitTimes[currentFrame] != std::chrono::high_resolution_clock::time_point())
+        {
+            stats.retireTimeMs += std::chrono::duration<double, std::milli>(now - stats.submitTimes[currentFrame]).count();
+        }
+
+        stats.frameCount++;
+    }
+
+    stats.lastFrameStart = frameStart;
 }
 
 std::vector<const char*> VulkanAPI::getRequiredExtensions()
@@ -156,6 +718,9 @@ void VulkanAPI::createInstance()
         throw std::runtime_error("Validation layers requested, bot not available!");
     }
 
+    // Ask for the newest version we know how to use; optional features are then enabled per device.
+    instanceApiVersion = std::min(vk::enumerateInstanceVersion(), static_cast<uint32_t>(VK_API_VERSION_1_3));
+
     // vk::ApplicationInfo allows the programmer to specifiy some basic information about the
     // program, which can be useful for layers and tools to provide more debug information.
     vk::ApplicationInfo appInfo = vk::ApplicationInfo()
@@ -163,7 +728,7 @@ void VulkanAPI::createInstance()
         .setApplicationVersion(1)
         .setPEngineName("LunarG SDK")
         .setEngineVersion(1)
-        .setApiVersion(VK_API_VERSION_1_0);
+        .setApiVersion(instanceApiVersion);
 
     // vk::InstanceCreateInfo is where the programmer specifies the layers and/or extensions that
     // are needed.
@@ -206,169 +771,124 @@ void VulkanAPI::createSurface()
 
 void VulkanAPI::createGraphicsPipeline()
 {
-    std::vector<char> vertShaderCode = Utils::readFile("../../shaders/vert.spv");
-    std::vector<char> fragShaderCode = Utils::readFile("../../shaders/frag.spv");
-
-    vk::ShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    vk::ShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-    vk::PipelineShaderStageCreateInfo vertShaderStageInfo = vk::PipelineShaderStageCreateInfo()
-        .setStage(vk::ShaderStageFlagBits::eVertex)
-        .setModule(vertShaderModule)
-        .setPName("main");
-
-    vk::PipelineShaderStageCreateInfo fragShaderStageInfo = vk::PipelineShaderStageCreateInfo()
-        .setStage(vk::ShaderStageFlagBits::eFragment)
-        .setModule(fragShaderModule)
-        .setPName("main");
-
-    vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-    vk::PipelineVertexInputStateCreateInfo vertexInputInfo = vk::PipelineVertexInputStateCreateInfo()
-        .setVertexBindingDescriptionCount(1)
-        .setVertexAttributeDescriptionCount(static_cast<uint32_t>(attributeDescriptions.size()))
-        .setPVertexBindingDescriptions(&bindingDescription)
-        .setPVertexAttributeDescriptions(attributeDescriptions.data());
-
-    vk::PipelineInputAssemblyStateCreateInfo inputAssembly = vk::PipelineInputAssemblyStateCreateInfo()
-        .setTopology(vk::PrimitiveTopology::eTriangleList)
-        .setPrimitiveRestartEnable(vk::False);
-
-    vk::PipelineViewportStateCreateInfo viewportState = vk::PipelineViewportStateCreateInfo()
-        .setViewportCount(1)
-        .setScissorCount(1);
-
-    vk::PipelineRasterizationStateCreateInfo rasterizer = vk::PipelineRasterizationStateCreateInfo()
-        .setDepthClampEnable(vk::False)
-        .setRasterizerDiscardEnable(vk::False)
-        .setPolygonMode(vk::PolygonMode::eFill)
-        .setLineWidth(1.0f)
-        .setCullMode(vk::CullModeFlagBits::eBack)
-        .setFrontFace(vk::FrontFace::eCounterClockwise)
-        .setDepthBiasEnable(vk::False)
-        .setDepthBiasConstantFactor(0.0f)
-        .setDepthBiasClamp(0.0f)
-        .setDepthBiasSlopeFactor(0.0f);
-
-    vk::PipelineMultisampleStateCreateInfo multisampling = vk::PipelineMultisampleStateCreateInfo()
-        .setSampleShadingEnable(vk::False)
-        .setRasterizationSamples(vk::SampleCountFlagBits::e1)
-        .setMinSampleShading(1.0f)
-        .setPSampleMask(nullptr)
-        .setAlphaToCoverageEnable(vk::False)
-        .setAlphaToOneEnable(vk::False);
-
-    vk::PipelineColorBlendAttachmentState colorBlendAttachment = vk::PipelineColorBlendAttachmentState()
-        .setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
-        .setBlendEnable(vk::False)
-        .setSrcColorBlendFactor(vk::BlendFactor::eOne)
-        .setDstColorBlendFactor(vk::BlendFactor::eZero)
-        .setColorBlendOp(vk::BlendOp::eAdd)
-        .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
-        .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
-        .setAlphaBlendOp(vk::BlendOp::eAdd);
-
-    vk::PipelineColorBlendStateCreateInfo colorBlending = vk::PipelineColorBlendStateCreateInfo()
-        .setLogicOpEnable(vk::False)
-        .setLogicOp(vk::LogicOp::eCopy)
-        .setAttachmentCount(1)
-        .setPAttachments(&colorBlendAttachment)
-        .setBlendConstants(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 0.0f });
-
-    std::vector<vk::DynamicState> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
-
-    vk::PipelineDynamicStateCreateInfo dynamicState = vk::PipelineDynamicStateCreateInfo()
-        .setDynamicStateCount(static_cast<uint32_t>(dynamicStates.size()))
-        .setPDynamicStates(dynamicStates.data());
-
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo = this->descriptorSets.createPipelineLayoutInfo();
-
     vk::Device* logicalDevice = this->devices.getDevice();
-    if (logicalDevice->createPipelineLayout(&pipelineLayoutInfo, nullptr, &pipelineLayout) != vk::Result::eSuccess)
-    {
-        throw std::runtime_error("Failed to create pipeline layout!");
-    }
-
-    vk::PipelineDepthStencilStateCreateInfo depthStencil = vk::PipelineDepthStencilStateCreateInfo()
-        .setDepthTestEnable(vk::True)
-        .setDepthWriteEnable(vk::True)
-        .setDepthCompareOp(vk::CompareOp::eLess)
-        .setDepthBoundsTestEnable(vk::False)
-        .setMinDepthBounds(0.0f)
-        .setMaxDepthBounds(1.0f)
-        .setStencilTestEnable(vk::False);
-
-    vk::GraphicsPipelineCreateInfo pipelineInfo = vk::GraphicsPipelineCreateInfo()
-        .setStageCount(2)
-        .setPStages(shaderStages)
-        .setPVertexInputState(&vertexInputInfo)
-        .setPInputAssemblyState(&inputAssembly)
-        .setPViewportState(&viewportState)
-        .setPRasterizationState(&rasterizer)
-        .setPMultisampleState(&multisampling)
-        .setPDepthStencilState(&depthStencil)
-        .setPColorBlendState(&colorBlending)
-        .setPDynamicState(&dynamicState)
-        .setLayout(pipelineLayout)
-        .setRenderPass(this->renderPass.getRenderPassRef())
-        .setSubpass(0)
-        .setBasePipelineHandle(nullptr)
-        .setBasePipelineIndex(-1);
-
-    vk::Result result;
-    std::tie(result, graphicsPipeline) = logicalDevice->createGraphicsPipeline(nullptr, pipelineInfo);
-    if (result != vk::Result::eSuccess)
-    {
-        throw std::runtime_error("Failed to create graphics pipeline!");
-    }
-
-    logicalDevice->destroyShaderModule(vertShaderModule);
-    logicalDevice->destroyShaderModule(fragShaderModule);
+    const DeviceCapabilities& capabilities = this->devices.getCapabilities();
+
+    // The bindless shader indexes textures and buffers from set 1 instead of binding a sampler per texture.
+    this->shaderCompiler.init(SHADER_DIRECTORY + "cache");
+    bool bindless = capabilities.descriptorIndexing &&
+        (this->shaderCompiler.isAvailable() || std::filesystem::exists(SHADER_DIRECTORY + "frag_bindless.spv"));
+    this->fragmentSource = SHADER_DIRECTORY + (bindless ? "shader_bindless.frag" : "shader.frag");
+    std::string fragmentBinary = SHADER_DIRECTORY + (bindless ? "frag_bindless.spv" : "frag.spv");
+
+    std::vector<char> vertexCode = this->shaderCompiler.loadShader(SHADER_DIRECTORY + "shader.vert", ShaderStage::Vertex, SHADER_DIRECTORY + "vert.spv");
+    std::vector<char> fragmentCode = this->shaderCompiler.loadShader(this->fragmentSource, ShaderStage::Fragment, fragmentBinary);
+    if (this->shaderCompiler.isAvailable())
+    {
+        this->shaderWatcher.init(SHADER_DIRECTORY);
+    }
+
+    // Layouts come from the shaders themselves, so a binding change in GLSL can't go out of sync with the C++ side.
+    this->vertexShaderLayout = ShaderReflection::reflect(vertexCode);
+    this->fragmentShaderLayout = ShaderReflection::reflect(fragmentCode);
+    ShaderLayout shaderLayout = ShaderReflection::merge(this->vertexShaderLayout, this->fragmentShaderLayout);
+    ShaderReflection::checkVertexInputs(shaderLayout);
+
+    // Set 0 is rewritten per frame, so it is pushed when the device can, and written through a template otherwise.
+    this->layoutCache.init(logicalDevice, capabilities.maxBindlessTextures, capabilities.maxBindlessBuffers);
+    if (capabilities.pushDescriptor)
+    {
+        this->layoutCache.setPushDescriptorSet(0);
+    }
+
+    pipelineLayout = this->layoutCache.getPipelineLayout(shaderLayout);
+    std::vector<ReflectedBinding> setBindings = shaderLayout.getSetBindings(0);
+    const vk::DescriptorUpdateTemplate* updateTemplate = capabilities.descriptorUpdateTemplate ?
+        this->layoutCache.getUpdateTemplate(shaderLayout, 0) : nullptr;
+    this->descriptorSets.initLayout(logicalDevice, this->layoutCache.getDescriptorSetLayout(setBindings, capabilities.pushDescriptor),
+        setBindings, updateTemplate, capabilities.pushDescriptor);
+
+    if (shaderLayout.getSetCount() > BINDLESS_SET)
+    {
+        std::vector<ReflectedBinding> bindlessBindings = shaderLayout.getSetBindings(BINDLESS_SET);
+        this->bindlessDescriptors.init(logicalDevice, this->layoutCache.getDescriptorSetLayout(bindlessBindings), bindlessBindings,
+            capabilities.maxBindlessTextures, capabilities.maxBindlessBuffers);
+    }
+
+    this->graphicsPipelines.init(this->devices, this->renderPass, pipelineLayout, &this->syncObjects);
+
+    this->vertexShader = this->graphicsPipelines.createShader(vertexCode, true);
+    this->fragmentShader = this->graphicsPipelines.createShader(fragmentCode, false);
+
+    // The first pipeline is linked synchronously so there is always a fallback to draw with.
+    ShaderSpecialization specialization = ShaderSpecialization::fromFeatures(this->shaderFeatures);
+    uint32_t vertexPart = this->graphicsPipelines.createShaderPart(this->vertexShader, specialization);
+    uint32_t fragmentPart = this->graphicsPipelines.createShaderPart(this->fragmentShader, specialization);
+    this->mainPipeline = this->graphicsPipelines.link(vertexPart, fragmentPart, this->commandBuffers.rasterState);
+    this->graphicsPipelines.setFallback(this->mainPipeline);
 }
 
 void VulkanAPI::createDescriptorSets()
 {
-    vk::Device* logicalDevice = this->devices.getDevice();
-    this->descriptorSets.initDescriptorSet(logicalDevice, MAX_FRAMES_IN_FLIGHT);
+    ShaderLayout shaderLayout = ShaderReflection::merge(this->vertexShaderLayout, this->fragmentShaderLayout);
+    const ReflectedBinding* uniformReflection = shaderLayout.findBinding(0, static_cast<uint32_t>(vk::DescriptorType::eUniformBuffer));
+    const ReflectedBinding* samplerReflection = shaderLayout.findBinding(0, static_cast<uint32_t>(vk::DescriptorType::eCombinedImageSampler));
+    if (uniformReflection == nullptr)
+    {
+        throw std::runtime_error("Shaders don't declare the uniform buffer in set 0!");
+    }
+
+    // The bindless shader reads its texture from the bindless set, so set 0 has no sampler.
+    if ((samplerReflection == nullptr) && !this->bindlessDescriptors.isEnabled())
+    {
+        throw std::runtime_error("Shaders don't declare the texture sampler in set 0!");
+    }
 
-    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (uint32_t i = 0; i < this->framesInFlight; i++)
     {
-        vk::DescriptorSet& descriptorSet = this->descriptorSets.getDescriptorSet(i);
         vk::DescriptorBufferInfo bufferInfo;
         vk::DescriptorImageInfo imageInfo;
         this->commandBuffers.createDescriptorsBufferInfo(i, bufferInfo, imageInfo);
 
-        std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
-        descriptorWrites[0].setDstSet(descriptorSet)
-            .setDstBinding(0)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-            .setDescriptorCount(1)
-            .setBufferInfo(bufferInfo);
-        
-        descriptorWrites[1].setDstSet(descriptorSet)
-            .setDstBinding(1)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-            .setDescriptorCount(1)
-            .setImageInfo(imageInfo);
+        std::vector<DescriptorWrite> descriptorWrites;
+        descriptorWrites.push_back(DescriptorWrite::fromBuffer(uniformReflection->binding,
+            static_cast<uint32_t>(vk::DescriptorType::eUniformBuffer), bufferInfo));
 
-        logicalDevice->updateDescriptorSets(descriptorWrites, nullptr);
+        if (samplerReflection != nullptr)
+        {
+            descriptorWrites.push_back(DescriptorWrite::fromImage(samplerReflection->binding,
+                static_cast<uint32_t>(vk::DescriptorType::eCombinedImageSampler), imageInfo));
+        }
+
+        this->descriptorSets.createDescriptorSet(i, descriptorWrites);
     }
 }
 
-vk::ShaderModule VulkanAPI::createShaderModule(const std::vector<char>& code)
+void VulkanAPI::updateFrameMetrics()
 {
-    vk::ShaderModuleCreateInfo createInfo = vk::ShaderModuleCreateInfo()
-        .setCodeSize(code.size())
-        .setPCode(reinterpret_cast<const uint32_t*>(code.data()));
+    if (this->metrics == nullptr)
+    {
+        return;
+    }
 
-    vk::ShaderModule shaderModule = this->devices.getDevice()->createShaderModule(createInfo);
-    return shaderModule;
+    const RecordingStats& recordingStats = this->commandBuffers.getRecordingStats();
+    RuntimeMetrics& runtime = this->runtimeMetrics;
+    runtime.drawCalls->set(recordingStats.drawCount);
+    runtime.drawCallsTotal->increment(recordingStats.drawCount);
+    runtime.triangles->set(static_cast<double>(recordingStats.triangleCount));
+    runtime.trianglesTotal->increment(static_cast<double>(recordingStats.triangleCount));
+    runtime.gpuCulling->set(this->commandBuffers.gpuCulling.isEnabled() ? 1.0 : 0.0);
+    runtime.recordBatches->set(recordingStats.batchCount);
+    runtime.recordTime->set(recordingStats.recordTimeMs / 1000.0);
+
+    // With GPU culling visibility is only known on the GPU, so the CPU culling gauges keep their last values.
+    if (!this->commandBuffers.gpuCulling.isEnabled())
+    {
+        const CullingStats& cullingStats = this->commandBuffers.getCullingStats();
+        runtime.visibleObjects->set(cullingStats.visibleCount);
+        runtime.culledObjects->set(cullingStats.culledCount);
+        runtime.cullTime->set(cullingStats.cullTimeMs / 1000.0);
+    }
 }
 
 void VulkanAPI::preRelease()
@@ -378,17 +898,20 @@ void VulkanAPI::preRelease()
     if (instance != nullptr)
     {
         logicalDevice->waitIdle();
+        this->syncObjects.collectGarbage(logicalDevice);
         this->swapchain.release(this->devices);
 
-        logicalDevice->destroyPipeline(graphicsPipeline);
-        logicalDevice->destroyPipelineLayout(pipelineLayout);
+        this->graphicsPipelines.release();
+        this->shaderWatcher.release();
+        this->bindlessDescriptors.release();
+        this->layoutCache.release();
         this->renderPass.release(logicalDevice);
 
-        this->commandBuffers.releaseUniformBuffers(logicalDevice, MAX_FRAMES_IN_FLIGHT);
+        this->commandBuffers.releaseUniformBuffers(logicalDevice, this->framesInFlight);
         this->descriptorSets.release(logicalDevice);
         this->commandBuffers.release(logicalDevice);
 
-        this->syncObjects.release(logicalDevice, MAX_FRAMES_IN_FLIGHT);
+        this->syncObjects.release(logicalDevice, this->framesInFlight);
 
         logicalDevice->destroy();
         debugMessenger.release(instance, nullptr);
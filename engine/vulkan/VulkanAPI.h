@@ -6,15 +6,28 @@
 #pragma once
 
 #include "engine/sdl/SDLAPI.h"
+#include "engine/ThreadPool.h"
+#include "engine/Camera.h"
+#include "engine/ShaderWatcher.h"
+#include "engine/FlightRecorder.h"
+#include "engine/Metrics.h"
 #include "DebugMessenger.h"
 #include "ValidationLayers.h"
 #include "Devices.h"
 #include "SwapChain.h"
 #include "RenderPass.h"
+#include "GraphicsPipelines.h"
+#include "ShaderCompiler.h"
+#include "ShaderReflection.h"
+#include "LayoutCache.h"
+#include "BindlessDescriptors.h"
 #include "DescriptorSets.h"
 #include "CommandBuffers.h"
 #include "SyncObjects.h"
+#include "LatencyMode.h"
 
+#include <chrono>
+#include <optional>
 #include <vector>
 
 struct SwapChainSupportDetails;
@@ -28,15 +41,105 @@ private:
 	Devices devices;
 	Swapchain swapchain;
 	RenderPass renderPass;
+	GraphicsPipelines graphicsPipelines;
+	ShaderCompiler shaderCompiler;
+	ShaderWatcher shaderWatcher;
+	LayoutCache layoutCache;
+	BindlessDescriptors bindlessDescriptors;
 	DescriptorSets descriptorSets;
 	CommandBuffers commandBuffers;
 	SyncObjects syncObjects;
+	ThreadPool threadPool;
+	Camera camera;
+	FlightRecorder* flightRecorder = nullptr;
+	MetricsRegistry* metrics = nullptr;
 
 	bool framebufferResized = false;
+	LatencyMode latencyMode = LatencyMode::Balanced;
+	std::optional<LatencyMode> requestedLatencyMode;
+	uint32_t framesInFlight = 2;
+	PresentModePolicy presentModePolicy = PresentModePolicy::Mailbox;
+	bool benchmarkMode = false;
+	bool swapchainOutdated = false;
+	bool redrawRequested = true;
+	uint32_t vertexShader = 0;
+	uint32_t fragmentShader = 0;
+	std::string fragmentSource;
+	ShaderFeatureMask shaderFeatures = getFeatureBit(ShaderFeature::Texturing) | getFeatureBit(ShaderFeature::PrecomputedMvp);
+	uint32_t mainPipeline = 0;
+	ShaderLayout vertexShaderLayout;
+	ShaderLayout fragmentShaderLayout;
+
+	// Accumulated between metrics writes; "retire" is submit until the CPU sees the frame complete.
+	struct LatencyStats
+	{
+		uint32_t frameCount = 0;
+		double waitTimeMs = 0.0;
+		double retireTimeMs = 0.0;
+		std::chrono::high_resolution_clock::time_point lastFrameStart;
+		std::vector<std::chrono::high_resolution_clock::time_point> submitTimes;
+	} latencyStats;
+
+	// Registered by setMetrics; all null while no registry is attached.
+	struct RuntimeMetrics
+	{
+		MetricGauge* drawCalls = nullptr;
+		MetricCounter* drawCallsTotal = nullptr;
+		MetricGauge* triangles = nullptr;
+		MetricCounter* trianglesTotal = nullptr;
+		MetricGauge* gpuCulling = nullptr;
+		MetricCounter* uploadBytesTotal = nullptr;
+		MetricCounter* swapchainRecreationsTotal = nullptr;
+		MetricCounter* pipelineCacheHitsTotal = nullptr;
+		MetricCounter* pipelineCacheMissesTotal = nullptr;
+		MetricGauge* visibleObjects = nullptr;
+		MetricGauge* culledObjects = nullptr;
+		MetricGauge* cullTime = nullptr;
+		MetricGauge* recordBatches = nullptr;
+		MetricGauge* recordTime = nullptr;
+		MetricGauge* benchmarkMode = nullptr;
+		std::vector<MetricGauge*> presentModes;
+		std::vector<MetricGauge*> latencyModes;
+		MetricGauge* framesInFlight = nullptr;
+		MetricGauge* frameWait = nullptr;
+		MetricGauge* submitToRetire = nullptr;
+		MetricGauge* inputLatency = nullptr;
+		MetricGauge* inputLatencyMax = nullptr;
+		MetricCounter* pipelineLinksTotal = nullptr;
+		MetricCounter* pipelineOptimizedTotal = nullptr;
+		MetricCounter* pipelineBackgroundTotal = nullptr;
+		MetricCounter* pipelineFailuresTotal = nullptr;
+		MetricGauge* pipelinesPending = nullptr;
+		MetricGauge* shaderVariants = nullptr;
+		MetricCounter* shaderCompilesTotal = nullptr;
+		MetricCounter* shaderCacheHitsTotal = nullptr;
+		MetricCounter* shaderReloadsTotal = nullptr;
+		MetricCounter* shaderReloadFailuresTotal = nullptr;
+		MetricGauge* shaderReloadTime = nullptr;
+		MetricGauge* descriptorPools = nullptr;
+		MetricCounter* descriptorPoolGrowsTotal = nullptr;
+		MetricCounter* descriptorTemplateUpdatesTotal = nullptr;
+		MetricCounter* descriptorCacheHitsTotal = nullptr;
+		MetricCounter* descriptorCacheMissesTotal = nullptr;
+		std::vector<MetricGauge*> heapUsage;
+		std::vector<MetricGauge*> heapBudget;
+		std::vector<MetricGauge*> heapSize;
+	} runtimeMetrics;
 
 public:
 	void init(SDLAPI& sdlApi);
 	void drawFrame();
+	void setLatencyMode(LatencyMode mode);
+	void setPresentModePolicy(PresentModePolicy policy);
+	void setBenchmarkMode(bool enabled);
+	bool isBenchmarkMode() const;
+	void requestRedraw();
+	void onWindowResized();
+	bool needsRedraw();
+	void onKeyPressed(int key);
+	void setFlightRecorder(FlightRecorder* flightRecorder);
+	void setMetrics(MetricsRegistry* metrics);
+	void sampleMetrics();
 
 private:
 	void createInstance();
@@ -45,7 +148,14 @@ private:
 	void createGraphicsPipeline();
 	
 	void createDescriptorSets();
-	vk::ShaderModule createShaderModule(const std::vector<char>& code);
+	void applyLatencyMode(LatencyMode mode);
+	bool recreateSwapchain();
+	bool hasDrawableArea();
+	void cycleCullMode();
+	void toggleShaderFeature(ShaderFeature feature);
+	void reloadChangedShaders();
+	void recordLatency(std::chrono::high_resolution_clock::time_point frameStart, uint32_t currentFrame);
+	void updateFrameMetrics();
 	void preRelease();
 	void release();
 
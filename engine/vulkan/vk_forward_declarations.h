@@ -21,8 +21,10 @@ namespace vk
 	class DescriptorSetLayout;
 	class DescriptorPool;
 	class DescriptorSet;
+	class DescriptorUpdateTemplate;
 	class Image;
 	class ImageView;
+	class Sampler;
 	
 	struct PipelineLayoutCreateInfo;
 	struct SurfaceFormatKHR;
@@ -31,6 +33,9 @@ namespace vk
 	struct RenderPassBeginInfo;
 	struct DescriptorBufferInfo;
 	struct DescriptorImageInfo;
+	struct CommandBufferInheritanceInfo;
+	struct CommandBufferInheritanceRenderingInfo;
+	struct PipelineRenderingCreateInfo;
 
 	enum class PresentModeKHR;
 	enum class Format;
@@ -37,13 +37,15 @@ Create and destroy a Vulkan surface on an SDL window.
 #include "engine/Platform.h"
 
 #include <iostream>
+#include <string>
+#include <vector>
 
-int main()
+int main(int argc, char* argv[])
 {
     Platform platform;
     try
     {
-        platform.init();
+        platform.init(std::vector<std::string>(argv + 1, argv + argc));
     }
     catch (const std::exception& e)
     {
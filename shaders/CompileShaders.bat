@@ -1,4 +1,6 @@
 glslc.exe shader.vert -o vert.spv
 glslc.exe shader.frag -o frag.spv
+glslc.exe shader_bindless.frag -o frag_bindless.spv
+glslc.exe cull.comp -o cull.spv
 
 pause
\ No newline at end of file
@@ -1,5 +1,11 @@
 #version 450
 
+// Set per material through specialization constants; the ids match ShaderFeature.
+layout(constant_id = 0) const bool TEXTURING = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 4) const float ALPHA_CUTOFF = 0.5;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 
@@ -9,5 +15,19 @@ layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = vec4(1.0);
+    if (TEXTURING)
+    {
+        color = texture(texSampler, fragTexCoord);
+    }
+    if (VERTEX_COLOR)
+    {
+        color.rgb *= fragColor;
+    }
+    if (ALPHA_TEST && (color.a < ALPHA_CUTOFF))
+    {
+        discard;
+    }
+
+    outColor = color;
 }
@@ -1,10 +1,14 @@
 #version 450
 
+// Set per material through specialization constants; the ids match ShaderFeature.
+layout(constant_id = 3) const bool PRECOMPUTED_MVP = false;
+
 layout(binding = 0) uniform UniformBufferObject
 {
 	mat4 model;
 	mat4 view;
 	mat4 proj;
+	mat4 modelViewProj;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
@@ -16,7 +20,14 @@ layout(location = 1) out vec2 fragTexCoord;
 
 void main()
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    if (PRECOMPUTED_MVP)
+    {
+        gl_Position = ubo.modelViewProj * vec4(inPosition, 1.0);
+    }
+    else
+    {
+        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    }
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,47 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Set per material through specialization constants; the ids match ShaderFeature.
+layout(constant_id = 0) const bool TEXTURING = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 4) const float ALPHA_CUTOFF = 0.5;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// Every texture and buffer in the scene; materials pick theirs by index.
+layout(set = 1, binding = 0) readonly buffer MaterialBuffer
+{
+	uint textureIndices[];
+} materialBuffers[];
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawConstants
+{
+	uint materialBuffer;
+	uint materialIndex;
+} draw;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec4 color = vec4(1.0);
+    if (TEXTURING)
+    {
+        uint textureIndex = materialBuffers[draw.materialBuffer].textureIndices[draw.materialIndex];
+        color = texture(textures[nonuniformEXT(textureIndex)], fragTexCoord);
+    }
+    if (VERTEX_COLOR)
+    {
+        color.rgb *= fragColor;
+    }
+    if (ALPHA_TEST && (color.a < ALPHA_CUTOFF))
+    {
+        discard;
+    }
+
+    outColor = color;
+}